@@ -0,0 +1,107 @@
+#include "cl_Histogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+  //Each bucket is split into SUB_BUCKET_COUNT sub-buckets, of which only the upper half is
+  //stored past the first bucket (the lower half would duplicate the bucket below).
+  const int SUB_BUCKET_HALF_MAGNITUDE = 10;
+  const uint64_t SUB_BUCKET_HALF_COUNT = uint64_t(1) << SUB_BUCKET_HALF_MAGNITUDE;
+  const uint64_t SUB_BUCKET_COUNT = SUB_BUCKET_HALF_COUNT * 2;
+  const uint64_t SUB_BUCKET_MASK = SUB_BUCKET_COUNT - 1;
+
+  //enough buckets to track values up to 2^43, which is about 2.4 hours in nanoseconds
+  const int BUCKET_COUNT = 33;
+  const uint64_t MAX_TRACKABLE = (SUB_BUCKET_COUNT << (BUCKET_COUNT - 1)) - 1;
+  const size_t COUNTS_LENGTH = (BUCKET_COUNT + 1) * SUB_BUCKET_HALF_COUNT;
+
+  int highestBit(uint64_t value) {
+    #if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+    #else
+    int bit = 0;
+    while(value >>= 1) { bit++; }
+    return bit;
+    #endif
+  }
+}
+
+SSocksBench::Histogram::Histogram() : counts(COUNTS_LENGTH, 0), total(0), smallest(UINT64_MAX), largest(0), sum(0) {
+  //nothing
+}
+
+void SSocksBench::Histogram::record(uint64_t value) {
+  value = std::min(value, MAX_TRACKABLE);
+  counts[indexOf(value)]++;
+  total++;
+  smallest = std::min(smallest, value);
+  largest = std::max(largest, value);
+  sum += static_cast<double>(value);
+}
+
+void SSocksBench::Histogram::merge(const Histogram& other) {
+  for(size_t i = 0; i < counts.size(); i++) { counts[i] += other.counts[i]; }
+  total += other.total;
+  smallest = std::min(smallest, other.smallest);
+  largest = std::max(largest, other.largest);
+  sum += other.sum;
+}
+
+void SSocksBench::Histogram::reset() {
+  std::fill(counts.begin(), counts.end(), 0);
+  total = 0;
+  smallest = UINT64_MAX;
+  largest = 0;
+  sum = 0;
+}
+
+uint64_t SSocksBench::Histogram::count() const {
+  return total;
+}
+
+uint64_t SSocksBench::Histogram::min() const {
+  return total ? smallest : 0;
+}
+
+uint64_t SSocksBench::Histogram::max() const {
+  return largest;
+}
+
+double SSocksBench::Histogram::mean() const {
+  return total ? sum / static_cast<double>(total) : 0;
+}
+
+uint64_t SSocksBench::Histogram::percentile(double percentile) const {
+  if(total == 0) { return 0; }
+
+  percentile = std::min(std::max(percentile, 0.0), 100.0);
+  uint64_t target = static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(total)));
+  target = std::max<uint64_t>(target, 1);
+
+  uint64_t seen = 0;
+  for(size_t i = 0; i < counts.size(); i++) {
+    seen += counts[i];
+    if(seen >= target) { return std::min(highestEquivalent(i), largest); }
+  }
+  return largest;
+}
+
+//The bucket is the value's power of two above the first bucket's range; the sub-bucket is the
+//value shifted down to that bucket's resolution.
+size_t SSocksBench::Histogram::indexOf(uint64_t value) {
+  int bucket = highestBit(value | SUB_BUCKET_MASK) - SUB_BUCKET_HALF_MAGNITUDE;
+  uint64_t subBucket = value >> bucket;
+  return static_cast<size_t>((static_cast<uint64_t>(bucket) << SUB_BUCKET_HALF_MAGNITUDE) + subBucket);
+}
+
+uint64_t SSocksBench::Histogram::highestEquivalent(size_t index) {
+  //undo indexOf(): the first bucket has unit-wide sub-buckets, the rest double each time
+  int bucket = static_cast<int>(index >> SUB_BUCKET_HALF_MAGNITUDE) - 1;
+  uint64_t subBucket = (index & (SUB_BUCKET_HALF_COUNT - 1)) + SUB_BUCKET_HALF_COUNT;
+  if(bucket < 0) {
+    bucket = 0;
+    subBucket -= SUB_BUCKET_HALF_COUNT;
+  }
+  uint64_t lowest = subBucket << bucket;
+  return lowest + (uint64_t(1) << bucket) - 1;
+}
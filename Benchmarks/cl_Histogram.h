@@ -0,0 +1,63 @@
+/** @file */
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace SSocksBench {
+
+  /**
+   * Latency histogram in the manner of HdrHistogram.
+   * Values (nanoseconds, by convention) are counted in buckets that double in width, each split
+   * into 1024 equal sub-buckets, so every recorded value is kept to three significant digits
+   * whatever its size. Recording is a couple of shifts and an increment, cheap enough to call
+   * for every operation of a benchmark without disturbing it.\n
+   * Values beyond the largest trackable value (about 2.4 hours in nanoseconds) are clamped to it.
+   */
+  class Histogram {
+  public:
+    //! Create an empty histogram.
+    Histogram();
+
+    //! Record one value.
+    void record(uint64_t value);
+
+    //! Add every value recorded by another histogram.
+    void merge(const Histogram& other);
+
+    //! Forget every value recorded.
+    void reset();
+
+    //! Return the number of values recorded.
+    uint64_t count() const;
+
+    //! Return the smallest value recorded, or zero if there are none.
+    uint64_t min() const;
+
+    //! Return the largest value recorded, or zero if there are none.
+    uint64_t max() const;
+
+    //! Return the mean of the values recorded, or zero if there are none.
+    double mean() const;
+
+    /**
+     * Return the value at a percentile.
+     * As with HdrHistogram, this is the highest value that falls in the same sub-bucket as the
+     * value at the percentile, so it errs high by at most one part in a thousand.
+     * @param percentile The percentile, from 0 to 100.
+     */
+    uint64_t percentile(double percentile) const;
+
+  private:
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t smallest;
+    uint64_t largest;
+    double sum;
+
+    static size_t indexOf(uint64_t value);
+    static uint64_t highestEquivalent(size_t index);
+
+  };
+
+}
@@ -0,0 +1,119 @@
+#include "cl_Report.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+
+namespace {
+  const double PERCENTILES[] = { 50, 90, 99, 99.9, 99.99 };
+
+  std::string describe(const SSocksBench::Result& result) {
+    std::string name = result.name;
+    for(auto& param : result.params) { name += " " + param.first + "=" + std::to_string(param.second); }
+    return name;
+  }
+
+  //names and figures are all plain ASCII, but quote and backslash are escaped anyway
+  std::string quoted(const std::string& text) {
+    std::string out = "\"";
+    for(char c : text) {
+      if(c == '"' || c == '\\') { out += '\\'; }
+      out += c;
+    }
+    return out + "\"";
+  }
+
+  //a latency for the table, or a dash when the case doesn't measure latency
+  std::string micros(const SSocksBench::Histogram& histogram, uint64_t nanos) {
+    if(histogram.count() == 0) { return "-"; }
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.2f", nanos / 1e3);
+    return buffer;
+  }
+
+  std::string percentileKey(double percentile) {
+    std::ostringstream key;
+    key << "p" << percentile;
+    return key.str();
+  }
+}
+
+void SSocksBench::Report::printHeader() const {
+  std::printf("%-36s %12s %10s %10s %10s %10s %10s %10s\n", "case", "ops/s", "MB/s", "p50 us", "p99 us", "p99.9 us", "max us", "note");
+}
+
+void SSocksBench::Report::add(Result result) {
+  if(!result.error.empty()) {
+    std::printf("%-36s failed: %s\n", describe(result).c_str(), result.error.c_str());
+  }
+  else {
+    double opsPerSec = result.seconds > 0 ? result.ops / result.seconds : 0;
+    double mbPerSec = result.seconds > 0 ? result.bytes / result.seconds / 1e6 : 0;
+    const Histogram& h = result.latency;
+    std::string note;
+    for(auto& figure : result.extra) {
+      char buffer[64];
+      std::snprintf(buffer, sizeof(buffer), "%s%s=%.3g", note.empty() ? "" : " ", figure.first.c_str(), figure.second);
+      note += buffer;
+    }
+    std::printf("%-36s %12.0f %10.1f %10s %10s %10s %10s %s\n", describe(result).c_str(), opsPerSec, mbPerSec,
+      micros(h, h.percentile(50)).c_str(), micros(h, h.percentile(99)).c_str(), micros(h, h.percentile(99.9)).c_str(),
+      micros(h, h.max()).c_str(), note.c_str());
+  }
+  std::fflush(stdout);
+
+  results.push_back(std::move(result));
+}
+
+bool SSocksBench::Report::writeJson(const std::string& path, const std::vector<std::pair<std::string, double>>& settings) const {
+  std::ofstream file(path);
+  if(!file) { return false; }
+
+  auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+  file << "{\n  \"schema\": 1,\n  \"timestamp\": " << now << ",\n  \"settings\": {";
+  for(size_t i = 0; i < settings.size(); i++) {
+    file << (i ? ", " : "") << quoted(settings[i].first) << ": " << settings[i].second;
+  }
+  file << "},\n  \"results\": [";
+
+  for(size_t i = 0; i < results.size(); i++) {
+    const Result& result = results[i];
+    file << (i ? "," : "") << "\n    {\"name\": " << quoted(result.name) << ", \"params\": {";
+    for(size_t p = 0; p < result.params.size(); p++) {
+      file << (p ? ", " : "") << quoted(result.params[p].first) << ": " << result.params[p].second;
+    }
+    file << "}";
+
+    if(!result.error.empty()) {
+      file << ", \"error\": " << quoted(result.error) << "}";
+      continue;
+    }
+
+    double opsPerSec = result.seconds > 0 ? result.ops / result.seconds : 0;
+    double bytesPerSec = result.seconds > 0 ? result.bytes / result.seconds : 0;
+    file << ", \"ops\": " << result.ops << ", \"bytes\": " << result.bytes << ", \"seconds\": " << result.seconds
+         << ", \"ops_per_sec\": " << opsPerSec << ", \"bytes_per_sec\": " << bytesPerSec;
+
+    const Histogram& h = result.latency;
+    if(h.count()) {
+      file << ", \"latency_ns\": {\"count\": " << h.count() << ", \"min\": " << h.min() << ", \"mean\": " << h.mean();
+      for(double percentile : PERCENTILES) { file << ", " << quoted(percentileKey(percentile)) << ": " << h.percentile(percentile); }
+      file << ", \"max\": " << h.max() << "}";
+    }
+
+    for(auto& figure : result.extra) { file << ", " << quoted(figure.first) << ": " << figure.second; }
+    file << "}";
+  }
+
+  file << "\n  ]\n}\n";
+  return static_cast<bool>(file);
+}
+
+size_t SSocksBench::Report::failures() const {
+  size_t failed = 0;
+  for(const Result& result : results) {
+    if(!result.error.empty()) { failed++; }
+  }
+  return failed;
+}
@@ -0,0 +1,60 @@
+/** @file */
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "cl_Histogram.h"
+
+namespace SSocksBench {
+
+  //! The outcome of one benchmark case.
+  struct Result {
+    //! The benchmark's name, such as "tcp_pingpong".
+    std::string name;
+    //! The parameters of this case, such as {"size", 64}.
+    std::vector<std::pair<std::string, uint64_t>> params;
+    //! Operations completed (round trips, messages, connections...).
+    uint64_t ops = 0;
+    //! Bytes moved, where that's meaningful.
+    uint64_t bytes = 0;
+    //! Wall-clock seconds the measured part took.
+    double seconds = 0;
+    //! Per-operation latency in nanoseconds. Empty when the case doesn't measure it.
+    Histogram latency;
+    //! Extra named figures, such as a loss percentage.
+    std::vector<std::pair<std::string, double>> extra;
+    //! Empty if the case ran; otherwise why it didn't.
+    std::string error;
+  };
+
+  /**
+   * Collects benchmark results, prints them as a table and writes them out as JSON.
+   * The JSON file holds one object per case, with throughput and latency percentiles, so that
+   * runs can be compared over time by a script.
+   */
+  class Report {
+  public:
+    //! Add a result and print its line of the table.
+    void add(Result result);
+
+    //! Print the table's header.
+    void printHeader() const;
+
+    /**
+     * Write every result as JSON.
+     * @param path The file to write.
+     * @param settings Run settings to record alongside the results.
+     * @return false if the file couldn't be written.
+     */
+    bool writeJson(const std::string& path, const std::vector<std::pair<std::string, double>>& settings) const;
+
+    //! Return the number of results that failed.
+    size_t failures() const;
+
+  private:
+    std::vector<Result> results;
+
+  };
+
+}
@@ -0,0 +1,328 @@
+#include "fn_benchmarks.h"
+#include "SimpleSocks.h"
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  const char* LOOPBACK = "127.0.0.1";
+
+  //round trips (or sends) made before measuring, to get caches and the scheduler settled
+  const int WARMUP_OPS = 1000;
+
+  //accepted connections linger in TIME_WAIT, so the accept benchmark stops at this many
+  const uint64_t MAX_CONNECTIONS = 20000;
+
+  uint64_t nanosSince(Clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+  }
+
+  double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  bool timeLeft(Clock::time_point start, const SSocksBench::Config& config) {
+    return secondsSince(start) < config.seconds;
+  }
+
+  //Runs the other end of a benchmark on its own thread. finish() (or going out of scope)
+  //calls 'wake' to tell the thread to stop, typically by closing the connection it's reading,
+  //and then joins it, so a case that throws can't leave the thread behind.
+  class Peer {
+  public:
+    template<class F> Peer(F body, std::function<void()> wake) : wake(std::move(wake)), thread([body = std::move(body)]() mutable {
+      try { body(); }
+      catch(const std::exception&) {} //the main thread sees the failure from its own end
+    }) {}
+    ~Peer() { finish(); }
+    void finish() {
+      if(!thread.joinable()) { return; }
+      wake();
+      thread.join();
+    }
+  private:
+    std::function<void()> wake;
+    std::thread thread;
+  };
+
+  //Run one case, turning an exception into a failed result rather than ending the run.
+  template<class F> void runCase(SSocksBench::Report& report, SSocksBench::Result result, F body) {
+    try { body(result); }
+    catch(const std::exception& e) { result.error = e.what(); }
+    report.add(std::move(result));
+  }
+
+  SSocksBench::Result named(const char* name, const char* param, uint64_t value) {
+    SSocksBench::Result result;
+    result.name = name;
+    result.params.emplace_back(param, value);
+    return result;
+  }
+}
+
+void SSocksBench::tcpPingPong(Report& report, const Config& config) {
+  const size_t SIZES[] = { 1, 64, 1024, 16384 };
+  uint16_t port = config.basePort;
+
+  for(size_t size : SIZES) {
+    runCase(report, named("tcp_pingpong", "size", size), [&](Result& result) {
+      SSocks::TCPServer server(port, true, LOOPBACK);
+      SSocks::TCPSocket client(SSocks::HostAddress(LOOPBACK, port));
+      client.setNoDelay(true);
+
+      //accept here rather than on the peer, so that a failed connect can't leave it waiting
+      SSocks::TCPSocket accepted = server.accept();
+      accepted.setNoDelay(true);
+      Peer echo([sock = std::move(accepted), size]() mutable {
+        std::vector<char> buffer(size);
+        while(sock.recvInto(buffer.data(), size) == size) { sock.sendAll(buffer.data(), size); }
+      }, [&client]() { client.close(); });
+
+      std::vector<char> buffer(size, 'x');
+      auto roundTrip = [&]() {
+        client.sendAll(buffer.data(), size);
+        if(client.recvInto(buffer.data(), size) != size) { throw std::runtime_error("Echo connection closed."); }
+      };
+
+      for(int i = 0; i < WARMUP_OPS; i++) { roundTrip(); }
+
+      Clock::time_point start = Clock::now();
+      while(timeLeft(start, config)) {
+        Clock::time_point sent = Clock::now();
+        roundTrip();
+        result.latency.record(nanosSince(sent));
+        result.ops++;
+      }
+      result.seconds = secondsSince(start);
+      result.bytes = result.ops * size * 2;
+    });
+  }
+}
+
+void SSocksBench::tcpBulk(Report& report, const Config& config) {
+  const size_t SIZES[] = { 64, 1024, 16384, 262144 };
+  uint16_t port = config.basePort + 1;
+
+  for(size_t size : SIZES) {
+    runCase(report, named("tcp_bulk", "size", size), [&](Result& result) {
+      SSocks::TCPServer server(port, true, LOOPBACK);
+      SSocks::TCPSocket client(SSocks::HostAddress(LOOPBACK, port));
+      SSocks::TCPSocket accepted = server.accept();
+
+      //the reader notes how much arrived and when the last of it did
+      uint64_t received = 0;
+      Clock::time_point finished;
+      Peer sink([sock = std::move(accepted), &received, &finished]() mutable {
+        std::vector<char> buffer(256 * 1024);
+        while(true) {
+          size_t got = sock.recvSome(buffer.data(), buffer.size());
+          if(!sock.isOpen()) { break; }
+          received += got;
+        }
+        finished = Clock::now();
+      }, [&client]() { client.close(); });
+
+      std::vector<char> message(size, 'x');
+      for(int i = 0; i < WARMUP_OPS / 10; i++) { client.sendAll(message.data(), size); }
+
+      Clock::time_point start = Clock::now();
+      uint64_t warmBytes = uint64_t(WARMUP_OPS / 10) * size;
+      while(timeLeft(start, config)) {
+        Clock::time_point sent = Clock::now();
+        client.sendAll(message.data(), size);
+        result.latency.record(nanosSince(sent));
+        result.ops++;
+      }
+
+      //throughput is what the reader got, up to when it got the last byte
+      sink.finish();
+      result.bytes = received - warmBytes;
+      result.seconds = std::chrono::duration<double>(finished - start).count();
+    });
+  }
+}
+
+void SSocksBench::udpRequestResponse(Report& report, const Config& config) {
+  const size_t SIZE = 64;
+  uint16_t port = config.basePort + 2;
+
+  runCase(report, named("udp_reqresp", "size", SIZE), [&](Result& result) {
+    SSocks::UDPSocket server;
+    server.open(port, true, LOOPBACK);
+
+    std::atomic<bool> stop(false);
+    Peer echo([&server, &stop]() {
+      char buffer[SIZE];
+      SSocks::HostAddress from;
+      while(!stop) {
+        auto got = server.recvFrom(buffer, sizeof(buffer), from, SSocks::Deadline::after(0.05f));
+        if(got) { server.sendTo(from, buffer, *got); }
+      }
+    }, [&stop]() { stop = true; });
+
+    SSocks::UDPSocket client;
+    client.open();
+    SSocks::HostAddress to(LOOPBACK, port);
+    char buffer[SIZE] = { 0 };
+    uint64_t lost = 0;
+
+    auto roundTrip = [&]() {
+      client.sendTo(to, buffer, SIZE);
+      SSocks::HostAddress from;
+      return static_cast<bool>(client.recvFrom(buffer, SIZE, from, SSocks::Deadline::after(0.2f)));
+    };
+
+    for(int i = 0; i < WARMUP_OPS; i++) { roundTrip(); }
+
+    Clock::time_point start = Clock::now();
+    while(timeLeft(start, config)) {
+      Clock::time_point sent = Clock::now();
+      if(roundTrip()) {
+        result.latency.record(nanosSince(sent));
+        result.ops++;
+      }
+      else { lost++; }
+    }
+    result.seconds = secondsSince(start);
+    result.bytes = result.ops * SIZE * 2;
+    result.extra.emplace_back("lost", static_cast<double>(lost));
+  });
+}
+
+void SSocksBench::udpFlood(Report& report, const Config& config) {
+  const size_t SIZES[] = { 64, 1024 };
+  uint16_t port = config.basePort + 3;
+
+  for(size_t size : SIZES) {
+    runCase(report, named("udp_flood", "size", size), [&](Result& result) {
+      //a large receive buffer, so that losses reflect the receive path rather than a small queue
+      SSocks::SocketOptions options;
+      options.recvBuffer = 4 * 1024 * 1024;
+      SSocks::UDPSocket server;
+      server.setOptions(options);
+      server.open(port, true, LOOPBACK);
+
+      //the counter stops once the datagrams have stopped arriving for a while
+      std::atomic<bool> sending(true);
+      uint64_t received = 0;
+      Peer counter([&server, &sending, &received]() {
+        std::vector<char> buffer(65536);
+        SSocks::HostAddress from;
+        while(true) {
+          if(server.recvFrom(buffer.data(), buffer.size(), from, SSocks::Deadline::after(0.2f))) { received++; }
+          else if(!sending) { break; }
+        }
+      }, [&sending]() { sending = false; });
+
+      SSocks::UDPSocket client;
+      client.open();
+      SSocks::HostAddress to(LOOPBACK, port);
+      std::vector<char> message(size, 'x');
+
+      uint64_t sent = 0;
+      Clock::time_point start = Clock::now();
+      while(timeLeft(start, config)) {
+        //check the clock only now and then, so that it doesn't slow the sending
+        for(int i = 0; i < 64; i++) { sent += client.sendTo(to, message.data(), size) == size; }
+      }
+      result.seconds = secondsSince(start);
+      counter.finish();
+
+      result.ops = received;
+      result.bytes = received * size;
+      result.extra.emplace_back("sent_per_sec", sent / result.seconds);
+      result.extra.emplace_back("loss_pct", sent ? 100.0 * (sent - std::min(received, sent)) / sent : 0);
+    });
+  }
+}
+
+void SSocksBench::selectWait(Report& report, const Config& config) {
+  //select() can't take descriptors past FD_SETSIZE (usually 1024), so stop short of it
+  const size_t COUNTS[] = { 1, 16, 128, 512, 900 };
+  uint16_t port = config.basePort + 4;
+
+  for(int usePoller = 0; usePoller < 2; usePoller++) {
+    for(size_t count : COUNTS) {
+      runCase(report, named(usePoller ? "poller_wait" : "select_wait", "sockets", count), [&](Result& result) {
+        //One socket has a datagram waiting that is never read, so it stays ready; the rest
+        //are idle. The ready one goes last, where select() finds it after scanning the others.
+        std::vector<SSocks::UDPSocket> sockets(count);
+        for(size_t i = 0; i + 1 < count; i++) { sockets[i].open(); }
+        SSocks::UDPSocket& ready = sockets.back();
+        ready.open(port, true, LOOPBACK);
+
+        SSocks::UDPSocket sender;
+        sender.open();
+        sender.sendTo(SSocks::HostAddress(LOOPBACK, port), "x", 1);
+
+        std::vector<SSocks::UDPSocket*> watched;
+        for(SSocks::UDPSocket& sock : sockets) { watched.push_back(&sock); }
+
+        SSocks::Poller poller;
+        std::vector<SSocks::Poller::Event> events(count);
+        if(usePoller) {
+          for(SSocks::UDPSocket& sock : sockets) { poller.add(sock, SSocks::Poller::READ); }
+        }
+
+        auto wait = [&]() {
+          size_t found = usePoller ? poller.wait(events.data(), events.size(), 1.0f) : SSocks::select(watched, 1.0f).size();
+          if(found != 1) { throw std::runtime_error("Expected exactly one ready socket."); }
+        };
+
+        for(int i = 0; i < WARMUP_OPS; i++) { wait(); }
+
+        Clock::time_point start = Clock::now();
+        while(timeLeft(start, config)) {
+          Clock::time_point called = Clock::now();
+          wait();
+          result.latency.record(nanosSince(called));
+          result.ops++;
+        }
+        result.seconds = secondsSince(start);
+      });
+    }
+  }
+}
+
+void SSocksBench::acceptRate(Report& report, const Config& config) {
+  uint16_t port = config.basePort + 5;
+
+  runCase(report, named("tcp_accept", "clients", 1), [&](Result& result) {
+    SSocks::TCPServer server(port, true, LOOPBACK);
+    SSocks::HostAddress host(LOOPBACK, port);
+
+    //The server closes each connection as soon as it's accepted, so that the wait in
+    //TIME_WAIT falls on its side and the client's ephemeral ports aren't used up.
+    std::atomic<bool> stop(false);
+    Peer acceptor([&server, &stop]() {
+      while(!stop) { server.accept(); }
+    }, [&stop, &host]() {
+      //a final connection wakes the acceptor so that it sees 'stop'
+      stop = true;
+      try { SSocks::TCPSocket wake(host); }
+      catch(const std::exception&) {}
+    });
+
+    char byte;
+    auto cycle = [&]() {
+      SSocks::TCPSocket client(host);
+      client.recvSome(&byte, 1); //returns once the server has closed
+    };
+
+    for(int i = 0; i < WARMUP_OPS / 10; i++) { cycle(); }
+
+    Clock::time_point start = Clock::now();
+    while(timeLeft(start, config) && result.ops < MAX_CONNECTIONS) {
+      Clock::time_point opened = Clock::now();
+      cycle();
+      result.latency.record(nanosSince(opened));
+      result.ops++;
+    }
+    result.seconds = secondsSince(start);
+  });
+}
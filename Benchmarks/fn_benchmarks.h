@@ -0,0 +1,52 @@
+/** @file */
+#pragma once
+#include <cstdint>
+#include "cl_Report.h"
+
+namespace SSocksBench {
+
+  //! Settings shared by every benchmark.
+  struct Config {
+    //! Seconds each case is measured for, after its warm-up.
+    double seconds = 1.0;
+    //! The first loopback port to use. Each case takes a few ports above it.
+    uint16_t basePort = 47600;
+  };
+
+  /**
+   * TCP echo ping-pong: one round trip at a time over a single connection with Nagle off.
+   * Measures round-trip latency, which is dominated by the recv() and send() paths.
+   */
+  void tcpPingPong(Report& report, const Config& config);
+
+  /**
+   * TCP bulk transfer: one side streams fixed-size messages as fast as it can while the other
+   * reads them. Measures throughput at several message sizes, and the time each send() takes.
+   */
+  void tcpBulk(Report& report, const Config& config);
+
+  /**
+   * UDP request/response: one datagram out and its echo back, one at a time.
+   * Measures round-trip latency through sendTo() and recvFrom(); lost datagrams are counted.
+   */
+  void udpRequestResponse(Report& report, const Config& config);
+
+  /**
+   * UDP flood: one side sends datagrams as fast as it can while the other counts them.
+   * Measures the send rate, the receive rate and the loss between them.
+   */
+  void udpFlood(Report& report, const Config& config);
+
+  /**
+   * Cost of a select() call (and, for comparison, a Poller wait) against the number of sockets
+   * watched, with just one of them ready. Shows how the wait scales with socket count.
+   */
+  void selectWait(Report& report, const Config& config);
+
+  /**
+   * Accept rate: connections opened, accepted and closed one after another.
+   * Measures how many a server can take per second and how long each takes end to end.
+   */
+  void acceptRate(Report& report, const Config& config);
+
+}
@@ -0,0 +1,70 @@
+#include "fn_benchmarks.h"
+#include "cl_Report.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+  void usage(const char* program) {
+    std::printf(
+      "Loopback benchmarks for SimpleSocks.\n"
+      "usage: %s [options]\n"
+      "  --seconds S   measure each case for S seconds (default 1)\n"
+      "  --quick       measure each case for 0.1 seconds, as a smoke test\n"
+      "  --port P      first loopback port to use (default 47600; up to P+5 are used)\n"
+      "  --filter TEXT run only the benchmarks whose name contains TEXT\n"
+      "  --json FILE   also write the results to FILE as JSON\n",
+      program);
+  }
+
+  struct Benchmark {
+    const char* name;
+    void (*run)(SSocksBench::Report&, const SSocksBench::Config&);
+  };
+
+  const Benchmark BENCHMARKS[] = {
+    { "tcp_pingpong", SSocksBench::tcpPingPong },
+    { "tcp_bulk", SSocksBench::tcpBulk },
+    { "udp_reqresp", SSocksBench::udpRequestResponse },
+    { "udp_flood", SSocksBench::udpFlood },
+    { "select_wait poller_wait", SSocksBench::selectWait },
+    { "tcp_accept", SSocksBench::acceptRate },
+  };
+}
+
+int main(int argc, char** argv) {
+  SSocksBench::Config config;
+  std::string filter;
+  std::string jsonPath;
+
+  for(int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if(arg == "--quick") { config.seconds = 0.1; }
+    else if(arg == "--seconds" && hasValue) { config.seconds = std::atof(argv[++i]); }
+    else if(arg == "--port" && hasValue) { config.basePort = static_cast<uint16_t>(std::atoi(argv[++i])); }
+    else if(arg == "--filter" && hasValue) { filter = argv[++i]; }
+    else if(arg == "--json" && hasValue) { jsonPath = argv[++i]; }
+    else {
+      usage(argv[0]);
+      return arg == "--help" ? 0 : 2;
+    }
+  }
+
+  SSocksBench::Report report;
+  report.printHeader();
+  for(const Benchmark& benchmark : BENCHMARKS) {
+    if(filter.empty() || std::strstr(benchmark.name, filter.c_str())) { benchmark.run(report, config); }
+  }
+
+  if(!jsonPath.empty()) {
+    std::vector<std::pair<std::string, double>> settings = { { "seconds", config.seconds }, { "base_port", config.basePort } };
+    if(!report.writeJson(jsonPath, settings)) {
+      std::fprintf(stderr, "Could not write %s\n", jsonPath.c_str());
+      return 1;
+    }
+  }
+
+  return report.failures() ? 1 : 0;
+}
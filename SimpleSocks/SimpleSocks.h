@@ -5,7 +5,24 @@
 //This header is only provided for convenience.
 
 #include "cl_HostAddress.h"
+#include "cl_Deadline.h"
+#include "cl_Resolver.h"
+#include "cl_BufferView.h"
+#include "cl_SocketOptions.h"
+#include "cl_Metrics.h"
 #include "cl_TCPSocket.h"
 #include "cl_TCPServer.h"
+#include "cl_ConnectionPool.h"
+#include "cl_BufferedReader.h"
+#include "cl_BufferedWriter.h"
+#include "cl_FrameCodec.h"
 #include "cl_UDPSocket.h"
+#include "cl_BufferPool.h"
 #include "fn_select.h"
+#include "cl_Poller.h"
+#include "cl_EventLoop.h"
+#include "cl_Task.h"
+#include "fn_async.h"
+#include "cl_ShardedServer.h"
+#include "cl_WorkerPool.h"
+#include "cl_IOUring.h"
@@ -0,0 +1,245 @@
+#include "cl_BufferPool.h"
+#include <stdexcept>
+#include <thread>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+//Bookkeeping for one buffer. It's kept apart from the buffer memory itself so that the data
+//stays cache-line aligned and the slab can be mapped in whole pages.
+struct SSocks::PooledBuffer::Block {
+  std::atomic<unsigned> refs;
+  size_t size;
+  char* data;
+  BufferPool* pool;
+};
+
+namespace {
+  const size_t CACHE_LINE = 64;
+  const size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+  //hands each thread its own free list, in turn
+  std::atomic<size_t> nextThreadIndex(0);
+  thread_local size_t threadIndex = nextThreadIndex++;
+}
+
+//One contiguous run of buffers.
+struct SSocks::BufferPool::Slab {
+  char* memory = nullptr;
+  size_t bytes = 0;
+  bool mapped = false;
+  std::unique_ptr<PooledBuffer::Block[]> blocks;
+
+  Slab(size_t bytes, bool hugePages) : bytes(bytes) {
+    #ifdef __linux__
+    if(hugePages) {
+      //huge page mappings must be a whole number of huge pages
+      size_t rounded = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+      void* mem = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if(mem != MAP_FAILED) {
+        memory = static_cast<char*>(mem);
+        this->bytes = rounded;
+        mapped = true;
+        return;
+      }
+      //no huge pages reserved (or none at all), so fall through to ordinary memory
+    }
+    #else
+    (void)hugePages;
+    #endif
+    memory = static_cast<char*>(::operator new(bytes, std::align_val_t(CACHE_LINE)));
+  }
+
+  ~Slab() {
+    #ifdef __linux__
+    if(mapped) { munmap(memory, bytes); return; }
+    #endif
+    ::operator delete(memory, std::align_val_t(CACHE_LINE));
+  }
+};
+
+//A free list, padded out to its own cache line so neighboring lists don't share one.
+struct alignas(64) SSocks::BufferPool::FreeList {
+  std::mutex mutex;
+  std::vector<PooledBuffer::Block*> blocks;
+};
+
+////////////////////////////PooledBuffer////////////////////////////
+
+SSocks::PooledBuffer::PooledBuffer() : block(nullptr) {
+  //nothing
+}
+
+SSocks::PooledBuffer::PooledBuffer(Block* block) : block(block) {
+  //the pool hands the block over with its reference already counted
+}
+
+SSocks::PooledBuffer::PooledBuffer(const PooledBuffer& copyFrom) : block(copyFrom.block) {
+  if(block) { block->refs.fetch_add(1, std::memory_order_relaxed); }
+}
+
+SSocks::PooledBuffer& SSocks::PooledBuffer::operator=(const PooledBuffer& copyFrom) {
+  //take the new reference first, in case both handles share a block
+  if(copyFrom.block) { copyFrom.block->refs.fetch_add(1, std::memory_order_relaxed); }
+  reset();
+  block = copyFrom.block;
+  return *this;
+}
+
+SSocks::PooledBuffer::PooledBuffer(PooledBuffer&& moveFrom) : block(moveFrom.block) {
+  moveFrom.block = nullptr;
+}
+
+SSocks::PooledBuffer& SSocks::PooledBuffer::operator=(PooledBuffer&& moveFrom) {
+  if(this != &moveFrom) {
+    reset();
+    block = moveFrom.block;
+    moveFrom.block = nullptr;
+  }
+  return *this;
+}
+
+SSocks::PooledBuffer::~PooledBuffer() {
+  reset();
+}
+
+void SSocks::PooledBuffer::reset() {
+  if(block && block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    block->pool->release(block);
+  }
+  block = nullptr;
+}
+
+char* SSocks::PooledBuffer::data() {
+  return block ? block->data : nullptr;
+}
+
+const char* SSocks::PooledBuffer::data() const {
+  return block ? block->data : nullptr;
+}
+
+size_t SSocks::PooledBuffer::size() const {
+  return block ? block->size : 0;
+}
+
+size_t SSocks::PooledBuffer::capacity() const {
+  return block ? block->pool->bufferSize() : 0;
+}
+
+bool SSocks::PooledBuffer::empty() const {
+  return size() == 0;
+}
+
+void SSocks::PooledBuffer::resize(size_t len) {
+  if(len > capacity()) { throw std::length_error("PooledBuffer cannot grow beyond its capacity."); }
+  if(block) { block->size = len; }
+}
+
+std::string_view SSocks::PooledBuffer::view() const {
+  return std::string_view(data(), size());
+}
+
+////////////////////////////BufferPool////////////////////////////
+
+SSocks::BufferPool::BufferPool(size_t bufferSize, size_t buffersPerSlab, bool hugePages) :
+  size(bufferSize), perSlab(buffersPerSlab), hugePages(hugePages), total(0) {
+  if(bufferSize == 0 || buffersPerSlab == 0) { throw std::invalid_argument("BufferPool needs a nonzero buffer size and slab size."); }
+
+  //keep each buffer on its own cache lines
+  stride = (bufferSize + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+
+  //one free list per hardware thread is enough to keep contention rare
+  freeListCount = std::thread::hardware_concurrency();
+  if(freeListCount == 0) { freeListCount = 1; }
+  freeLists.reset(new FreeList[freeListCount]);
+}
+
+SSocks::BufferPool::~BufferPool() {
+  //slabs release themselves
+}
+
+SSocks::PooledBuffer SSocks::BufferPool::acquire() {
+  PooledBuffer::Block* block = nullptr;
+
+  //our own list first, then anyone else's
+  FreeList& mine = localFreeList();
+  {
+    std::lock_guard<std::mutex> lock(mine.mutex);
+    if(!mine.blocks.empty()) {
+      block = mine.blocks.back();
+      mine.blocks.pop_back();
+    }
+  }
+  for(size_t i = 0; !block && i < freeListCount; i++) {
+    FreeList& other = freeLists[i];
+    if(&other == &mine) { continue; }
+    std::lock_guard<std::mutex> lock(other.mutex);
+    if(!other.blocks.empty()) {
+      block = other.blocks.back();
+      other.blocks.pop_back();
+    }
+  }
+
+  //everything is in use, so make more
+  if(!block) { block = grow(); }
+
+  block->refs.store(1, std::memory_order_relaxed);
+  block->size = 0;
+  return PooledBuffer(block);
+}
+
+size_t SSocks::BufferPool::bufferSize() const {
+  return size;
+}
+
+size_t SSocks::BufferPool::allocated() const {
+  return total;
+}
+
+void SSocks::BufferPool::release(PooledBuffer::Block* block) {
+  //Releasing to the current thread's list keeps a buffer near the core that last touched it.
+  //The free lists are reserved up front, so this doesn't allocate.
+  FreeList& mine = localFreeList();
+  std::lock_guard<std::mutex> lock(mine.mutex);
+  mine.blocks.push_back(block);
+}
+
+SSocks::PooledBuffer::Block* SSocks::BufferPool::grow() {
+  std::unique_ptr<Slab> slab(new Slab(stride * perSlab, hugePages));
+  slab->blocks.reset(new PooledBuffer::Block[perSlab]);
+  for(size_t i = 0; i < perSlab; i++) {
+    PooledBuffer::Block& block = slab->blocks[i];
+    block.refs.store(0, std::memory_order_relaxed);
+    block.size = 0;
+    block.data = slab->memory + i * stride;
+    block.pool = this;
+  }
+
+  PooledBuffer::Block* first = &slab->blocks[0];
+  size_t newTotal;
+  {
+    std::lock_guard<std::mutex> lock(slabMutex);
+    slabs.push_back(std::move(slab));
+    newTotal = total += perSlab;
+
+    //Any buffer can end up on any list, so make sure every list can hold all of them without
+    //reallocating. That keeps allocation out of release().
+    for(size_t i = 0; i < freeListCount; i++) {
+      std::lock_guard<std::mutex> listLock(freeLists[i].mutex);
+      freeLists[i].blocks.reserve(newTotal);
+    }
+  }
+
+  //keep the first buffer for the caller and put the rest on our own list
+  FreeList& mine = localFreeList();
+  std::lock_guard<std::mutex> lock(mine.mutex);
+  for(size_t i = 1; i < perSlab; i++) { mine.blocks.push_back(first + i); }
+
+  return first;
+}
+
+SSocks::BufferPool::FreeList& SSocks::BufferPool::localFreeList() {
+  return freeLists[threadIndex % freeListCount];
+}
@@ -0,0 +1,140 @@
+/** @file */
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <string_view>
+#include <cstddef>
+
+namespace SSocks {
+  //forward declaration
+  class BufferPool;
+
+  /**
+   * Handle to a buffer borrowed from a BufferPool.
+   * The buffer goes back to its pool when the last handle referring to it is destroyed.
+   * Copies of a handle share the same buffer (and the same size), so copying is cheap and
+   * never duplicates the data. A default-constructed handle holds no buffer.\n
+   * A handle may be passed to and released on any thread, but the pool it came from must
+   * outlive it.
+   */
+  class PooledBuffer {
+  public:
+    //! Generate an empty handle.
+    PooledBuffer();
+
+    //! Share the buffer held by another handle.
+    PooledBuffer(const PooledBuffer& copyFrom);
+
+    //! Share the buffer held by another handle, releasing the present one.
+    PooledBuffer& operator=(const PooledBuffer& copyFrom);
+
+    //! Move constructor to transfer the buffer to a new handle.
+    PooledBuffer(PooledBuffer&& moveFrom);
+
+    //! Move-assign operator to transfer the buffer to a new handle.
+    PooledBuffer& operator=(PooledBuffer&& moveFrom);
+
+    //! Destructor. Returns the buffer to its pool if this is the last handle to it.
+    ~PooledBuffer();
+
+    //! Return a pointer to the buffer's data, or nullptr for an empty handle.
+    char* data();
+    //! @copydoc data()
+    const char* data() const;
+
+    //! Return the number of bytes in use.
+    size_t size() const;
+
+    //! Return the number of bytes the buffer can hold.
+    size_t capacity() const;
+
+    //! Return true if no bytes are in use (or the handle holds no buffer).
+    bool empty() const;
+
+    //! Set the number of bytes in use. This never reallocates, so 'len' must not exceed capacity().
+    void resize(size_t len);
+
+    //! Return a view of the bytes in use.
+    std::string_view view() const;
+
+    //! Release the buffer, leaving the handle empty.
+    void reset();
+
+  private:
+    struct Block;
+    Block* block;
+
+    explicit PooledBuffer(Block* block);
+
+    friend class BufferPool;
+
+  };
+
+  /**
+   * A pool of fixed-size receive buffers.
+   * Buffers are carved out of large slabs, so a busy receive loop recycles the same few
+   * buffers instead of going to the heap (and zeroing 64 KiB) for every datagram. Each thread
+   * returns buffers to, and takes them from, its own free list first, so threads sharing a pool
+   * rarely contend. The pool grows one slab at a time when every buffer is in use, and only
+   * releases memory when it is destroyed.\n
+   * On Linux the slabs can be backed by huge pages, which cuts TLB misses when the pool is large.
+   * If huge pages are unavailable the pool quietly falls back to ordinary pages.
+   */
+  class BufferPool {
+  public:
+    /**
+     * Create an empty pool. No memory is allocated until the first buffer is requested.
+     * @param bufferSize The capacity of each buffer. The default holds any UDP datagram.
+     * @param buffersPerSlab How many buffers to allocate at a time when the pool runs dry.
+     * @param hugePages Whether to try backing the slabs with huge pages. (Linux only.)
+     */
+    explicit BufferPool(size_t bufferSize = 0xFFFF, size_t buffersPerSlab = 32, bool hugePages = false);
+
+    //! Copying is prohibited, as outstanding buffers refer back to their pool.
+    BufferPool(const BufferPool&) = delete;
+
+    //! Copying is prohibited, as outstanding buffers refer back to their pool.
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    //! Destructor. Every buffer taken from the pool must have been released.
+    ~BufferPool();
+
+    /**
+     * Take a buffer from the pool.
+     * @return A handle to a buffer with capacity() of bufferSize() and a size() of zero.
+     */
+    PooledBuffer acquire();
+
+    //! Return the capacity of each buffer.
+    size_t bufferSize() const;
+
+    //! Return the total number of buffers the pool has allocated.
+    size_t allocated() const;
+
+  private:
+    struct Slab;
+    struct FreeList;
+
+    size_t size;
+    size_t stride;
+    size_t perSlab;
+    bool hugePages;
+
+    std::mutex slabMutex;
+    std::vector<std::unique_ptr<Slab>> slabs;
+    std::atomic<size_t> total;
+
+    std::unique_ptr<FreeList[]> freeLists;
+    size_t freeListCount;
+
+    void release(PooledBuffer::Block* block);
+    PooledBuffer::Block* grow();
+    FreeList& localFreeList();
+
+    friend class PooledBuffer;
+
+  };
+
+}
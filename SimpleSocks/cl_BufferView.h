@@ -0,0 +1,46 @@
+/** @file */
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+namespace SSocks {
+
+  /**
+   * A read-only view of a run of bytes, for gather writes such as TCPSocket::sendv().
+   * The view does not own the memory, which must stay valid while the view is in use.
+   */
+  struct ConstBuffer {
+    //! The start of the bytes.
+    const void* data;
+    //! The number of bytes.
+    size_t size;
+
+    //! View 'len' bytes at 'data'.
+    ConstBuffer(const void* data, size_t len) : data(data), size(len) {}
+    //! View the characters of a string_view.
+    ConstBuffer(std::string_view str) : data(str.data()), size(str.size()) {}
+    //! View the characters of a string. Note that this excludes the null terminator.
+    ConstBuffer(const std::string& str) : data(str.data()), size(str.size()) {}
+    //! View the contents of a vector.
+    ConstBuffer(const std::vector<char>& vec) : data(vec.data()), size(vec.size()) {}
+  };
+
+  /**
+   * A writable view of a run of bytes, for scatter reads such as TCPSocket::recvv().
+   * The view does not own the memory, which must stay valid while the view is in use.
+   */
+  struct MutableBuffer {
+    //! The start of the bytes.
+    void* data;
+    //! The number of bytes.
+    size_t size;
+
+    //! View 'len' bytes at 'data'.
+    MutableBuffer(void* data, size_t len) : data(data), size(len) {}
+    //! View the current contents of a vector. The vector is not resized.
+    MutableBuffer(std::vector<char>& vec) : data(vec.data()), size(vec.size()) {}
+  };
+
+}
@@ -0,0 +1,135 @@
+#include "cl_BufferedReader.h"
+#include "cl_TCPSocket.h"
+#include <stdexcept>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SSOCKS_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+  //index of the lowest set bit of a nonzero mask
+  inline unsigned lowestBit(unsigned mask) {
+    #if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+    #else
+    return __builtin_ctz(mask);
+    #endif
+  }
+
+  //Find the first 'c' in [p, p + n), or nullptr. The wide loops compare a whole vector of
+  //bytes per step; memchr() picks up whatever tail is left.
+  const char* findByte(const char* p, size_t n, char c) {
+    #if defined(__AVX2__)
+    const __m256i needle32 = _mm256_set1_epi8(c);
+    for(; n >= 32; p += 32, n -= 32) {
+      __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+      unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle32)));
+      if(mask) { return p + lowestBit(mask); }
+    }
+    #endif
+
+    #if defined(SSOCKS_SSE2)
+    const __m128i needle16 = _mm_set1_epi8(c);
+    for(; n >= 16; p += 16, n -= 16) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle16)));
+      if(mask) { return p + lowestBit(mask); }
+    }
+    #endif
+
+    return static_cast<const char*>(n ? std::memchr(p, c, n) : nullptr);
+  }
+}
+
+SSocks::BufferedReader::BufferedReader(TCPSocket& sock, size_t capacity) :
+  sock(sock), buffer(new char[capacity]), size(capacity), begin(0), end(0), scanned(0), scannedFor(0) {
+  if(capacity == 0) { throw std::invalid_argument("BufferedReader needs a nonzero capacity."); }
+}
+
+bool SSocks::BufferedReader::readUntil(char delim, std::string_view& message) {
+  //what was scanned for another delimiter may still hold this one
+  if(delim != scannedFor) {
+    scanned = begin;
+    scannedFor = delim;
+  }
+
+  while(true) {
+    //only look at bytes that haven't been looked at yet
+    size_t from = scanned > begin ? scanned : begin;
+    const char* hit = findByte(buffer.get() + from, end - from, delim);
+    if(hit) {
+      size_t at = hit - buffer.get();
+      message = std::string_view(buffer.get() + begin, at - begin);
+      begin = scanned = at + 1;
+      return true;
+    }
+    scanned = end;
+
+    if(end - begin == size) { throw std::runtime_error("BufferedReader filled up without finding the delimiter."); }
+    if(!fill()) { return false; }
+  }
+}
+
+bool SSocks::BufferedReader::readLine(std::string_view& line) {
+  if(!readUntil('\n', line)) { return false; }
+  if(!line.empty() && line.back() == '\r') { line.remove_suffix(1); }
+  return true;
+}
+
+bool SSocks::BufferedReader::readExact(size_t len, std::string_view& data) {
+  if(!peek(len, data)) { return false; }
+  begin += len;
+  return true;
+}
+
+bool SSocks::BufferedReader::peek(size_t len, std::string_view& data) {
+  if(len > size) { throw std::runtime_error("BufferedReader asked to read more than its capacity."); }
+
+  while(end - begin < len) {
+    if(!fill()) { return false; }
+  }
+
+  data = std::string_view(buffer.get() + begin, len);
+  return true;
+}
+
+size_t SSocks::BufferedReader::buffered() const {
+  return end - begin;
+}
+
+size_t SSocks::BufferedReader::capacity() const {
+  return size;
+}
+
+SSocks::TCPSocket& SSocks::BufferedReader::socket() {
+  return sock;
+}
+
+bool SSocks::BufferedReader::fill() {
+  if(!sock.isOpen()) { return false; }
+
+  //Make room at the end by sliding the unread bytes to the front. This is only done when
+  //the end is reached, so most refills move nothing.
+  if(begin == end) { begin = end = scanned = 0; }
+  else if(end == size) {
+    std::memmove(buffer.get(), buffer.get() + begin, end - begin);
+    end -= begin;
+    scanned = scanned > begin ? scanned - begin : 0;
+    begin = 0;
+  }
+
+  //take whatever is ready, up to the space available, in one call
+  size_t got = sock.recvSome(buffer.get() + end, size - end);
+  end += got;
+  return got > 0;
+}
@@ -0,0 +1,99 @@
+/** @file */
+#pragma once
+#include <memory>
+#include <string_view>
+#include <cstddef>
+
+namespace SSocks {
+  //forward declaration
+  class TCPSocket;
+
+  /**
+   * Buffered reader for delimited and fixed-length messages on a TCPSocket.
+   * Each refill takes as much as the socket has ready (up to the buffer's capacity) in a single
+   * recv, so one system call can serve many small messages. Messages are returned as views
+   * into the reader's own buffer, which avoids allocating or copying. A view stays valid only
+   * until the next read through the same reader.\n
+   * Delimiters are found with an SSE2 or AVX2 scan where the compiler targets them, and bytes
+   * already scanned are not scanned again while waiting for the rest of a message.\n
+   * With a blocking socket each read waits until its message is complete. With a non-blocking
+   * socket a read returns false when the message hasn't fully arrived yet. Either way, check
+   * the socket's isOpen() after a false return to tell a closed connection from a pending one.
+   * (Call the read again from an EventLoop's readable callback until it returns false.)
+   * Data the reader has buffered is invisible to the socket, so don't mix reads through the
+   * reader with reads on the socket itself.
+   */
+  class BufferedReader {
+  public:
+    /**
+     * Wrap a socket.
+     * @param sock The socket to read from. It must outlive the reader.
+     * @param capacity The size of the buffer, which is also the longest message that can be read.
+     */
+    explicit BufferedReader(TCPSocket& sock, size_t capacity = 64 * 1024);
+
+    //! Copying is prohibited, as returned views point into the buffer.
+    BufferedReader(const BufferedReader&) = delete;
+
+    //! Copying is prohibited, as returned views point into the buffer.
+    BufferedReader& operator=(const BufferedReader&) = delete;
+
+    /**
+     * Read up to and including the next occurrence of a delimiter.
+     * Throws if the buffer fills without the delimiter turning up.
+     * @param delim The byte that ends the message.
+     * @param message Set to the message, not including the delimiter.
+     * @return true if a message was read; false if it isn't all here (see the class notes).
+     */
+    bool readUntil(char delim, std::string_view& message);
+
+    /**
+     * Read a line ending in "\n" or "\r\n".
+     * @param line Set to the line, without its line ending.
+     * @return true if a line was read; false if it isn't all here (see the class notes).
+     */
+    bool readLine(std::string_view& line);
+
+    /**
+     * Read exactly 'len' bytes.
+     * @param len The number of bytes to read. It may not exceed the buffer's capacity.
+     * @param data Set to the bytes read.
+     * @return true if the bytes were read; false if they aren't all here (see the class notes).
+     */
+    bool readExact(size_t len, std::string_view& data);
+
+    /**
+     * Look at the next 'len' bytes without consuming them.
+     * The bytes are read from the socket if they aren't buffered already, and a later read
+     * returns them again.
+     * @param len The number of bytes to look at. It may not exceed the buffer's capacity.
+     * @param data Set to the bytes.
+     * @return true if the bytes are available; false if they aren't all here (see the class notes).
+     */
+    bool peek(size_t len, std::string_view& data);
+
+    //! Return the number of bytes buffered but not yet read.
+    size_t buffered() const;
+
+    //! Return the capacity of the buffer.
+    size_t capacity() const;
+
+    //! Access the wrapped socket.
+    TCPSocket& socket();
+
+  private:
+    TCPSocket& sock;
+    std::unique_ptr<char[]> buffer;
+    size_t size;
+
+    //unread data occupies [begin, end); bytes before 'scanned' are known not to hold 'scannedFor'
+    size_t begin;
+    size_t end;
+    size_t scanned;
+    char scannedFor;
+
+    bool fill();
+
+  };
+
+}
@@ -0,0 +1,115 @@
+#include "cl_BufferedWriter.h"
+#include "cl_TCPSocket.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+SSocks::BufferedWriter::BufferedWriter(TCPSocket& sock, size_t capacity, float maxDelaySeconds) :
+  sock(sock), buffer(new char[capacity]), size(capacity), hasDeadline(maxDelaySeconds >= 0), begin(0), end(0) {
+  if(capacity == 0) { throw std::invalid_argument("BufferedWriter needs a nonzero capacity."); }
+  maxDelay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(hasDeadline ? maxDelaySeconds : 0));
+}
+
+SSocks::BufferedWriter::~BufferedWriter() {
+  //a destructor can't report failure, so this is best effort
+  try { if(sock.isOpen()) { flush(); } }
+  catch(const std::exception&) {}
+}
+
+size_t SSocks::BufferedWriter::write(const void* data, size_t len) {
+  const char* datap = reinterpret_cast<const char*>(data);
+
+  //slide any leftovers of a partial flush to the front to make room
+  if(begin > 0 && size - end < len) {
+    std::memmove(buffer.get(), buffer.get() + begin, end - begin);
+    end -= begin;
+    begin = 0;
+  }
+
+  //the usual case: it fits, so just keep it
+  if(len <= size - end) {
+    append(datap, len);
+    if(end == size) { flush(); }
+    else { flushIfDue(); }
+    return len;
+  }
+
+  //It doesn't fit, so send what's buffered and the new data together in a single call.
+  ConstBuffer parts[2] = { ConstBuffer(buffer.get() + begin, end - begin), ConstBuffer(datap, len) };
+  size_t sent = sock.sendv(parts, 2);
+
+  size_t fromBuffer = std::min(sent, end - begin);
+  begin += fromBuffer;
+  size_t fromData = sent - fromBuffer;
+
+  //A blocking socket took everything. A non-blocking one may have left some, in which case
+  //as much of the new data as fits is buffered to go later.
+  if(begin == end) { begin = end = 0; }
+  else if(begin > 0) {
+    std::memmove(buffer.get(), buffer.get() + begin, end - begin);
+    end -= begin;
+    begin = 0;
+  }
+  size_t take = std::min(len - fromData, size - end);
+  append(datap + fromData, take);
+
+  return fromData + take;
+}
+
+size_t SSocks::BufferedWriter::write(std::string_view data) {
+  return write(data.data(), data.size());
+}
+
+size_t SSocks::BufferedWriter::flush() {
+  if(begin == end) { return 0; }
+
+  size_t sent = sock.send(buffer.get() + begin, end - begin);
+  begin += sent;
+  if(begin == end) { begin = end = 0; }
+
+  return sent;
+}
+
+size_t SSocks::BufferedWriter::flushIfDue() {
+  if(begin == end || !hasDeadline) { return 0; }
+  if(std::chrono::steady_clock::now() - oldest < maxDelay) { return 0; }
+  return flush();
+}
+
+float SSocks::BufferedWriter::timeUntilDue() const {
+  if(begin == end || !hasDeadline) { return SELECT_FOREVER; }
+
+  std::chrono::duration<float> left = (oldest + maxDelay) - std::chrono::steady_clock::now();
+  return std::max(left.count(), 0.0f);
+}
+
+void SSocks::BufferedWriter::cork() {
+  sock.setCork(true);
+}
+
+void SSocks::BufferedWriter::uncork() {
+  flush();
+  sock.setCork(false);
+}
+
+void SSocks::BufferedWriter::setNoDelay(bool noDelay) {
+  sock.setNoDelay(noDelay);
+}
+
+size_t SSocks::BufferedWriter::buffered() const {
+  return end - begin;
+}
+
+SSocks::TCPSocket& SSocks::BufferedWriter::socket() {
+  return sock;
+}
+
+void SSocks::BufferedWriter::append(const char* data, size_t len) {
+  if(len == 0) { return; }
+
+  //the deadline runs from the first byte written into an empty buffer
+  if(begin == end) { oldest = std::chrono::steady_clock::now(); }
+
+  std::memcpy(buffer.get() + end, data, len);
+  end += len;
+}
@@ -0,0 +1,111 @@
+/** @file */
+#pragma once
+#include <memory>
+#include <string_view>
+#include <chrono>
+#include <cstddef>
+#include "fn_select.h"
+
+namespace SSocks {
+  //forward declaration
+  class TCPSocket;
+
+  /**
+   * Write-coalescing buffer over a TCPSocket.
+   * Small writes are gathered in the writer's buffer and sent together, so a burst of them
+   * costs one system call (and usually one TCP segment) instead of one each. The buffer is
+   * flushed when it fills, when flush() is called, or once its oldest byte has waited longer
+   * than the maximum delay. A write too big for the buffer goes out in the same call as
+   * whatever was already buffered.\n
+   * There's no timer thread, so the delay is checked on each write and by flushIfDue(). With
+   * an EventLoop, pass timeUntilDue() as the runOnce() timeout and call flushIfDue() after it.\n
+   * With a non-blocking socket a flush may leave data behind, which the next flush continues.
+   * Don't write to the socket directly while the writer holds data, or the bytes will go out
+   * of order.
+   */
+  class BufferedWriter {
+  public:
+    /**
+     * Wrap a socket.
+     * @param sock The socket to write to. It must outlive the writer.
+     * @param capacity The size of the buffer. It is flushed whenever it fills.
+     * @param maxDelaySeconds The longest buffered data may wait before being flushed. SELECT_FOREVER
+     * disables the deadline, so data waits until the buffer fills or flush() is called.
+     */
+    explicit BufferedWriter(TCPSocket& sock, size_t capacity = 16 * 1024, float maxDelaySeconds = SELECT_FOREVER);
+
+    //! Copying is prohibited, as the writer holds unsent data.
+    BufferedWriter(const BufferedWriter&) = delete;
+
+    //! Copying is prohibited, as the writer holds unsent data.
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    //! Destructor. Flushes whatever the socket will take; errors are ignored.
+    ~BufferedWriter();
+
+    /**
+     * Write data through the buffer.
+     * @param data A pointer to the data to write.
+     * @param len The number of bytes to write.
+     * @return The number of bytes accepted (buffered or sent). This is always 'len' for a
+     * blocking socket, but may be less for a non-blocking one whose buffers are all full.
+     */
+    size_t write(const void* data, size_t len);
+
+    //! @copydoc write(const void*, size_t)
+    size_t write(std::string_view data);
+
+    /**
+     * Send everything buffered, in one system call.
+     * @return The number of bytes sent.
+     */
+    size_t flush();
+
+    /**
+     * Flush if the oldest buffered byte has waited longer than the maximum delay.
+     * @return The number of bytes sent.
+     */
+    size_t flushIfDue();
+
+    /**
+     * Return the number of seconds until the buffered data is due to be flushed.
+     * @return Zero if it is already due, or SELECT_FOREVER if nothing is buffered or there's no deadline.
+     */
+    float timeUntilDue() const;
+
+    /**
+     * Cork the socket, so that the kernel sends only full-sized segments. (TCP_CORK.)
+     * Useful around a response assembled from several writes and flushes.
+     * @see TCPSocket::setCork()
+     */
+    void cork();
+
+    //! Flush the buffer and uncork the socket, sending everything held at once.
+    void uncork();
+
+    //! Set whether small writes leave the kernel immediately. (TCP_NODELAY.) @see TCPSocket::setNoDelay()
+    void setNoDelay(bool noDelay);
+
+    //! Return the number of bytes buffered but not yet sent.
+    size_t buffered() const;
+
+    //! Access the wrapped socket.
+    TCPSocket& socket();
+
+  private:
+    TCPSocket& sock;
+    std::unique_ptr<char[]> buffer;
+    size_t size;
+    std::chrono::steady_clock::duration maxDelay;
+    bool hasDeadline;
+
+    //unsent data occupies [begin, end); 'oldest' is when the first of it was written
+    size_t begin;
+    size_t end;
+    std::chrono::steady_clock::time_point oldest;
+
+    void append(const char* data, size_t len);
+
+  };
+
+}
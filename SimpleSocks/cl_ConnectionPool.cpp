@@ -0,0 +1,249 @@
+#include "cl_ConnectionPool.h"
+#include "ns_Platform.h"
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+
+SSocks::ConnectionPool::ConnectionPool(const ConnectionPoolLimits& limits, const SocketOptions& options) :
+  limits(limits), options(options) {
+  //nothing
+}
+
+SSocks::ConnectionPool::~ConnectionPool() {
+  clear();
+}
+
+SSocks::TCPSocket SSocks::ConnectionPool::acquire(const HostAddress& host, float timeoutSeconds) {
+  Clock::time_point deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(std::max(timeoutSeconds, 0.0f)));
+  bool waited = false;
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  //Entries are never erased, so this reference stays good while the lock is let go.
+  Host& entry = hosts[host];
+
+  while(true) {
+    //take the most recently used idle connection, skipping any that have died
+    while(!entry.idle.empty()) {
+      TCPSocket sock = std::move(entry.idle.back().sock);
+      entry.idle.pop_back();
+      entry.active++;
+
+      //check it without holding up everyone else
+      lock.unlock();
+      bool reusable = isReusable(sock);
+      lock.lock();
+
+      if(reusable) {
+        counters.hits++;
+        return sock;
+      }
+      entry.active--;
+      counters.stale++;
+    }
+
+    //nothing idle, so open a new connection if the limit allows
+    if(hasRoom(entry)) {
+      entry.active++;
+      counters.misses++;
+      lock.unlock();
+
+      try { return open(host); }
+      catch(...) {
+        lock.lock();
+        entry.active--;
+        entry.released.notify_one(); //a waiter may make its own attempt
+        throw;
+      }
+    }
+
+    //otherwise wait for someone to release one
+    if(!waited) {
+      counters.waits++;
+      waited = true;
+    }
+    if(timeoutSeconds < 0) { entry.released.wait(lock); }
+    else if(entry.released.wait_until(lock, deadline) == std::cv_status::timeout) {
+      throw std::runtime_error("Timed out waiting for a pooled connection.");
+    }
+  }
+}
+
+void SSocks::ConnectionPool::release(const HostAddress& host, TCPSocket sock) {
+  Host* entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    entry = &hosts[host];
+    if(entry->active > 0) { entry->active--; }
+
+    if(sock.isOpen() && entry->idle.size() < limits.maxIdle) {
+      if(!sock.isBlocking()) { sock.setBlocking(true); }
+      entry->idle.push_back(Idle{ std::move(sock), Clock::now() });
+    }
+    else if(sock.isOpen()) {
+      counters.evictions++;
+    }
+  }
+
+  //either a connection or room for one has come free (entries are never erased, so this is safe unlocked)
+  entry->released.notify_one();
+
+  //anything not kept is closed here, outside the lock
+}
+
+size_t SSocks::ConnectionPool::prewarm(const HostAddress& host, size_t count) {
+  size_t opened = 0;
+
+  while(true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      Host& entry = hosts[host];
+      if(entry.idle.size() >= count || !hasRoom(entry)) { break; }
+      entry.active++;
+    }
+
+    //open outside the lock, then file the connection as idle
+    TCPSocket sock;
+    try { sock = open(host); }
+    catch(...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      hosts[host].active--;
+      throw;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Host& entry = hosts[host];
+    entry.active--;
+    entry.idle.push_back(Idle{ std::move(sock), Clock::now() });
+    entry.released.notify_all();
+    opened++;
+  }
+
+  return opened;
+}
+
+void SSocks::ConnectionPool::maintain() {
+  struct Checking {
+    Host* entry;
+    size_t taken;
+    std::vector<Idle> idle;
+  };
+  std::vector<Checking> checking;
+
+  //Take the idle connections out to check them without holding up everyone else. They count
+  //as active meanwhile, so the per-host limit still holds (entries are never erased, so the
+  //pointers stay good).
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto& pair : hosts) {
+      Host& entry = pair.second;
+      if(entry.idle.empty()) { continue; }
+      entry.active += entry.idle.size();
+      checking.push_back(Checking{ &entry, entry.idle.size(), std::move(entry.idle) });
+      entry.idle.clear();
+    }
+  }
+
+  //drop the dead ones, keeping the rest oldest first
+  std::vector<TCPSocket> closing;
+  for(Checking& host : checking) {
+    std::vector<Idle> live;
+    for(Idle& conn : host.idle) {
+      if(isReusable(conn.sock)) { live.push_back(std::move(conn)); }
+      else { closing.push_back(std::move(conn.sock)); }
+    }
+    host.idle = std::move(live);
+  }
+
+  std::vector<std::pair<HostAddress, size_t>> shortfall;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.stale += closing.size();
+    Clock::time_point expiry = Clock::now() - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(limits.idleTimeout));
+
+    for(Checking& host : checking) {
+      Host& entry = *host.entry;
+      entry.active -= host.taken;
+
+      //anything released meanwhile is newer, so the survivors go back in front of it
+      std::vector<Idle>& idle = entry.idle;
+      idle.insert(idle.begin(), std::make_move_iterator(host.idle.begin()), std::make_move_iterator(host.idle.end()));
+
+      //the oldest are at the front; evict those that have timed out, down to the minimum
+      size_t expired = 0;
+      while(expired < idle.size() && idle.size() - expired > limits.minIdle && idle[expired].since < expiry) {
+        closing.push_back(std::move(idle[expired].sock));
+        expired++;
+      }
+      idle.erase(idle.begin(), idle.begin() + expired);
+      counters.evictions += expired;
+
+      //connections or room for them have come back
+      entry.released.notify_all();
+    }
+
+    for(auto& pair : hosts) {
+      if(pair.second.idle.size() < limits.minIdle) { shortfall.emplace_back(pair.first, limits.minIdle); }
+    }
+  }
+
+  //close outside the lock, then top up
+  closing.clear();
+  for(auto& host : shortfall) {
+    try { prewarm(host.first, host.second); }
+    catch(const std::runtime_error&) {}
+  }
+}
+
+size_t SSocks::ConnectionPool::idle(const HostAddress& host) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto iter = hosts.find(host);
+  return iter == hosts.end() ? 0 : iter->second.idle.size();
+}
+
+SSocks::ConnectionPool::Stats SSocks::ConnectionPool::stats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return counters;
+}
+
+void SSocks::ConnectionPool::clear() {
+  std::vector<TCPSocket> closing;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto& pair : hosts) {
+      for(Idle& idle : pair.second.idle) { closing.push_back(std::move(idle.sock)); }
+      pair.second.idle.clear();
+      pair.second.released.notify_all();
+    }
+  }
+}
+
+SSocks::TCPSocket SSocks::ConnectionPool::open(const HostAddress& host) {
+  TCPSocket sock;
+  sock.setOptions(options);
+  sock.connect(host, limits.connectTimeout);
+  return sock;
+}
+
+bool SSocks::ConnectionPool::hasRoom(const Host& entry) const {
+  return limits.maxPerHost == 0 || entry.active + entry.idle.size() < limits.maxPerHost;
+}
+
+//An idle connection should have nothing to read. If it does then either the server has hung
+//up (a read would see end-of-file) or it has sent something nobody asked for, and either way
+//the connection can't be handed out.
+bool SSocks::ConnectionPool::isReusable(const TCPSocket& sock) {
+  if(!sock.isOpen()) { return false; }
+
+  #ifdef MSG_DONTWAIT
+  char byte;
+  int result = ::recv(sock.sock, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+  return result == Utility::Platform::SOCK_ERROR && Utility::Platform::wouldBlock(Utility::Platform::lastError());
+  #else
+  //without MSG_DONTWAIT, ask whether it's readable without waiting
+  pollfd pfd = { 0 };
+  pfd.fd = sock.sock;
+  pfd.events = POLLIN;
+  return Utility::Platform::poll(&pfd, 1, 0) == 0;
+  #endif
+}
@@ -0,0 +1,147 @@
+/** @file */
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include "cl_TCPSocket.h"
+#include "cl_HostAddress.h"
+#include "cl_SocketOptions.h"
+#include "fn_select.h"
+
+namespace SSocks {
+
+  //! Limits for a ConnectionPool.
+  struct ConnectionPoolLimits {
+    //! Idle connections per host that maintain() keeps open, and won't evict.
+    size_t minIdle = 0;
+    //! The most idle connections kept per host. Connections released beyond this are closed.
+    size_t maxIdle = 8;
+    //! The most connections per host, idle and checked out together. Zero means no limit.
+    //! When the limit is reached acquire() waits for a connection to be released.
+    size_t maxPerHost = 0;
+    //! Seconds a connection may sit idle before maintain() closes it.
+    float idleTimeout = 60;
+    //! The longest to wait when opening a new connection. @see TCPSocket::connect(const HostAddress&, float)
+    float connectTimeout = SELECT_FOREVER;
+  };
+
+  /**
+   * Pool of client connections, kept open for reuse and grouped by the host they go to.
+   * acquire() hands out an idle connection to the host if there is one, or opens a new one.
+   * release() takes it back for the next request, so a run of requests to the same server pays
+   * for the handshake (and TCP slow start) once rather than every time.\n
+   * Every connection that acquire() returns must be handed back to release(), even if it was
+   * closed, so that the pool can keep count. Handing back a connection in the middle of an
+   * exchange (with a reply still unread, say) is a mistake, as the next user would see it.\n
+   * Idle connections are checked before they are handed out, which costs one non-blocking
+   * system call. One that the server has closed (or that has unexpected data waiting) is
+   * discarded. There's no background thread; call maintain() now and then to close connections
+   * that have sat idle too long and to top each host back up to the minimum.\n
+   * Every member function is safe to call from any thread. The pool must outlive the
+   * connections it hands out.
+   */
+  class ConnectionPool {
+  public:
+    //! Counters describing how the pool has been used.
+    struct Stats {
+      //! acquire() calls served by an idle connection.
+      uint64_t hits = 0;
+      //! acquire() calls that had to open a new connection.
+      uint64_t misses = 0;
+      //! acquire() calls that had to wait for the per-host limit.
+      uint64_t waits = 0;
+      //! Idle connections found dead (or with stray data) when checked out or maintained.
+      uint64_t stale = 0;
+      //! Idle connections closed for being idle too long or beyond maxIdle.
+      uint64_t evictions = 0;
+    };
+
+    /**
+     * Create an empty pool.
+     * @param limits The pool's limits.
+     * @param options Tuning options for the connections the pool opens.
+     */
+    explicit ConnectionPool(const ConnectionPoolLimits& limits = ConnectionPoolLimits(), const SocketOptions& options = SocketOptions());
+
+    //! Copying is prohibited, as the pool owns its connections.
+    ConnectionPool(const ConnectionPool&) = delete;
+
+    //! Copying is prohibited, as the pool owns its connections.
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    //! Destructor. Closes the idle connections.
+    ~ConnectionPool();
+
+    /**
+     * Check out a connection to a host, opening one if none is idle.
+     * The connection is in blocking mode.
+     * @param host The host to connect to.
+     * @param timeoutSeconds The longest to wait for the per-host limit. SELECT_FOREVER waits indefinitely.
+     * @throw std::runtime_error if a new connection fails or the wait times out.
+     */
+    TCPSocket acquire(const HostAddress& host, float timeoutSeconds = SELECT_FOREVER);
+
+    /**
+     * Return a connection to the pool.
+     * A connection that is closed, or that would exceed maxIdle, is dropped.
+     * @param host The host passed to acquire().
+     * @param sock The connection acquire() returned.
+     */
+    void release(const HostAddress& host, TCPSocket sock);
+
+    /**
+     * Open connections to a host ahead of time, so that the first requests find them idle.
+     * Opens connections until 'count' are idle, within the per-host limit.
+     * @return The number of connections opened.
+     * @throw std::runtime_error if a connection fails. Those opened before it are kept.
+     */
+    size_t prewarm(const HostAddress& host, size_t count);
+
+    /**
+     * Close idle connections that have timed out or died, and top each host back up to minIdle.
+     * Meant to be called periodically, for example from a timer on an EventLoop.
+     * Failures to open connections are ignored; the next acquire() will report them.
+     */
+    void maintain();
+
+    //! Return the number of idle connections to a host.
+    size_t idle(const HostAddress& host) const;
+
+    //! Return a snapshot of the counters.
+    Stats stats() const;
+
+    //! Close every idle connection.
+    void clear();
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Idle {
+      TCPSocket sock;
+      Clock::time_point since;
+    };
+
+    struct Host {
+      std::vector<Idle> idle; //most recently used at the back, so the warmest goes out first
+      size_t active = 0; //checked out or being opened
+      //acquire() waits here for this host's limit, so a release for one host doesn't wake another's waiters
+      std::condition_variable released;
+    };
+
+    ConnectionPoolLimits limits;
+    SocketOptions options;
+
+    mutable std::mutex mutex;
+    std::unordered_map<HostAddress, Host> hosts;
+    Stats counters;
+
+    TCPSocket open(const HostAddress& host);
+    bool hasRoom(const Host& entry) const;
+    static bool isReusable(const TCPSocket& sock);
+
+  };
+
+}
@@ -0,0 +1,39 @@
+#include "cl_Deadline.h"
+#include <algorithm>
+#include <climits>
+
+SSocks::Deadline::Deadline() : when(Clock::time_point::max()) {
+  //nothing
+}
+
+SSocks::Deadline::Deadline(Clock::time_point when) : when(when) {
+  //nothing
+}
+
+SSocks::Deadline SSocks::Deadline::after(float seconds) {
+  if(seconds < 0) { return Deadline(); }
+  return Deadline(Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(seconds)));
+}
+
+bool SSocks::Deadline::isForever() const {
+  return when == Clock::time_point::max();
+}
+
+bool SSocks::Deadline::hasPassed() const {
+  return !isForever() && Clock::now() >= when;
+}
+
+int SSocks::Deadline::remainingMs() const {
+  if(isForever()) { return -1; }
+
+  Clock::time_point now = Clock::now();
+  if(now >= when) { return 0; }
+
+  //round up, so that a wait doesn't wake just short of the deadline and spin
+  auto left = std::chrono::ceil<std::chrono::milliseconds>(when - now).count();
+  return static_cast<int>(std::min<decltype(left)>(left, INT_MAX));
+}
+
+SSocks::Deadline::Clock::time_point SSocks::Deadline::getTime() const {
+  return when;
+}
@@ -0,0 +1,48 @@
+/** @file */
+#pragma once
+#include <chrono>
+
+namespace SSocks {
+
+  /**
+   * A point in time by which an operation must finish, as taken by the deadline overloads of
+   * TCPSocket and UDPSocket.
+   * Unlike a timeout, a deadline doesn't restart with each partial read or write, so one
+   * deadline can bound a whole exchange made of several calls. It can be built from a
+   * std::chrono::steady_clock time point, or from a number of seconds with after().
+   */
+  class Deadline {
+  public:
+    //! The clock deadlines are measured against.
+    typedef std::chrono::steady_clock Clock;
+
+    //! Construct a deadline that never passes.
+    Deadline();
+
+    //! Construct a deadline at the indicated time.
+    Deadline(Clock::time_point when);
+
+    /**
+     * Construct a deadline the indicated number of seconds from now.
+     * @param seconds Seconds from now. A negative value (such as SELECT_FOREVER) never passes.
+     */
+    static Deadline after(float seconds);
+
+    //! Return true if this deadline never passes.
+    bool isForever() const;
+
+    //! Return true if the deadline has passed.
+    bool hasPassed() const;
+
+    //! Return the milliseconds left, rounded up: zero if the deadline has passed, or -1 if it never will.
+    int remainingMs() const;
+
+    //! Return the time of the deadline. Clock::time_point::max() means never.
+    Clock::time_point getTime() const;
+
+  private:
+    Clock::time_point when;
+
+  };
+
+}
@@ -0,0 +1,333 @@
+#include "cl_EventLoop.h"
+#include "cl_TCPSocket.h"
+#include "cl_TCPServer.h"
+#include "cl_UDPSocket.h"
+#include "ns_Platform.h"
+#include <iterator>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+////////////////////////////WAKER////////////////////////////
+
+#ifdef __linux__
+
+//On Linux an eventfd is the cheapest way to interrupt a wait: one counter, no buffers.
+struct SSocks::EventLoop::Waker {
+  int fd;
+
+  Waker() : fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    if(fd == -1) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
+  }
+
+  ~Waker() { ::close(fd); }
+
+  void signal() {
+    uint64_t one = 1;
+    //the only possible failure is a saturated counter, which still leaves the loop woken
+    ssize_t result = ::write(fd, &one, sizeof(one));
+    (void)result;
+  }
+
+  void drain() {
+    uint64_t count;
+    ssize_t result = ::read(fd, &count, sizeof(count));
+    (void)result;
+  }
+};
+
+#else
+
+//Elsewhere a UDP socket connected to itself on the loopback interface does the same job.
+struct SSocks::EventLoop::Waker {
+  int fd;
+
+  Waker() {
+    //TSock releases the socket if any of the setup fails
+    Utility::TSock tsock(SOCK_DGRAM, IPPROTO_UDP);
+
+    //bind an ephemeral loopback port, find out which one we got, and connect to it
+    sockaddr_in self = { 0 };
+    self.sin_family = AF_INET;
+    self.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Utility::Platform::AddrLen len = sizeof(self);
+    if(bind(tsock, reinterpret_cast<sockaddr*>(&self), sizeof(self)) ||
+       getsockname(tsock, reinterpret_cast<sockaddr*>(&self), &len) ||
+       ::connect(tsock, reinterpret_cast<sockaddr*>(&self), sizeof(self)) ||
+       !Utility::Platform::setBlocking(tsock, false)) {
+      throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError()));
+    }
+
+    fd = tsock.validate();
+  }
+
+  ~Waker() { Utility::Platform::closeSocket(fd); }
+
+  void signal() {
+    char byte = 0;
+    ::send(fd, &byte, 1, 0);
+  }
+
+  void drain() {
+    char buffer[64];
+    while(::recv(fd, buffer, sizeof(buffer), 0) > 0) {}
+  }
+};
+
+#endif
+
+////////////////////////////EVENTLOOP////////////////////////////
+
+SSocks::EventLoop::EventLoop() : events(256), wakePending(false), stopping(false), waker(new Waker) {
+  poller.addSock(waker->fd, Poller::READ, waker.get(), waker.get());
+}
+
+SSocks::EventLoop::~EventLoop() {
+  //nothing - the sockets being watched are not owned by the loop
+}
+
+void SSocks::EventLoop::watch(TCPSocket& sock, Callback onReadable, Callback onWritable) {
+  if(!sock.isOpen()) { throw std::runtime_error("Attempted to watch closed TCPSocket."); }
+  sock.setBlocking(false);
+  watchSock(&sock, sock.sock, nullptr, std::move(onReadable), std::move(onWritable), AcceptCallback());
+}
+
+void SSocks::EventLoop::watch(UDPSocket& sock, Callback onReadable, Callback onWritable) {
+  if(!sock.isOpen()) { throw std::runtime_error("Attempted to watch closed UDPSocket."); }
+  sock.setBlocking(false);
+  watchSock(&sock, sock.sock, nullptr, std::move(onReadable), std::move(onWritable), AcceptCallback());
+}
+
+void SSocks::EventLoop::watch(TCPServer& server, AcceptCallback onAccept) {
+  if(!server.isOpen()) { throw std::runtime_error("Attempted to watch closed TCPServer."); }
+  server.setBlocking(false);
+  watchSock(&server, server.sock, &server, Callback(), Callback(), std::move(onAccept));
+}
+
+void SSocks::EventLoop::unwatch(TCPSocket& sock)   { unwatchSock(&sock); }
+void SSocks::EventLoop::unwatch(UDPSocket& sock)   { unwatchSock(&sock); }
+void SSocks::EventLoop::unwatch(TCPServer& server) { unwatchSock(&server); }
+
+void SSocks::EventLoop::watchSock(const void* key, int sock, TCPServer* server, Callback onReadable, Callback onWritable, AcceptCallback onAccept) {
+  uint32_t interest = 0;
+  if(onReadable || onAccept) { interest |= Poller::READ; }
+  if(onWritable) { interest |= Poller::WRITE; }
+
+  auto iter = handlers.find(key);
+  if(iter != handlers.end()) {
+    //already watched, so just swap the callbacks and interest
+    Handler& handler = *iter->second;
+    if(handler.oneShot) { throw std::runtime_error("Attempted to watch a socket that has a wait pending."); }
+    handler.onReadable = std::move(onReadable);
+    handler.onWritable = std::move(onWritable);
+    handler.onAccept = std::move(onAccept);
+    poller.modifySock(sock, interest, &handler);
+    return;
+  }
+
+  std::unique_ptr<Handler> handler(new Handler{ key, sock, server, std::move(onReadable), std::move(onWritable), std::move(onAccept), true, false });
+  poller.addSock(sock, interest, handler.get(), key);
+  handlers[key] = std::move(handler);
+}
+
+void SSocks::EventLoop::unwatchSock(const void* key) {
+  auto iter = handlers.find(key);
+  if(iter == handlers.end()) { return; }
+
+  //If the socket has already closed itself then the kernel has dropped the registration too,
+  //and the handle may since have been reused by another socket, which keeps its registration.
+  poller.removeSock(iter->second->sock, key);
+
+  //The handler may be running right now, or may have an event later in the current batch,
+  //so it is deactivated and parked rather than destroyed.
+  iter->second->active = false;
+  retired.push_back(std::move(iter->second));
+  handlers.erase(iter);
+}
+
+void SSocks::EventLoop::waitReadable(TCPSocket& sock, Callback onReady) {
+  if(!sock.isOpen()) { throw std::runtime_error("Attempted to wait on closed TCPSocket."); }
+  if(sock.isBlocking()) { sock.setBlocking(false); }
+  waitSock(&sock, sock.sock, false, std::move(onReady));
+}
+
+void SSocks::EventLoop::waitReadable(UDPSocket& sock, Callback onReady) {
+  if(!sock.isOpen()) { throw std::runtime_error("Attempted to wait on closed UDPSocket."); }
+  if(sock.isBlocking()) { sock.setBlocking(false); }
+  waitSock(&sock, sock.sock, false, std::move(onReady));
+}
+
+void SSocks::EventLoop::waitReadable(TCPServer& server, Callback onReady) {
+  if(!server.isOpen()) { throw std::runtime_error("Attempted to wait on closed TCPServer."); }
+  if(server.isBlocking()) { server.setBlocking(false); }
+  waitSock(&server, server.sock, false, std::move(onReady));
+}
+
+void SSocks::EventLoop::waitWritable(TCPSocket& sock, Callback onReady) {
+  if(!sock.isOpen()) { throw std::runtime_error("Attempted to wait on closed TCPSocket."); }
+  if(sock.isBlocking()) { sock.setBlocking(false); }
+  waitSock(&sock, sock.sock, true, std::move(onReady));
+}
+
+void SSocks::EventLoop::waitWritable(UDPSocket& sock, Callback onReady) {
+  if(!sock.isOpen()) { throw std::runtime_error("Attempted to wait on closed UDPSocket."); }
+  if(sock.isBlocking()) { sock.setBlocking(false); }
+  waitSock(&sock, sock.sock, true, std::move(onReady));
+}
+
+void SSocks::EventLoop::waitSock(const void* key, int sock, bool write, Callback onReady) {
+  Handler* handler;
+
+  auto iter = handlers.find(key);
+  if(iter != handlers.end()) {
+    handler = iter->second.get();
+    if(!handler->oneShot) { throw std::runtime_error("Attempted to wait on a socket that is being watched."); }
+  }
+  else {
+    std::unique_ptr<Handler> fresh(new Handler{ key, sock, nullptr, Callback(), Callback(), AcceptCallback(), true, true });
+    handler = fresh.get();
+    poller.addSock(sock, 0, handler, key);
+    handlers[key] = std::move(fresh);
+  }
+
+  (write ? handler->onWritable : handler->onReadable) = std::move(onReady);
+
+  uint32_t interest = 0;
+  if(handler->onReadable) { interest |= Poller::READ; }
+  if(handler->onWritable) { interest |= Poller::WRITE; }
+  poller.modifySock(sock, interest, handler);
+}
+
+//Take a one-shot callback out of its slot, drop the interest it held (or the whole
+//registration if nothing else is waiting), and only then invoke it, so that it can wait again.
+void SSocks::EventLoop::fireOnce(Handler& handler, Callback& slot) {
+  Callback callback = std::move(slot);
+  slot = nullptr;
+
+  if(!handler.onReadable && !handler.onWritable) { unwatchSock(handler.key); }
+  else { poller.modifySock(handler.sock, handler.onReadable ? Poller::READ : Poller::WRITE, &handler); }
+
+  callback();
+}
+
+void SSocks::EventLoop::post(Callback task) {
+  {
+    std::lock_guard<std::mutex> lock(taskMutex);
+    tasks.push_back(std::move(task));
+  }
+
+  //only the first post since the loop last drained needs to pay for a wakeup
+  if(!wakePending.exchange(true)) { waker->signal(); }
+}
+
+void SSocks::EventLoop::stop() {
+  stopping = true;
+  if(!wakePending.exchange(true)) { waker->signal(); }
+}
+
+void SSocks::EventLoop::run() {
+  while(!stopping) { runOnce(); }
+
+  //re-arm for the next run() here rather than on entry, so a stop() that lands before run() starts isn't lost
+  stopping = false;
+}
+
+size_t SSocks::EventLoop::runOnce(float timeoutSeconds) {
+  size_t count = poller.wait(events, timeoutSeconds);
+  size_t dispatched = 0;
+
+  for(size_t i = 0; i < count; i++) {
+    const Poller::Event& ev = events[i];
+
+    if(ev.userData == waker.get()) {
+      waker->drain();
+      continue;
+    }
+
+    Handler* handler = static_cast<Handler*>(ev.userData);
+
+    //Errors and hang-ups are delivered as readability, since the next read will report them.
+    if(ev.flags & (Poller::READ | Poller::FAULT)) {
+      if(handler->server) {
+        if(handler->active && handler->onAccept) { acceptAll(*handler); dispatched++; }
+      }
+      else if(handler->active && handler->onReadable) {
+        if(handler->oneShot) { fireOnce(*handler, handler->onReadable); }
+        else { handler->onReadable(); }
+        dispatched++;
+      }
+    }
+
+    //The read callback may have unwatched the socket, so check again. A failure also ends a
+    //wait for writability, as with a connection that was refused.
+    bool writable = (ev.flags & Poller::WRITE) || (handler->oneShot && (ev.flags & Poller::FAULT));
+    if(writable && handler->active && handler->onWritable) {
+      if(handler->oneShot) { fireOnce(*handler, handler->onWritable); }
+      else { handler->onWritable(); }
+      dispatched++;
+    }
+  }
+
+  //everything unwatched during this round can go now
+  retired.clear();
+
+  dispatched += runTasks();
+  return dispatched;
+}
+
+void SSocks::EventLoop::acceptAll(Handler& handler) {
+  //drain the backlog until accept() would block
+  while(handler.active) {
+    int err;
+    TCPSocket sock = handler.server->acceptSock(err);
+    if(sock.isOpen()) {
+      handler.onAccept(std::move(sock));
+      continue;
+    }
+
+    //a connection that died in the backlog says nothing about the ones queued behind it
+    if(Utility::Platform::acceptAborted(err)) { continue; }
+
+    //Out of descriptors or buffers, leave the rest queued and try again next round, by when
+    //some connections may have closed. Anything else means the listener itself has failed.
+    if(Utility::Platform::wouldBlock(err) || Utility::Platform::outOfResources(err)) { break; }
+    throw std::runtime_error(Utility::lastErrStr(err));
+  }
+}
+
+size_t SSocks::EventLoop::runTasks() {
+  //clearing the flag before taking the queue means a post() racing with us will signal again
+  wakePending = false;
+
+  {
+    std::lock_guard<std::mutex> lock(taskMutex);
+    running.swap(tasks);
+  }
+
+  //tasks run outside the lock so they're free to post more work
+  size_t count = running.size();
+  for(size_t i = 0; i < count; i++) {
+    try { running[i](); }
+    catch(...) {
+      //Drop the task that threw and those already run, and queue the rest ahead of anything
+      //posted since, so that a caller who runs the loop again loses nothing and repeats nothing.
+      bool queued;
+      {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        tasks.insert(tasks.begin(), std::make_move_iterator(running.begin() + i + 1), std::make_move_iterator(running.end()));
+        queued = !tasks.empty();
+      }
+      running.clear();
+      if(queued && !wakePending.exchange(true)) { waker->signal(); }
+      throw;
+    }
+  }
+  running.clear();
+
+  return count;
+}
+
+size_t SSocks::EventLoop::size() const {
+  return handlers.size();
+}
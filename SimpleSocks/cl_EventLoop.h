@@ -0,0 +1,164 @@
+/** @file */
+#pragma once
+#include <functional>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include "cl_Poller.h"
+
+namespace SSocks {
+  //forward declarations
+  class TCPSocket;
+  class TCPServer;
+  class UDPSocket;
+
+  /**
+   * Single-threaded reactor that dispatches readiness callbacks for registered sockets.
+   * Sockets are registered with watch(), which switches them to non-blocking mode, and the loop
+   * is driven by run() or runOnce() on one thread. Whenever a socket becomes readable or
+   * writable the matching callback is invoked on that thread. A watched TCPServer accepts every
+   * pending connection itself and hands each one to its callback.\n
+   * post() and stop() may be called from any thread; everything else belongs to the loop's
+   * thread. Callbacks may watch and unwatch sockets (including their own) freely.\n
+   * The loop does not own the sockets, and identifies them by address, so a watched socket
+   * object must stay in place until it is unwatched. Unwatch a socket before destroying it, or
+   * from the callback in which it was closed. (TCPSocket closes itself when recv() sees the
+   * remote host hang up, so the usual pattern is to check isOpen() after reading and unwatch
+   * there.)
+   */
+  class EventLoop {
+  public:
+    //! Callback for readiness on a socket, and for tasks posted to the loop.
+    typedef std::function<void()> Callback;
+
+    //! Callback invoked with each connection accepted by a watched TCPServer.
+    typedef std::function<void(TCPSocket sock)> AcceptCallback;
+
+    //! Create an idle event loop.
+    EventLoop();
+
+    //! Copying is prohibited, as the loop owns system resources.
+    EventLoop(const EventLoop&) = delete;
+
+    //! Copying is prohibited, as the loop owns system resources.
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    //! Destructor. Tasks that were posted but never run are discarded.
+    ~EventLoop();
+
+    /**
+     * Watch a socket for readiness, or change the callbacks of a socket already being watched.
+     * @param sock The socket to watch. It must be open, and will be set to non-blocking mode.
+     * @param onReadable Invoked whenever the socket has data (or a closure) waiting to be read. May be empty.
+     * @param onWritable Invoked whenever the socket can be written to. Leave this empty unless
+     * there is data waiting to be sent, since an idle socket is almost always writable.
+     */
+    void watch(TCPSocket& sock, Callback onReadable, Callback onWritable = Callback());
+    //! @copydoc watch(TCPSocket&, Callback, Callback)
+    void watch(UDPSocket& sock, Callback onReadable, Callback onWritable = Callback());
+
+    /**
+     * Watch a server for incoming connections.
+     * @param server The server to watch. It must be open, and will be set to non-blocking mode.
+     * @param onAccept Invoked once for each accepted connection.
+     */
+    void watch(TCPServer& server, AcceptCallback onAccept);
+
+    /**
+     * Wait once for a socket to become readable, then stop waiting and invoke the callback.
+     * Read and write waits are separate, so one of each may be pending at a time; waiting
+     * again replaces the pending callback. A socket can't be waited on while it's watched with
+     * watch(), or the other way around. unwatch() cancels pending waits without invoking them.
+     * This is what the coroutine functions (see fn_async.h) are built on.
+     * @param sock The socket to wait on. It must be open, and will be set to non-blocking mode.
+     * @param onReady Invoked once, when the socket is readable or has failed.
+     */
+    void waitReadable(TCPSocket& sock, Callback onReady);
+    //! @copydoc waitReadable(TCPSocket&, Callback)
+    void waitReadable(UDPSocket& sock, Callback onReady);
+    //! Wait once for a server to have a connection ready to accept. @see waitReadable(TCPSocket&, Callback)
+    void waitReadable(TCPServer& server, Callback onReady);
+
+    /**
+     * Wait once for a socket to become writable (or for a connection to finish), then stop
+     * waiting and invoke the callback. @see waitReadable(TCPSocket&, Callback)
+     */
+    void waitWritable(TCPSocket& sock, Callback onReady);
+    //! @copydoc waitWritable(TCPSocket&, Callback)
+    void waitWritable(UDPSocket& sock, Callback onReady);
+
+    //! Stop watching a socket. Sockets that are not being watched are ignored.
+    void unwatch(TCPSocket& sock);
+    //! @copydoc unwatch(TCPSocket&)
+    void unwatch(UDPSocket& sock);
+    //! @copydoc unwatch(TCPSocket&)
+    void unwatch(TCPServer& server);
+
+    /**
+     * Queue a task to run on the loop's thread.
+     * This is safe to call from any thread, and wakes the loop if it is waiting.
+     */
+    void post(Callback task);
+
+    /**
+     * Dispatch callbacks until stop() is called.
+     * Posted tasks run after each round of socket callbacks. An exception thrown by a callback
+     * or task ends the round and propagates out; calling run() again carries on from there.
+     */
+    void run();
+
+    /**
+     * Wait for one round of readiness, dispatch its callbacks, and run any posted tasks.
+     * @param timeoutSeconds The maximum number of seconds to wait. SELECT_FOREVER waits indefinitely and zero just checks.
+     * @return The number of socket callbacks and tasks that were run.
+     */
+    size_t runOnce(float timeoutSeconds = SELECT_FOREVER);
+
+    //! Make run() return after its current round. This is safe to call from any thread.
+    void stop();
+
+    //! Return the number of sockets being watched.
+    size_t size() const;
+
+  private:
+    struct Handler {
+      const void* key;
+      int sock; //the socket as it was registered, since the object may close itself later
+      TCPServer* server;
+      Callback onReadable;
+      Callback onWritable;
+      AcceptCallback onAccept;
+      bool active;
+      bool oneShot; //registered by waitReadable()/waitWritable() rather than watch()
+    };
+
+    Poller poller;
+    std::vector<Poller::Event> events;
+
+    //handlers are looked up by socket object; unwatched ones are parked until the current round ends
+    std::unordered_map<const void*, std::unique_ptr<Handler>> handlers;
+    std::vector<std::unique_ptr<Handler>> retired;
+
+    //cross-thread task queue
+    std::mutex taskMutex;
+    std::vector<Callback> tasks;
+    std::vector<Callback> running;
+    std::atomic<bool> wakePending;
+    std::atomic<bool> stopping;
+
+    //wakeup channel (an eventfd on Linux, a loopback UDP socket elsewhere)
+    struct Waker;
+    std::unique_ptr<Waker> waker;
+
+    void watchSock(const void* key, int sock, TCPServer* server, Callback onReadable, Callback onWritable, AcceptCallback onAccept);
+    void unwatchSock(const void* key);
+    void waitSock(const void* key, int sock, bool write, Callback onReady);
+    void fireOnce(Handler& handler, Callback& slot);
+    void acceptAll(Handler& handler);
+    size_t runTasks();
+
+  };
+
+}
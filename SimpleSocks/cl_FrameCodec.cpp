@@ -0,0 +1,157 @@
+#include "cl_FrameCodec.h"
+#include "cl_TCPSocket.h"
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+  void checkFormat(const SSocks::FrameFormat& format) {
+    switch(format.prefixBytes) {
+    case 1: case 2: case 4: case 8: break;
+    default: throw std::invalid_argument("Frame prefix width must be 1, 2, 4 or 8 bytes.");
+    }
+  }
+
+  //the largest payload a prefix of 'bytes' width can describe
+  uint64_t prefixLimit(size_t bytes) {
+    return bytes >= 8 ? UINT64_MAX : (uint64_t(1) << (bytes * 8)) - 1;
+  }
+}
+
+////////////////////////////FrameReader////////////////////////////
+
+//The buffer has to hold a whole frame at once, since frames are handed out as views of it.
+SSocks::FrameReader::FrameReader(TCPSocket& sock, const FrameFormat& format) :
+  buffer(sock, std::max<size_t>(64 * 1024, format.prefixBytes + format.maxFrame)), format(format) {
+  checkFormat(format);
+}
+
+bool SSocks::FrameReader::read(std::string_view& payload) {
+  std::string_view prefix;
+  if(!buffer.peek(format.prefixBytes, prefix)) { return false; }
+  size_t len = decodeLength(prefix);
+
+  //take the prefix and payload together so that neither is consumed until both are here
+  std::string_view frame;
+  if(!buffer.readExact(format.prefixBytes + len, frame)) { return false; }
+  payload = frame.substr(format.prefixBytes);
+  return true;
+}
+
+size_t SSocks::FrameReader::readBatch(std::string_view* payloads, size_t maxFrames) {
+  if(maxFrames == 0) { return 0; }
+
+  //Only the first frame may go to the socket. Every frame after it is already buffered, so
+  //the buffer is never refilled (or moved) while earlier views are still out.
+  size_t count = 0;
+  if(!wholeFrameBuffered()) {
+    if(!read(payloads[0])) { return 0; }
+    count = 1;
+  }
+
+  while(count < maxFrames && wholeFrameBuffered()) { read(payloads[count++]); }
+  return count;
+}
+
+size_t SSocks::FrameReader::readBatch(std::vector<std::string_view>& payloads) {
+  payloads.clear();
+  std::string_view payload;
+
+  if(!wholeFrameBuffered()) {
+    if(!read(payload)) { return 0; }
+    payloads.push_back(payload);
+  }
+
+  while(wholeFrameBuffered()) {
+    read(payload);
+    payloads.push_back(payload);
+  }
+  return payloads.size();
+}
+
+SSocks::BufferedReader& SSocks::FrameReader::reader() {
+  return buffer;
+}
+
+bool SSocks::FrameReader::wholeFrameBuffered() {
+  if(buffer.buffered() < format.prefixBytes) { return false; }
+
+  //this can't touch the socket, as the prefix is already buffered
+  std::string_view prefix;
+  buffer.peek(format.prefixBytes, prefix);
+  return buffer.buffered() - format.prefixBytes >= decodeLength(prefix);
+}
+
+size_t SSocks::FrameReader::decodeLength(std::string_view prefix) const {
+  uint64_t len = 0;
+  for(size_t i = 0; i < format.prefixBytes; i++) {
+    size_t index = (format.order == FrameFormat::ByteOrder::BIG) ? i : format.prefixBytes - 1 - i;
+    len = (len << 8) | static_cast<unsigned char>(prefix[index]);
+  }
+
+  if(len > format.maxFrame) { throw std::runtime_error("Incoming frame is larger than the maximum frame size."); }
+  return static_cast<size_t>(len);
+}
+
+////////////////////////////FrameWriter////////////////////////////
+
+SSocks::FrameWriter::FrameWriter(TCPSocket& sock, const FrameFormat& format) :
+  sock(sock), format(format), flushed(0), queuedBytes(0) {
+  checkFormat(format);
+}
+
+void SSocks::FrameWriter::queue(ConstBuffer payload) {
+  if(payload.size > format.maxFrame || payload.size > prefixLimit(format.prefixBytes)) {
+    throw std::runtime_error("Outgoing frame is larger than the maximum frame size.");
+  }
+
+  //encode the prefix
+  uint64_t len = payload.size;
+  for(size_t i = 0; i < format.prefixBytes; i++) {
+    size_t shift = (format.order == FrameFormat::ByteOrder::BIG) ? (format.prefixBytes - 1 - i) * 8 : i * 8;
+    prefixes.push_back(static_cast<unsigned char>(len >> shift));
+  }
+
+  payloads.push_back(payload);
+  queuedBytes += format.prefixBytes + payload.size;
+}
+
+size_t SSocks::FrameWriter::flush() {
+  if(payloads.empty()) { return 0; }
+
+  //Lay out the gather list. The prefix storage may have moved since the frames were queued,
+  //so this is rebuilt each time rather than kept.
+  parts.clear();
+  for(size_t i = 0; i < payloads.size(); i++) {
+    parts.emplace_back(&prefixes[i * format.prefixBytes], format.prefixBytes);
+    parts.push_back(payloads[i]);
+  }
+
+  //skip whatever an earlier partial flush already sent
+  size_t first = 0;
+  size_t skip = flushed;
+  while(first < parts.size() && skip >= parts[first].size) { skip -= parts[first].size; first++; }
+  parts[first].data = static_cast<const char*>(parts[first].data) + skip;
+  parts[first].size -= skip;
+
+  size_t sent = sock.sendv(parts.data() + first, parts.size() - first);
+  flushed += sent;
+
+  //once everything is out the queue starts over, keeping its capacity
+  if(flushed == queuedBytes) {
+    prefixes.clear();
+    payloads.clear();
+    flushed = 0;
+    queuedBytes = 0;
+  }
+
+  return sent;
+}
+
+size_t SSocks::FrameWriter::send(ConstBuffer payload) {
+  queue(payload);
+  return flush();
+}
+
+size_t SSocks::FrameWriter::pending() const {
+  return queuedBytes - flushed;
+}
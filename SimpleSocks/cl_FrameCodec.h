@@ -0,0 +1,136 @@
+/** @file */
+#pragma once
+#include <vector>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include "cl_BufferedReader.h"
+#include "cl_BufferView.h"
+
+namespace SSocks {
+  //forward declaration
+  class TCPSocket;
+
+  /**
+   * Layout of a length-prefixed frame, shared by FrameReader and FrameWriter.
+   * Each frame is a length prefix followed by that many bytes of payload. The prefix counts
+   * the payload only.
+   */
+  struct FrameFormat {
+    //! Byte order of the length prefix.
+    enum class ByteOrder { BIG, LITTLE };
+
+    //! Width of the length prefix in bytes: 1, 2, 4 or 8.
+    size_t prefixBytes = 4;
+    //! Byte order of the length prefix. Network protocols are usually big-endian.
+    ByteOrder order = ByteOrder::BIG;
+    //! The largest payload accepted. Longer frames are treated as a protocol error.
+    size_t maxFrame = 1024 * 1024;
+  };
+
+  /**
+   * Reads length-prefixed frames from a TCPSocket.
+   * Data is read in bulk into a reusable buffer (see BufferedReader), and frames are handed out
+   * as views of that buffer, so reading a frame costs no allocation and usually no system call.
+   * A view stays valid until the next read through the same FrameReader.\n
+   * As with BufferedReader, a false return means the frame isn't all here yet on a
+   * non-blocking socket, or that the connection closed; check the socket's isOpen().
+   * A frame longer than the format's maxFrame throws, after which the stream can't be trusted
+   * and the connection should be closed.
+   */
+  class FrameReader {
+  public:
+    /**
+     * Wrap a socket.
+     * @param sock The socket to read from. It must outlive the reader.
+     * @param format The frame layout.
+     */
+    explicit FrameReader(TCPSocket& sock, const FrameFormat& format = FrameFormat());
+
+    /**
+     * Read one frame.
+     * @param payload Set to the frame's payload.
+     * @return true if a frame was read; false if it isn't all here.
+     */
+    bool read(std::string_view& payload);
+
+    /**
+     * Read every whole frame that can be had without waiting more than once.
+     * If no whole frame is buffered this first reads from the socket (waiting if it blocks),
+     * then hands out all the complete frames buffered. All of the views stay valid together
+     * until the next read.
+     * @param payloads Receives the payloads.
+     * @param maxFrames The capacity of 'payloads'.
+     * @return The number of frames read.
+     */
+    size_t readBatch(std::string_view* payloads, size_t maxFrames);
+
+    /**
+     * Read every whole frame that can be had without waiting more than once.
+     * @see readBatch(std::string_view*, size_t)
+     * @param payloads Cleared, then filled with the payloads. Its capacity is reused between calls.
+     * @return The number of frames read.
+     */
+    size_t readBatch(std::vector<std::string_view>& payloads);
+
+    //! Access the underlying BufferedReader.
+    BufferedReader& reader();
+
+  private:
+    BufferedReader buffer;
+    FrameFormat format;
+
+    bool wholeFrameBuffered();
+    size_t decodeLength(std::string_view prefix) const;
+
+  };
+
+  /**
+   * Writes length-prefixed frames to a TCPSocket.
+   * Frames are queued and then sent together with flush(), as a single gather write of every
+   * prefix and payload, so many small frames cost one system call and the payloads are never
+   * copied. The payload memory must stay valid until the frame has been flushed.\n
+   * On a non-blocking socket flush() may leave part of the queue unsent; call it again once
+   * the socket is writable. New frames may be queued in the meantime.
+   */
+  class FrameWriter {
+  public:
+    /**
+     * Wrap a socket.
+     * @param sock The socket to write to. It must outlive the writer.
+     * @param format The frame layout.
+     */
+    explicit FrameWriter(TCPSocket& sock, const FrameFormat& format = FrameFormat());
+
+    /**
+     * Queue a frame. Nothing is sent until flush().
+     * @param payload The frame's payload, which must stay valid until it has been flushed.
+     */
+    void queue(ConstBuffer payload);
+
+    /**
+     * Send everything queued.
+     * @return The number of bytes sent, including prefixes.
+     */
+    size_t flush();
+
+    //! Queue a frame and flush. @see queue() @see flush()
+    size_t send(ConstBuffer payload);
+
+    //! Return the number of bytes queued but not yet sent, including prefixes.
+    size_t pending() const;
+
+  private:
+    TCPSocket& sock;
+    FrameFormat format;
+
+    //prefixes are kept together; payloads are only referenced
+    std::vector<unsigned char> prefixes;
+    std::vector<ConstBuffer> payloads;
+    std::vector<ConstBuffer> parts;
+    size_t flushed;
+    size_t queuedBytes;
+
+  };
+
+}
@@ -1,6 +1,8 @@
 #include "cl_HostAddress.h"
-#include "ns_Utility.h"
-#include <WS2tcpip.h>
+#include "ns_Platform.h"
+#include <thread>
+#include <chrono>
+#include <cstring>
 
 ////////////////////////////NSLOOKUP////////////////////////////
 
@@ -15,20 +17,22 @@ namespace {
 
 std::vector<SSocks::HostAddress> SSocks::nsLookup(const std::string& hostName, uint16_t port) {
   //winsock must be loaded for getaddrinfo() to work
-  Utility::Winsock wsa;
+  Utility::Platform::startup();
   
   //getaddrinfo will return a linked list of addresses.
   //this pointer will indicate the root node
   GAI_RAII data;
 
   //The hints structure restricts the address search based on what
-  //values are set in it. In this case I only want internet-type addresses.
+  //values are set in it. In this case I want internet-type addresses of either family, listed
+  //once each rather than once per socket type.
   addrinfo hints = { 0 };
-  hints.ai_family = AF_INET;
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
 
   //In certain cases the name server may be busy updating records momentarily
-  //and getaddrinfo will signal WSATRY_AGAIN. We'll retry a couple times if that
-  //happens.
+  //and getaddrinfo will signal EAI_AGAIN (WSATRY_AGAIN on Windows). We'll retry a
+  //couple times if that happens.
   int attemptsRemaining = 3;
   while(1) {
     //attempt to fetch the address list into 'data.root'
@@ -36,18 +40,18 @@ std::vector<SSocks::HostAddress> SSocks::nsLookup(const std::string& hostName, u
 
     if(result == 0) { break; } //success
 
-    //If we got a WSATRY_AGAIN and we have some retries left then...
-    if((WSAGetLastError() == WSATRY_AGAIN) && (attemptsRemaining > 0)) {
+    //If we got an EAI_AGAIN and we have some retries left then...
+    if((result == EAI_AGAIN) && (attemptsRemaining > 0)) {
       attemptsRemaining--;
 
-      const DWORD QUARTER_SECOND_IN_MS = 250;
-      Sleep(QUARTER_SECOND_IN_MS);
+      const std::chrono::milliseconds QUARTER_SECOND(250);
+      std::this_thread::sleep_for(QUARTER_SECOND);
 
       continue;
     }
 
     //otherwise the request failed
-    throw std::runtime_error("getaddrinfo() failed.");
+    throw std::runtime_error("getaddrinfo() failed: " + Utility::Platform::gaiErrStr(result));
   }
 
   //We'll copy the results into a vector and then return it.
@@ -55,10 +59,9 @@ std::vector<SSocks::HostAddress> SSocks::nsLookup(const std::string& hostName, u
 
   //last node points to nullptr as 'next'
   for(addrinfo* node = data.root; node; node = node->ai_next) {
-    //set the port number
-    reinterpret_cast<sockaddr_in*>(node->ai_addr)->sin_port = htons(port);
-    //copy the address into the vector
+    //copy the address into the vector and set the port number
     vec.emplace_back(node->ai_addr);
+    vec.back().setPort(port);
   }
 
   return vec;
@@ -66,46 +69,149 @@ std::vector<SSocks::HostAddress> SSocks::nsLookup(const std::string& hostName, u
 
 ////////////////////////////HOSTADDRESS////////////////////////////
 
-//Initializer list here allocates the sockaddr_in and initializes it by filling it with zeroes.
-SSocks::HostAddress::HostAddress(const std::string& address, uint16_t port) : buffer{0} {
-  //we need to set the address family and port number
-  sainp()->sin_family = AF_INET; //AF_INET is for IPv4 using the TCP stack
-  sainp()->sin_port = htons(port); //convert the port to network order before storing it
+static_assert(sizeof(sockaddr_in6) <= 28, "HostAddress storage is too small for sockaddr_in6.");
+
+namespace {
+  //Writes 'value' in decimal at 'out' and returns the number of digits.
+  size_t writeDecimal(char* out, unsigned value) {
+    char digits[10];
+    size_t count = 0;
+    do {
+      digits[count++] = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while(value);
+
+    for(size_t i = 0; i < count; i++) { out[i] = digits[count - 1 - i]; }
+    return count;
+  }
+
+  //Parses a dot-quad IPv4 address into network byte order. This is the common case, and
+  //doing it by hand is a good deal quicker than inet_pton() and needs no terminated copy.
+  bool parseV4(std::string_view text, uint8_t* addr) {
+    size_t pos = 0;
+    for(int octet = 0; octet < 4; octet++) {
+      if(octet > 0) {
+        if(pos >= text.size() || text[pos] != '.') { return false; }
+        pos++;
+      }
+
+      size_t start = pos;
+      unsigned value = 0;
+      while(pos < text.size() && text[pos] >= '0' && text[pos] <= '9' && pos - start < 3) {
+        value = value * 10 + (text[pos] - '0');
+        pos++;
+      }
+
+      size_t digits = pos - start;
+      if(digits == 0 || value > 255) { return false; }
+      if(digits > 1 && text[start] == '0') { return false; } //no leading zeroes, which some read as octal
+      addr[octet] = static_cast<uint8_t>(value);
+    }
 
-  //'address' should be a dot-quad form IPv4 address. inet_pton will convert it to a network
-  //address value and write it to the corerct position in the sockaddr_in.
-  int result = inet_pton(AF_INET, address.c_str(), &sainp()->sin_addr);
-  if(result == 0) { throw std::runtime_error("Invalid address string supplied to HostAddress."); }
-  if(result == -1) { throw std::runtime_error(Utility::lastErrStr(WSAGetLastError())); }
+    return pos == text.size();
+  }
 
+  //SplitMix64's finalizer, which spreads every input bit across the whole result
+  uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+  }
 }
 
-//copy the pointed sockaddr_in into our newly allocated one
-SSocks::HostAddress::HostAddress(const sockaddr_in* sainp) {
-  std::copy(reinterpret_cast<const uint8_t*>(sainp), reinterpret_cast<const uint8_t*>(sainp + 1), buffer.begin());
+//all zeroes is INADDR_ANY and port 0, and only the family needs setting
+SSocks::HostAddress::HostAddress() : buffer{0} {
+  sainp()->sin_family = AF_INET;
 }
 
-//delegate to the sockaddr_in* constructor
-SSocks::HostAddress::HostAddress(const sockaddr* sap) : HostAddress(reinterpret_cast<const sockaddr_in*>(sap)) {
-  //nothing
+SSocks::HostAddress::HostAddress(const std::string& address, uint16_t port) : buffer{0} {
+  if(!parse(address, port, *this)) { throw std::runtime_error("Invalid address string supplied to HostAddress."); }
 }
 
-std::string SSocks::HostAddress::getAddr() const {
-  //An IPv4 address can be up to 15 characters long. (xxx.xxx.xxx.xxx)
-  //inet_ntop() is a C-ish function, so we need an additional char for
-  //the null terminator.
-  const size_t BUFFER_LEN = 16;
-  char str[BUFFER_LEN];
+//copy the pointed sockaddr_in into our buffer, leaving the rest zeroed
+SSocks::HostAddress::HostAddress(const sockaddr_in* sainp) : buffer{0} {
+  std::memcpy(buffer.data(), sainp, sizeof(sockaddr_in));
+}
 
-  auto addr = *sainp();
+//copy as much as the address family needs
+SSocks::HostAddress::HostAddress(const sockaddr* sap) : buffer{0} {
+  bool v6 = sap->sa_family == AF_INET6;
+  std::memcpy(buffer.data(), sap, v6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in));
+  //anything else (such as zeroed storage that nothing was received into) is taken as IPv4,
+  //so the address can be used as well as printed
+  if(!v6) { sainp()->sin_family = AF_INET; }
+}
 
-  //translate the address in sain to a C string and store it in 'str'
-  inet_ntop(AF_INET, &addr.sin_addr, str, BUFFER_LEN);
-  
-  //return as std::string (using implicit conversion from char*)
-  return str;
+bool SSocks::HostAddress::parse(std::string_view address, uint16_t port, HostAddress& out) noexcept {
+  HostAddress result;
+
+  if(address.find(':') == std::string_view::npos) {
+    //IPv4
+    sockaddr_in* sain = result.sainp();
+    if(!parseV4(address, reinterpret_cast<uint8_t*>(&sain->sin_addr))) { return false; }
+    sain->sin_family = AF_INET;
+    sain->sin_port = htons(port);
+  }
+  else {
+    //IPv6 is rarer and fiddlier, so hand it to the system, which wants a terminated string
+    char text[64];
+    if(address.size() >= sizeof(text)) { return false; }
+    std::memcpy(text, address.data(), address.size());
+    text[address.size()] = '\0';
+
+    sockaddr_in6* sain6 = reinterpret_cast<sockaddr_in6*>(result.buffer.data());
+    if(inet_pton(AF_INET6, text, &sain6->sin6_addr) != 1) { return false; }
+    sain6->sin6_family = AF_INET6;
+    sain6->sin6_port = htons(port);
+  }
+
+  out = result;
+  return true;
 }
 
+size_t SSocks::HostAddress::formatTo(char* out, size_t len, bool withPort) const noexcept {
+  //format into a local buffer that's always big enough, then copy out if it fits
+  char text[MAX_FORMAT_LENGTH];
+  size_t pos = 0;
+
+  if(isV6()) {
+    if(withPort) { text[pos++] = '['; }
+
+    in6_addr addr = reinterpret_cast<const sockaddr_in6*>(buffer.data())->sin6_addr;
+    if(!inet_ntop(AF_INET6, &addr, text + pos, sizeof(text) - pos)) { return 0; }
+    pos += std::strlen(text + pos);
+
+    if(withPort) { text[pos++] = ']'; }
+  }
+  else {
+    const uint8_t* addr = reinterpret_cast<const uint8_t*>(&sainp()->sin_addr);
+    for(int i = 0; i < 4; i++) {
+      if(i > 0) { text[pos++] = '.'; }
+      pos += writeDecimal(text + pos, addr[i]);
+    }
+  }
+
+  if(withPort) {
+    text[pos++] = ':';
+    pos += writeDecimal(text + pos, getPort());
+  }
+
+  if(pos >= len) { return 0; }
+  std::memcpy(out, text, pos);
+  out[pos] = '\0';
+  return pos;
+}
+
+std::string SSocks::HostAddress::getAddr() const {
+  char str[MAX_FORMAT_LENGTH];
+  size_t len = formatTo(str, sizeof(str));
+  return std::string(str, len);
+}
+
+//the port is at the same place in sockaddr_in and sockaddr_in6
 uint16_t SSocks::HostAddress::getPort() const {
   //translate from network to host byte order
   return ntohs(sainp()->sin_port);
@@ -116,6 +222,24 @@ void SSocks::HostAddress::setPort(uint16_t port) {
   sainp()->sin_port = htons(port);
 }
 
+SSocks::HostAddress::Family SSocks::HostAddress::getFamily() const {
+  return isV6() ? Family::IPV6 : Family::IPV4;
+}
+
+size_t SSocks::HostAddress::hash() const noexcept {
+  if(isV6()) {
+    const sockaddr_in6* sain6 = reinterpret_cast<const sockaddr_in6*>(buffer.data());
+    uint64_t halves[2];
+    std::memcpy(halves, &sain6->sin6_addr, sizeof(halves));
+    uint64_t extra = (uint64_t(sain6->sin6_scope_id) << 16) | sain6->sin6_port;
+    return static_cast<size_t>(mix(halves[0] ^ mix(halves[1] ^ mix(extra ^ (uint64_t(1) << 63)))));
+  }
+
+  uint32_t addr;
+  std::memcpy(&addr, &sainp()->sin_addr, sizeof(addr));
+  return static_cast<size_t>(mix((uint64_t(addr) << 16) | sainp()->sin_port));
+}
+
 SSocks::HostAddress::operator sockaddr*() {
   return reinterpret_cast<sockaddr*>(buffer.data());
 }
@@ -133,7 +257,7 @@ SSocks::HostAddress::operator const sockaddr_in*() const {
 }
 
 size_t SSocks::HostAddress::size() const {
-  return buffer.size();
+  return isV6() ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
 }
 
 sockaddr_in* SSocks::HostAddress::sainp() {
@@ -144,4 +268,34 @@ const sockaddr_in* SSocks::HostAddress::sainp() const {
   return reinterpret_cast<const sockaddr_in*>(buffer.data());
 }
 
+bool SSocks::HostAddress::isV6() const {
+  return sainp()->sin_family == AF_INET6;
+}
+
+//Orders by family, then address, then port, then scope, comparing only the fields that matter
+//so that padding and IPv6 flow labels don't make equal addresses differ.
+int SSocks::HostAddress::compare(const HostAddress& other) const noexcept {
+  if(isV6() != other.isV6()) { return isV6() ? 1 : -1; }
 
+  int result;
+  if(isV6()) {
+    const sockaddr_in6* a = reinterpret_cast<const sockaddr_in6*>(buffer.data());
+    const sockaddr_in6* b = reinterpret_cast<const sockaddr_in6*>(other.buffer.data());
+    result = std::memcmp(&a->sin6_addr, &b->sin6_addr, sizeof(a->sin6_addr));
+  }
+  else {
+    result = std::memcmp(&sainp()->sin_addr, &other.sainp()->sin_addr, sizeof(sainp()->sin_addr));
+  }
+  if(result != 0) { return result; }
+
+  uint16_t port = getPort();
+  uint16_t otherPort = other.getPort();
+  if(port != otherPort) { return port < otherPort ? -1 : 1; }
+
+  if(isV6()) {
+    uint32_t scope = reinterpret_cast<const sockaddr_in6*>(buffer.data())->sin6_scope_id;
+    uint32_t otherScope = reinterpret_cast<const sockaddr_in6*>(other.buffer.data())->sin6_scope_id;
+    if(scope != otherScope) { return scope < otherScope ? -1 : 1; }
+  }
+  return 0;
+}
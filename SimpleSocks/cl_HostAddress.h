@@ -2,9 +2,16 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <string_view>
 #include <array>
-
-//Forward declarations so we don't have to leak the Winsock header into the user space
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#include <compare>
+#endif
+
+//Forward declarations so we don't have to leak the native socket headers into the user space
 struct sockaddr;
 struct sockaddr_in;
 
@@ -15,6 +22,9 @@ namespace SSocks {
   /**
    * @fn std::vector<HostAddress> nsLookup(const std::string& hostName, uint16_t port = 0)
    * Look up a host via DNS and return a vector of HostAddress objects pointing to that host.
+   * Both IPv4 and IPv6 addresses are returned, in the order the system prefers them.
+   * This blocks the calling thread, possibly for a long time. Use a Resolver to look hosts up
+   * in the background and cache the results.
    * @param hostName Canonical name of host to look up, such as "google.com".
    * @param port Desired port to connect to later.
    * @return A vector of HostAddress objects matching the indeicated host.
@@ -22,27 +32,41 @@ namespace SSocks {
   std::vector<HostAddress> nsLookup(const std::string& hostName, uint16_t port = 0);
 
   /**
-   * Class used to represent an IPv4 internet address and port number.
+   * Class used to represent an IPv4 or IPv6 internet address and port number.
    * It has conversion functions that allow it to conver to and from sockaddr
-   * and sockaddr_in. Note that SimpleSocks is presently IPv4 only, so this
-   * class - especially - would need a rewrite to support IPv6.
+   * and sockaddr_in. The address is held inline, so copying one never allocates.\n
+   * HostAddress can be compared, ordered and hashed, so it can be used as a key in maps and
+   * unordered maps. Two addresses are equal if they have the same family, address, port and
+   * (for IPv6) scope. An IPv4 address and its IPv4-mapped IPv6 form ("::ffff:1.2.3.4") are
+   * different addresses.
    */
   class HostAddress {
   public:
+    //! Address families.
+    enum class Family { IPV4, IPV6 };
+
+    //! A buffer of this many chars is always large enough for formatTo(), terminator included.
+    static const size_t MAX_FORMAT_LENGTH = 54;
+
+    //! Construct the unspecified address, 0.0.0.0 port 0.
+    HostAddress();
+
     /**
      * Construct from user provided address string and port number.
      * @see nsLookup()
-     * @param address A dot-quadded address string.\n
+     * @see parse()
+     * @param address An IPv4 or IPv6 address string.\n
      * THIS CONSTRUCTOR WILL NOT LOOK UP A HOST.\n
-     * The address string should be in the format "127.0.0.1", NOT "google.com".
+     * The address string should be in the format "127.0.0.1" or "::1", NOT "google.com".
      * @param port A port number.
+     * @throw std::runtime_error if the string isn't a valid address.
      */
     HostAddress(const std::string& address, uint16_t port);
 
     //! convert from a sockaddr_in*
     HostAddress(const sockaddr_in* sainp);
 
-    //! convert from a sockaddr*
+    //! convert from a sockaddr*, which may be a sockaddr_in or a sockaddr_in6
     HostAddress(const sockaddr* sap);
 
     //! copy constructor
@@ -57,7 +81,26 @@ namespace SSocks {
     //! move-assign
     HostAddress& operator=(HostAddress&&) = default;
 
-    //! Return a string containing the dot-quad formatted address, such as "127.0.0.1".
+    /**
+     * Parse an address string without throwing or allocating.
+     * Accepts the same strings as the string constructor.
+     * @param address An IPv4 or IPv6 address string.
+     * @param port A port number.
+     * @param out Receives the address on success; left unchanged on failure.
+     * @return true on success; false if the string isn't a valid address.
+     */
+    static bool parse(std::string_view address, uint16_t port, HostAddress& out) noexcept;
+
+    /**
+     * Write the address as a null-terminated string without allocating.
+     * @param out The buffer to write into. MAX_FORMAT_LENGTH chars is always enough.
+     * @param len The size of the buffer.
+     * @param withPort If true the port is appended, as in "127.0.0.1:80" or "[::1]:80".
+     * @return The length of the string written, not counting the terminator, or zero if it didn't fit.
+     */
+    size_t formatTo(char* out, size_t len, bool withPort = false) const noexcept;
+
+    //! Return a string containing the formatted address, such as "127.0.0.1" or "::1".
     std::string getAddr() const;
 
     //! Return the currently stored port number
@@ -66,26 +109,52 @@ namespace SSocks {
     //! Change the stored port number
     void setPort(uint16_t port);
 
+    //! Return the address family.
+    Family getFamily() const;
+
+    //! Return a hash of the address, as used by std::hash.
+    size_t hash() const noexcept;
+
     //! Conversion to sockaddr* HostAddress can be used in its place.
     operator sockaddr*();
     //! Conversion to const sockaddr* HostAddress can be used in its place.
     operator const sockaddr*() const;
-    //! Conversion to sockaddr_in* HostAddress can be used in its place.
+    //! Conversion to sockaddr_in* HostAddress can be used in its place. Only meaningful for IPv4.
     operator sockaddr_in*();
-    //! Conversion to const sockaddr_in* HostAddress can be used in its place.
+    //! Conversion to const sockaddr_in* HostAddress can be used in its place. Only meaningful for IPv4.
     operator const sockaddr_in*() const;
 
-    //! Return size of address data.
+    //! Return size of address data. (The size of a sockaddr_in or sockaddr_in6.)
     size_t size() const;
 
+    //! Equality. @see HostAddress
+    bool operator==(const HostAddress& other) const noexcept { return compare(other) == 0; }
+    //! Inequality.
+    bool operator!=(const HostAddress& other) const noexcept { return compare(other) != 0; }
+    //! Ordering, by family, then address, then port.
+    bool operator<(const HostAddress& other) const noexcept { return compare(other) < 0; }
+    #if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+    //! Three-way comparison, ordering as operator<.
+    std::strong_ordering operator<=>(const HostAddress& other) const noexcept { return compare(other) <=> 0; }
+    #endif
+
   private:
-    static const size_t SIZEOF_SOCKADDR_IN = 16;
-    std::array<uint8_t, SIZEOF_SOCKADDR_IN> buffer;
+    //large enough for a sockaddr_in6, which is the largest family supported
+    static const size_t SIZEOF_SOCKADDR_IN6 = 28;
+    alignas(8) std::array<uint8_t, SIZEOF_SOCKADDR_IN6> buffer;
 
     sockaddr_in* sainp();
     const sockaddr_in* sainp() const;
+    bool isV6() const;
+    int compare(const HostAddress& other) const noexcept;
 
   };
 
 }
 
+namespace std {
+  //! Hash support, so that HostAddress can be used as a key in unordered containers.
+  template<> struct hash<SSocks::HostAddress> {
+    size_t operator()(const SSocks::HostAddress& address) const noexcept { return address.hash(); }
+  };
+}
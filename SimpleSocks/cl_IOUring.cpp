@@ -0,0 +1,497 @@
+#include "cl_IOUring.h"
+#include "cl_TCPSocket.h"
+#include "cl_TCPServer.h"
+#include "cl_UDPSocket.h"
+#include "ns_Platform.h"
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+//This talks to the kernel directly through the io_uring system calls rather than depending on
+//liburing. The ring layout and memory ordering rules follow the io_uring(7) man page.
+
+namespace {
+  int ringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+  }
+
+  int ringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+  }
+
+  int ringRegister(int fd, unsigned opcode, void* arg, unsigned argCount) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, argCount));
+  }
+
+  //throw an exception describing the current errno
+  [[noreturn]] void throwLastError() {
+    throw std::runtime_error(SSocks::Utility::lastErrStr(SSocks::Utility::Platform::lastError()));
+  }
+}
+
+//a registered group of kernel-selected buffers
+struct BufferGroup {
+  io_uring_buf_ring* ring = nullptr;
+  size_t ringBytes = 0;
+  std::unique_ptr<char[]> storage;
+  uint32_t size = 0;
+  uint16_t mask = 0;
+  uint16_t tail = 0;
+
+  //hand a buffer back to the kernel
+  void recycle(uint16_t bid) {
+    //The kernel header declares 'bufs' through a flexible array helper that contains an empty
+    //struct. That's zero bytes in C but one byte in C++, which shifts 'bufs' out of place, so
+    //the ring is indexed as a plain array instead. (The tail overlays bufs[0].resv.)
+    io_uring_buf* buf = reinterpret_cast<io_uring_buf*>(ring) + (tail & mask);
+    buf->addr = reinterpret_cast<uint64_t>(storage.get() + static_cast<size_t>(bid) * size);
+    buf->len = size;
+    buf->bid = bid;
+    tail++;
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+  }
+};
+
+//an operation in flight; its address is used as the SQE user_data
+struct SSocks::IOUring::Op {
+  enum Kind { SEND, RECV, ACCEPT, RECV_MULTISHOT } kind;
+  int sock;
+  const char* data;
+  size_t len;
+  size_t done;
+  Callback onComplete;
+  AcceptCallback onAccept;
+  SocketOptions options; //the server's options, for accepted connections
+  BufferCallback onData;
+  uint16_t group;
+};
+
+struct SSocks::IOUring::State {
+  int fd = -1;
+
+  //submission queue
+  void* sqRing = MAP_FAILED;
+  size_t sqRingBytes = 0;
+  unsigned* sqHead = nullptr;
+  unsigned* sqTail = nullptr;
+  unsigned* sqArray = nullptr;
+  unsigned sqMask = 0;
+  unsigned sqEntries = 0;
+  io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+  size_t sqesBytes = 0;
+  //tail of SQEs we've filled in, which runs ahead of the published tail until submit()
+  unsigned localTail = 0;
+
+  //completion queue (may share the submission queue's mapping)
+  void* cqRing = MAP_FAILED;
+  size_t cqRingBytes = 0;
+  unsigned* cqHead = nullptr;
+  unsigned* cqTail = nullptr;
+  unsigned cqMask = 0;
+  io_uring_cqe* cqes = nullptr;
+
+  bool extArg = false;
+
+  std::map<uint16_t, BufferGroup> groups;
+
+  //operations are recycled through a free list so steady-state traffic doesn't allocate
+  std::vector<std::unique_ptr<Op>> ops;
+  std::vector<Op*> freeOps;
+  size_t inFlight = 0;
+
+  //Releasing everything here (rather than in ~IOUring) means a constructor that fails part way
+  //through still cleans up whatever it had already mapped.
+  ~State() {
+    //closing the ring cancels everything still in flight
+    if(fd >= 0) { ::close(fd); }
+
+    if(sqes != MAP_FAILED) { munmap(sqes, sqesBytes); }
+    if(cqRing != MAP_FAILED && cqRing != sqRing) { munmap(cqRing, cqRingBytes); }
+    if(sqRing != MAP_FAILED) { munmap(sqRing, sqRingBytes); }
+
+    for(auto& group : groups) { munmap(group.second.ring, group.second.ringBytes); }
+  }
+};
+
+SSocks::IOUring::IOUring(unsigned entries) : state(new State) {
+  io_uring_params params = {};
+  state->fd = ringSetup(entries, &params);
+  if(state->fd < 0) { throwLastError(); }
+
+  state->extArg = (params.features & IORING_FEAT_EXT_ARG) != 0;
+
+  state->sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  state->cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+  //newer kernels map both rings with a single mmap()
+  bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if(singleMap) {
+    state->sqRingBytes = std::max(state->sqRingBytes, state->cqRingBytes);
+    state->cqRingBytes = state->sqRingBytes;
+  }
+
+  state->sqRing = mmap(nullptr, state->sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, state->fd, IORING_OFF_SQ_RING);
+  if(state->sqRing == MAP_FAILED) { throwLastError(); }
+
+  if(singleMap) {
+    state->cqRing = state->sqRing;
+  }
+  else {
+    state->cqRing = mmap(nullptr, state->cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, state->fd, IORING_OFF_CQ_RING);
+    if(state->cqRing == MAP_FAILED) { throwLastError(); }
+  }
+
+  state->sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = mmap(nullptr, state->sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, state->fd, IORING_OFF_SQES);
+  if(sqes == MAP_FAILED) { throwLastError(); }
+  state->sqes = static_cast<io_uring_sqe*>(sqes);
+
+  char* sq = static_cast<char*>(state->sqRing);
+  state->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  state->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  state->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  state->sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  state->sqEntries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+  state->localTail = *state->sqTail;
+
+  char* cq = static_cast<char*>(state->cqRing);
+  state->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  state->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  state->cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  state->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+}
+
+SSocks::IOUring::~IOUring() {
+  //State releases the ring and its mappings
+}
+
+bool SSocks::IOUring::isSupported() {
+  io_uring_params params = {};
+  int fd = ringSetup(1, &params);
+  if(fd < 0) { return false; }
+  ::close(fd);
+  return true;
+}
+
+SSocks::IOUring::Op* SSocks::IOUring::prepare(int sock, int opcode) {
+  if(sock == Utility::Platform::INVALID_SOCK) { throw std::runtime_error("Attempted io_uring operation on closed socket."); }
+
+  //if the submission queue is full then flush it to the kernel to make room
+  unsigned head = __atomic_load_n(state->sqHead, __ATOMIC_ACQUIRE);
+  if(state->localTail - head >= state->sqEntries) {
+    submit();
+    head = __atomic_load_n(state->sqHead, __ATOMIC_ACQUIRE);
+    if(state->localTail - head >= state->sqEntries) { throw std::runtime_error("io_uring submission queue is full."); }
+  }
+
+  //grab an operation record
+  Op* op;
+  if(state->freeOps.empty()) {
+    state->ops.emplace_back(new Op);
+    op = state->ops.back().get();
+  }
+  else {
+    op = state->freeOps.back();
+    state->freeOps.pop_back();
+  }
+  op->sock = sock;
+  op->data = nullptr;
+  op->len = 0;
+  op->done = 0;
+  op->group = 0;
+
+  //fill in the common part of the SQE
+  unsigned index = state->localTail & state->sqMask;
+  io_uring_sqe* sqe = &state->sqes[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = static_cast<uint8_t>(opcode);
+  sqe->fd = sock;
+  sqe->user_data = reinterpret_cast<uint64_t>(op);
+  state->sqArray[index] = index;
+  state->localTail++;
+  state->inFlight++;
+
+  return op;
+}
+
+void SSocks::IOUring::release(Op* op) {
+  op->onComplete = nullptr;
+  op->onAccept = nullptr;
+  op->options = SocketOptions();
+  op->onData = nullptr;
+  state->freeOps.push_back(op);
+  state->inFlight--;
+}
+
+void SSocks::IOUring::queueSend(int sock, const void* data, size_t len, Callback onComplete) {
+  Op* op = prepare(sock, IORING_OP_SEND);
+  op->kind = Op::SEND;
+  op->data = static_cast<const char*>(data);
+  op->len = len;
+  op->onComplete = std::move(onComplete);
+
+  io_uring_sqe* sqe = &state->sqes[(state->localTail - 1) & state->sqMask];
+  sqe->addr = reinterpret_cast<uint64_t>(data);
+  sqe->len = static_cast<uint32_t>(len);
+  sqe->msg_flags = Utility::Platform::SEND_FLAGS;
+}
+
+void SSocks::IOUring::queueRecv(int sock, void* buffer, size_t len, Callback onComplete) {
+  Op* op = prepare(sock, IORING_OP_RECV);
+  op->kind = Op::RECV;
+  op->onComplete = std::move(onComplete);
+
+  io_uring_sqe* sqe = &state->sqes[(state->localTail - 1) & state->sqMask];
+  sqe->addr = reinterpret_cast<uint64_t>(buffer);
+  sqe->len = static_cast<uint32_t>(len);
+}
+
+void SSocks::IOUring::queueRecvMultishot(int sock, uint16_t group, BufferCallback onData) {
+  if(!state->groups.count(group)) { throw std::runtime_error("Attempted multishot recv with unregistered buffer group."); }
+
+  Op* op = prepare(sock, IORING_OP_RECV);
+  op->kind = Op::RECV_MULTISHOT;
+  op->group = group;
+  op->onData = std::move(onData);
+
+  //the kernel picks the buffer, so no address or length is given
+  io_uring_sqe* sqe = &state->sqes[(state->localTail - 1) & state->sqMask];
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = group;
+}
+
+void SSocks::IOUring::send(TCPSocket& sock, const void* data, size_t len, Callback onComplete) { queueSend(sock.sock, data, len, std::move(onComplete)); }
+void SSocks::IOUring::send(UDPSocket& sock, const void* data, size_t len, Callback onComplete) { queueSend(sock.sock, data, len, std::move(onComplete)); }
+void SSocks::IOUring::recv(TCPSocket& sock, void* buffer, size_t len, Callback onComplete) { queueRecv(sock.sock, buffer, len, std::move(onComplete)); }
+void SSocks::IOUring::recv(UDPSocket& sock, void* buffer, size_t len, Callback onComplete) { queueRecv(sock.sock, buffer, len, std::move(onComplete)); }
+void SSocks::IOUring::recvMultishot(TCPSocket& sock, uint16_t group, BufferCallback onData) { queueRecvMultishot(sock.sock, group, std::move(onData)); }
+void SSocks::IOUring::recvMultishot(UDPSocket& sock, uint16_t group, BufferCallback onData) { queueRecvMultishot(sock.sock, group, std::move(onData)); }
+
+void SSocks::IOUring::accept(TCPServer& server, AcceptCallback onAccept, bool multishot) {
+  Op* op = prepare(server.sock, IORING_OP_ACCEPT);
+  op->kind = Op::ACCEPT;
+  op->onAccept = std::move(onAccept);
+  op->options = server.options;
+
+  io_uring_sqe* sqe = &state->sqes[(state->localTail - 1) & state->sqMask];
+  sqe->accept_flags = SOCK_CLOEXEC;
+  if(multishot) { sqe->ioprio = IORING_ACCEPT_MULTISHOT; }
+}
+
+void SSocks::IOUring::registerBuffers(uint16_t group, uint16_t count, uint32_t size) {
+  if(count == 0 || count > 32768 || (count & (count - 1))) { throw std::runtime_error("io_uring buffer count must be a power of two no greater than 32768."); }
+  if(size == 0) { throw std::runtime_error("io_uring buffer size must be nonzero."); }
+  if(state->groups.count(group)) { throw std::runtime_error("io_uring buffer group is already registered."); }
+
+  BufferGroup bg;
+  bg.size = size;
+  bg.mask = count - 1;
+
+  //the ring itself must be page aligned, so it gets its own anonymous mapping
+  bg.ringBytes = count * sizeof(io_uring_buf);
+  void* ring = mmap(nullptr, bg.ringBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(ring == MAP_FAILED) { throwLastError(); }
+  bg.ring = static_cast<io_uring_buf_ring*>(ring);
+  bg.storage.reset(new char[static_cast<size_t>(count) * size]);
+
+  io_uring_buf_reg reg = {};
+  reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+  reg.ring_entries = count;
+  reg.bgid = group;
+  if(ringRegister(state->fd, IORING_REGISTER_PBUF_RING, &reg, 1)) {
+    int err = Utility::Platform::lastError();
+    munmap(ring, bg.ringBytes);
+    throw std::runtime_error(Utility::lastErrStr(err));
+  }
+
+  //hand every buffer to the kernel
+  for(uint16_t bid = 0; bid < count; bid++) { bg.recycle(bid); }
+
+  state->groups[group] = std::move(bg);
+}
+
+size_t SSocks::IOUring::submit() {
+  unsigned published = *state->sqTail;
+  unsigned toSubmit = state->localTail - published;
+  if(toSubmit == 0) { return 0; }
+
+  //publish the new tail so the kernel can see the SQEs
+  __atomic_store_n(state->sqTail, state->localTail, __ATOMIC_RELEASE);
+
+  int result;
+  do { result = ringEnter(state->fd, toSubmit, 0, 0, nullptr, 0); } while(result < 0 && errno == EINTR);
+  if(result < 0) { throwLastError(); }
+
+  return result;
+}
+
+size_t SSocks::IOUring::run(float timeoutSeconds) {
+  unsigned toSubmit = state->localTail - *state->sqTail;
+  __atomic_store_n(state->sqTail, state->localTail, __ATOMIC_RELEASE);
+
+  //with nothing in flight there's nothing to wait for
+  unsigned minComplete = state->inFlight ? 1 : 0;
+  unsigned flags = minComplete ? IORING_ENTER_GETEVENTS : 0;
+
+  //a bounded wait is passed as an extended argument
+  __kernel_timespec ts = {};
+  io_uring_getevents_arg arg = {};
+  void* argp = nullptr;
+  size_t argSize = 0;
+  if(minComplete && timeoutSeconds >= 0) {
+    if(!state->extArg) { throw std::runtime_error("io_uring wait timeouts require Linux 5.11 or later."); }
+    ts.tv_sec = static_cast<long long>(timeoutSeconds);
+    const float NSEC_PER_SEC = 1000000000.0f;
+    ts.tv_nsec = static_cast<long long>((timeoutSeconds - ts.tv_sec) * NSEC_PER_SEC);
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+    argp = &arg;
+    argSize = sizeof(arg);
+    flags |= IORING_ENTER_EXT_ARG;
+  }
+
+  if(toSubmit || minComplete) {
+    int result = ringEnter(state->fd, toSubmit, minComplete, flags, argp, argSize);
+    //ETIME is a timeout, EINTR is a signal and EBUSY is a full completion queue; in all of
+    //those cases we just reap whatever is there
+    if(result < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) { throwLastError(); }
+  }
+
+  //reap everything that's available
+  size_t count = 0;
+  unsigned head = *state->cqHead;
+  while(head != __atomic_load_n(state->cqTail, __ATOMIC_ACQUIRE)) {
+    io_uring_cqe cqe = state->cqes[head & state->cqMask];
+    head++;
+    //release the slot before dispatching so the callback is free to queue more work
+    __atomic_store_n(state->cqHead, head, __ATOMIC_RELEASE);
+
+    dispatch(cqe.user_data, cqe.res, cqe.flags);
+    count++;
+  }
+
+  return count;
+}
+
+void SSocks::IOUring::dispatch(uint64_t userData, int result, uint32_t flags) {
+  Op* op = reinterpret_cast<Op*>(userData);
+  bool more = (flags & IORING_CQE_F_MORE) != 0;
+
+  switch(op->kind) {
+  case Op::SEND: {
+    //keep going after a short send, the same way a blocking TCPSocket::send() does
+    if(result > 0) {
+      op->done += result;
+      if(op->done < op->len) {
+        const char* rest = op->data + op->done;
+        size_t restLen = op->len - op->done;
+        size_t done = op->done;
+        Callback cb = std::move(op->onComplete);
+        int sock = op->sock;
+        release(op);
+        queueSend(sock, rest, restLen, [cb, done](int r) { cb(r < 0 ? r : static_cast<int>(done + r)); });
+        return;
+      }
+      result = static_cast<int>(op->done);
+    }
+    Callback cb = std::move(op->onComplete);
+    release(op);
+    cb(result);
+    break;
+  }
+
+  case Op::RECV: {
+    Callback cb = std::move(op->onComplete);
+    release(op);
+    cb(result);
+    break;
+  }
+
+  case Op::ACCEPT: {
+    TCPSocket sock;
+    if(result >= 0) {
+      sock.sock = result;
+      result = 0;
+
+      //pass the server's options on to the connection, reporting a failure like any other
+      int err = op->options.tryApply(sock.sock, true);
+      if(err) {
+        result = -err;
+        sock.close();
+      }
+      else { sock.options = op->options; }
+    }
+
+    if(more) {
+      op->onAccept(std::move(sock), result);
+    }
+    else {
+      AcceptCallback cb = std::move(op->onAccept);
+      release(op);
+      cb(std::move(sock), result);
+    }
+    break;
+  }
+
+  case Op::RECV_MULTISHOT: {
+    BufferGroup& group = state->groups[op->group];
+    const char* data = nullptr;
+    bool hasBuffer = (flags & IORING_CQE_F_BUFFER) != 0;
+    uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+    if(hasBuffer) { data = group.storage.get() + static_cast<size_t>(bid) * group.size; }
+
+    BufferCallback cb = more ? BufferCallback() : std::move(op->onData);
+    if(!more) { release(op); }
+
+    //the buffer goes back to the kernel even if the callback throws
+    struct Recycler {
+      BufferGroup& group; uint16_t bid; bool active;
+      ~Recycler() { if(active) { group.recycle(bid); } }
+    } recycler{ group, bid, hasBuffer };
+
+    if(more) { op->onData(data, result, true); }
+    else { cb(data, result, false); }
+    break;
+  }
+  }
+}
+
+size_t SSocks::IOUring::pending() const {
+  return state->inFlight;
+}
+
+#else
+
+//Stubs for platforms without io_uring. The constructor throws, so the other members are
+//unreachable but still need definitions.
+
+struct SSocks::IOUring::State {};
+struct SSocks::IOUring::Op {};
+
+SSocks::IOUring::IOUring(unsigned) {
+  throw std::runtime_error("io_uring is only available on Linux.");
+}
+
+SSocks::IOUring::~IOUring() {}
+bool SSocks::IOUring::isSupported() { return false; }
+void SSocks::IOUring::send(TCPSocket&, const void*, size_t, Callback) {}
+void SSocks::IOUring::send(UDPSocket&, const void*, size_t, Callback) {}
+void SSocks::IOUring::recv(TCPSocket&, void*, size_t, Callback) {}
+void SSocks::IOUring::recv(UDPSocket&, void*, size_t, Callback) {}
+void SSocks::IOUring::accept(TCPServer&, AcceptCallback, bool) {}
+void SSocks::IOUring::registerBuffers(uint16_t, uint16_t, uint32_t) {}
+void SSocks::IOUring::recvMultishot(TCPSocket&, uint16_t, BufferCallback) {}
+void SSocks::IOUring::recvMultishot(UDPSocket&, uint16_t, BufferCallback) {}
+size_t SSocks::IOUring::submit() { return 0; }
+size_t SSocks::IOUring::run(float) { return 0; }
+size_t SSocks::IOUring::pending() const { return 0; }
+
+#endif
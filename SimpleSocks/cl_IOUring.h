@@ -0,0 +1,143 @@
+/** @file */
+#pragma once
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "fn_select.h"
+
+namespace SSocks {
+  //forward declarations
+  class TCPSocket;
+  class TCPServer;
+  class UDPSocket;
+
+  /**
+   * Optional io_uring execution engine for sockets (Linux only).
+   * Operations queued on an IOUring are not performed immediately. They are written to the
+   * submission queue and handed to the kernel together on the next submit() or run(), so a
+   * batch of sends, receives and accepts costs a single system call. Each operation carries a
+   * callback that is invoked from run() when the operation completes.\n
+   * Results follow the kernel convention: a non-negative value is a byte count (or zero for a
+   * closed connection), and a negative value is a negated errno code.\n
+   * The sockets and any data buffers passed to an operation must stay alive and in place until
+   * its final callback has run. Callbacks may queue further operations. On platforms without
+   * io_uring the constructor throws; use isSupported() to choose a fallback at runtime.
+   */
+  class IOUring {
+  public:
+    /**
+     * Completion callback for send and recv operations.
+     * Receives the number of bytes transferred or a negated errno code.
+     */
+    typedef std::function<void(int result)> Callback;
+
+    /**
+     * Completion callback for accept operations.
+     * On success 'result' is zero and 'sock' holds the new connection. Otherwise 'result' is a
+     * negated errno code and 'sock' is not open.
+     */
+    typedef std::function<void(TCPSocket sock, int result)> AcceptCallback;
+
+    /**
+     * Completion callback for multishot receives into provided buffers.
+     * 'data' points into the buffer group and is only valid for the duration of the callback.
+     * 'result' is the number of bytes in 'data', zero if the remote host closed the connection,
+     * or a negated errno code (-ENOBUFS if the group ran dry). 'more' is false when this is the
+     * last callback the operation will produce, after which it must be re-armed if desired.
+     */
+    typedef std::function<void(const char* data, int result, bool more)> BufferCallback;
+
+    /**
+     * Create an io_uring instance.
+     * @param entries Requested size of the submission queue. The kernel rounds it up to a power of two.
+     */
+    explicit IOUring(unsigned entries = 256);
+
+    //! Copying is prohibited, as the ring is a unique resource.
+    IOUring(const IOUring&) = delete;
+
+    //! Copying is prohibited, as the ring is a unique resource.
+    IOUring& operator=(const IOUring&) = delete;
+
+    //! Destructor. Outstanding operations are cancelled without invoking their callbacks.
+    ~IOUring();
+
+    //! Return true if io_uring is available on this system.
+    static bool isSupported();
+
+    /**
+     * Queue a send of 'len' bytes from 'data'.
+     * Short sends are resubmitted internally, so the callback reports either the full length
+     * or an error, matching the behavior of a blocking TCPSocket::send().
+     */
+    void send(TCPSocket& sock, const void* data, size_t len, Callback onComplete);
+    //! Queue a send of a single datagram on a connected UDPSocket.
+    void send(UDPSocket& sock, const void* data, size_t len, Callback onComplete);
+
+    //! Queue a single receive of up to 'len' bytes into 'buffer'.
+    void recv(TCPSocket& sock, void* buffer, size_t len, Callback onComplete);
+    //! Queue a single receive of one datagram into 'buffer' on a connected UDPSocket.
+    void recv(UDPSocket& sock, void* buffer, size_t len, Callback onComplete);
+
+    /**
+     * Queue an accept on a listening server.
+     * @param server The server to accept from.
+     * @param onAccept Invoked for each accepted connection.
+     * @param multishot If true the operation stays armed and keeps producing connections until
+     * it fails or the IOUring is destroyed. Otherwise it completes after one connection.
+     */
+    void accept(TCPServer& server, AcceptCallback onAccept, bool multishot = true);
+
+    /**
+     * Register a group of kernel-selected receive buffers.
+     * The buffers are owned by the IOUring and are handed back to the kernel as soon as the
+     * BufferCallback that received them returns.
+     * @param group An identifier for the group, used with recvMultishot().
+     * @param count The number of buffers. Must be a power of two no greater than 32768.
+     * @param size The size in bytes of each buffer.
+     */
+    void registerBuffers(uint16_t group, uint16_t count, uint32_t size);
+
+    /**
+     * Queue a multishot receive that draws buffers from a registered group.
+     * The operation keeps producing callbacks as data arrives until the connection closes,
+     * an error occurs, or the buffer group runs dry.
+     */
+    void recvMultishot(TCPSocket& sock, uint16_t group, BufferCallback onData);
+    //! @copydoc recvMultishot(TCPSocket&, uint16_t, BufferCallback)
+    void recvMultishot(UDPSocket& sock, uint16_t group, BufferCallback onData);
+
+    /**
+     * Hand all queued operations to the kernel without waiting.
+     * @return The number of operations submitted.
+     */
+    size_t submit();
+
+    /**
+     * Submit queued operations, wait for at least one completion, and dispatch callbacks for
+     * every completion that is available.
+     * @param timeoutSeconds The maximum number of seconds to wait. SELECT_FOREVER waits indefinitely and zero just checks.
+     * @return The number of completions dispatched. Zero indicates a timeout or that nothing was in flight.
+     */
+    size_t run(float timeoutSeconds = SELECT_FOREVER);
+
+    //! Return the number of operations that have not yet produced their final completion.
+    size_t pending() const;
+
+  private:
+    //The ring state is hidden so that the kernel headers don't leak into user code.
+    struct State;
+    struct Op;
+    std::unique_ptr<State> state;
+
+    Op* prepare(int sock, int opcode);
+    void queueSend(int sock, const void* data, size_t len, Callback onComplete);
+    void queueRecv(int sock, void* buffer, size_t len, Callback onComplete);
+    void queueRecvMultishot(int sock, uint16_t group, BufferCallback onData);
+    void dispatch(uint64_t userData, int result, uint32_t flags);
+    void release(Op* op);
+
+  };
+
+}
@@ -0,0 +1,226 @@
+#include "cl_Metrics.h"
+#include <sstream>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+
+namespace {
+  const char* METRIC_NAMES[SSocks::METRIC_COUNT] = {
+    "bytes_sent", "bytes_received", "syscalls", "partial_sends", "would_block", "errors", "accepts", "connects"
+  };
+
+  const char* SOURCE_NAMES[SSocks::METRIC_SOURCE_COUNT] = { "tcp_socket", "tcp_server", "udp_socket" };
+
+#ifndef SSOCKS_NO_METRICS
+  typedef std::atomic<uint64_t> Counter;
+
+  //One thread's totals. Only that thread writes them, so updates need no locked instructions,
+  //and the alignment keeps neighboring threads' counters off its cache lines.
+  struct alignas(64) Shard {
+    Counter counters[SSocks::METRIC_SOURCE_COUNT][SSocks::METRIC_COUNT];
+  };
+
+  //Every live thread's shard, plus what exited threads left behind and the totals at the last
+  //reset. Only registration, exit, snapshots and resets take the lock.
+  struct Shards {
+    std::mutex mutex;
+    std::vector<Shard*> live;
+    uint64_t retired[SSocks::METRIC_SOURCE_COUNT][SSocks::METRIC_COUNT] = {};
+    uint64_t baseline[SSocks::METRIC_SOURCE_COUNT][SSocks::METRIC_COUNT] = {};
+  };
+
+  //never destroyed, so that threads still running as the program exits can fold their counts in
+  Shards& shards() {
+    static Shards* instance = new Shards;
+    return *instance;
+  }
+
+  //Registers the thread's shard on first use and folds it into 'retired' when the thread exits.
+  struct ShardOwner {
+    Shard shard;
+
+    ShardOwner() {
+      for(auto& bySource : shard.counters) {
+        for(Counter& counter : bySource) { counter.store(0, std::memory_order_relaxed); }
+      }
+      Shards& all = shards();
+      std::lock_guard<std::mutex> lock(all.mutex);
+      all.live.push_back(&shard);
+    }
+
+    ~ShardOwner() {
+      Shards& all = shards();
+      std::lock_guard<std::mutex> lock(all.mutex);
+      for(size_t s = 0; s < SSocks::METRIC_SOURCE_COUNT; s++) {
+        for(size_t i = 0; i < SSocks::METRIC_COUNT; i++) { all.retired[s][i] += shard.counters[s][i].load(std::memory_order_relaxed); }
+      }
+      all.live.erase(std::find(all.live.begin(), all.live.end(), &shard));
+    }
+  };
+
+  //the calling thread's counters for one kind of socket
+  Counter* threadTotals(SSocks::MetricSource source) {
+    thread_local ShardOwner owner;
+    return owner.shard.counters[static_cast<size_t>(source)];
+  }
+
+  //Each counter has a single writer, so a relaxed load and store does the job of a fetch_add
+  //without the locked instruction; readers on other threads still see whole values.
+  inline void bump(Counter& counter, uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+
+  //the totals since the program started, for one kind of socket; the lock must be held
+  void sumShards(Shards& all, size_t source, uint64_t* result) {
+    for(size_t i = 0; i < SSocks::METRIC_COUNT; i++) { result[i] = all.retired[source][i]; }
+    for(Shard* shard : all.live) {
+      for(size_t i = 0; i < SSocks::METRIC_COUNT; i++) { result[i] += shard->counters[source][i].load(std::memory_order_relaxed); }
+    }
+  }
+#endif
+}
+
+const char* SSocks::metricName(Metric metric) {
+  return METRIC_NAMES[static_cast<size_t>(metric)];
+}
+
+const char* SSocks::metricSourceName(MetricSource source) {
+  return SOURCE_NAMES[static_cast<size_t>(source)];
+}
+
+SSocks::MetricsSnapshot& SSocks::MetricsSnapshot::operator+=(const MetricsSnapshot& other) {
+  for(size_t i = 0; i < METRIC_COUNT; i++) { values[i] += other.values[i]; }
+  return *this;
+}
+
+/////////////////////////SOCKETMETRICS/////////////////////////
+
+#ifndef SSOCKS_NO_METRICS
+SSocks::SocketMetrics::SocketMetrics(MetricSource source) : source(source) {
+  reset();
+}
+
+SSocks::SocketMetrics::SocketMetrics(const SocketMetrics& other) : source(other.source) {
+  *this = other;
+}
+
+SSocks::SocketMetrics& SSocks::SocketMetrics::operator=(const SocketMetrics& other) {
+  for(size_t i = 0; i < METRIC_COUNT; i++) { counters[i].store(other.counters[i].load(std::memory_order_relaxed), std::memory_order_relaxed); }
+  return *this;
+}
+
+SSocks::MetricsSnapshot SSocks::SocketMetrics::snapshot() const {
+  MetricsSnapshot result;
+  for(size_t i = 0; i < METRIC_COUNT; i++) { result.values[i] = counters[i].load(std::memory_order_relaxed); }
+  return result;
+}
+
+void SSocks::SocketMetrics::reset() {
+  for(auto& counter : counters) { counter.store(0, std::memory_order_relaxed); }
+}
+
+//Each recording function looks up the thread's totals once, however many counters it updates.
+void SSocks::SocketMetrics::add(Counter* totals, Metric metric, uint64_t amount) noexcept {
+  size_t index = static_cast<size_t>(metric);
+  bump(counters[index], amount);
+  bump(totals[index], amount);
+}
+
+void SSocks::SocketMetrics::sent(size_t bytes, size_t wanted) noexcept {
+  Counter* totals = threadTotals(source);
+  add(totals, Metric::SYSCALLS, 1);
+  add(totals, Metric::BYTES_SENT, bytes);
+  if(bytes < wanted) { add(totals, Metric::PARTIAL_SENDS, 1); }
+}
+
+void SSocks::SocketMetrics::received(size_t bytes) noexcept {
+  Counter* totals = threadTotals(source);
+  add(totals, Metric::SYSCALLS, 1);
+  add(totals, Metric::BYTES_RECEIVED, bytes);
+}
+
+void SSocks::SocketMetrics::wouldBlock() noexcept {
+  Counter* totals = threadTotals(source);
+  add(totals, Metric::SYSCALLS, 1);
+  add(totals, Metric::WOULD_BLOCK, 1);
+}
+
+void SSocks::SocketMetrics::failed() noexcept {
+  Counter* totals = threadTotals(source);
+  add(totals, Metric::SYSCALLS, 1);
+  add(totals, Metric::ERRORS, 1);
+}
+
+void SSocks::SocketMetrics::accepted() noexcept {
+  Counter* totals = threadTotals(source);
+  add(totals, Metric::SYSCALLS, 1);
+  add(totals, Metric::ACCEPTS, 1);
+}
+
+void SSocks::SocketMetrics::connected() noexcept {
+  Counter* totals = threadTotals(source);
+  add(totals, Metric::SYSCALLS, 1);
+  add(totals, Metric::CONNECTS, 1);
+}
+#else
+SSocks::SocketMetrics::SocketMetrics(MetricSource) {}
+SSocks::SocketMetrics::SocketMetrics(const SocketMetrics&) {}
+SSocks::SocketMetrics& SSocks::SocketMetrics::operator=(const SocketMetrics&) { return *this; }
+SSocks::MetricsSnapshot SSocks::SocketMetrics::snapshot() const { return MetricsSnapshot(); }
+void SSocks::SocketMetrics::reset() {}
+#endif
+
+/////////////////////////METRICSREGISTRY/////////////////////////
+
+SSocks::MetricsSnapshot SSocks::MetricsRegistry::snapshot(MetricSource source) {
+  MetricsSnapshot result;
+  #ifndef SSOCKS_NO_METRICS
+  size_t index = static_cast<size_t>(source);
+  Shards& all = shards();
+  std::lock_guard<std::mutex> lock(all.mutex);
+  sumShards(all, index, result.values.data());
+  for(size_t i = 0; i < METRIC_COUNT; i++) { result.values[i] -= all.baseline[index][i]; }
+  #else
+  (void)source;
+  #endif
+  return result;
+}
+
+SSocks::MetricsSnapshot SSocks::MetricsRegistry::snapshot() {
+  MetricsSnapshot result;
+  for(size_t s = 0; s < METRIC_SOURCE_COUNT; s++) { result += snapshot(static_cast<MetricSource>(s)); }
+  return result;
+}
+
+std::string SSocks::MetricsRegistry::exposition(const std::string& prefix) {
+  MetricsSnapshot bySource[METRIC_SOURCE_COUNT];
+  for(size_t s = 0; s < METRIC_SOURCE_COUNT; s++) { bySource[s] = snapshot(static_cast<MetricSource>(s)); }
+
+  std::ostringstream out;
+  for(size_t i = 0; i < METRIC_COUNT; i++) {
+    std::string name = prefix + "_" + METRIC_NAMES[i] + "_total";
+    out << "# TYPE " << name << " counter\n";
+    for(size_t s = 0; s < METRIC_SOURCE_COUNT; s++) {
+      out << name << "{source=\"" << SOURCE_NAMES[s] << "\"} " << bySource[s].values[i] << "\n";
+    }
+  }
+  return out.str();
+}
+
+//The shards belong to their threads, so rather than zero them from here the current totals
+//become the baseline that snapshots are taken from.
+void SSocks::MetricsRegistry::reset() {
+  #ifndef SSOCKS_NO_METRICS
+  Shards& all = shards();
+  std::lock_guard<std::mutex> lock(all.mutex);
+  for(size_t s = 0; s < METRIC_SOURCE_COUNT; s++) { sumShards(all, s, all.baseline[s]); }
+  #endif
+}
+
+bool SSocks::MetricsRegistry::isEnabled() {
+  #ifndef SSOCKS_NO_METRICS
+  return true;
+  #else
+  return false;
+  #endif
+}
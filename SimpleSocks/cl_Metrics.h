@@ -0,0 +1,149 @@
+/** @file */
+#pragma once
+#include <array>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+//The I/O counters cost a few plain (unlocked) loads and stores per system call. Define
+//SSOCKS_NO_METRICS for the whole build (the library and everything that includes it) to remove
+//them entirely; the API stays, and every count reads zero.
+
+namespace SSocks {
+
+  //! The I/O counters kept for each socket and in total.
+  enum class Metric {
+    //! Bytes handed to the system by send calls.
+    BYTES_SENT,
+    //! Bytes returned by recieve calls.
+    BYTES_RECEIVED,
+    //! Send, recieve, accept and connect system calls made.
+    SYSCALLS,
+    //! Send calls that took only part of what they were given.
+    PARTIAL_SENDS,
+    //! Calls that found nothing to do on a non-blocking socket (EAGAIN, EWOULDBLOCK or WSAEWOULDBLOCK).
+    WOULD_BLOCK,
+    //! Calls that failed with any other error.
+    ERRORS,
+    //! Connections accepted.
+    ACCEPTS,
+    //! Connections made.
+    CONNECTS
+  };
+
+  //! The number of values in Metric.
+  const size_t METRIC_COUNT = 8;
+
+  //! The kinds of socket that metrics are kept for.
+  enum class MetricSource { TCP_SOCKET, TCP_SERVER, UDP_SOCKET };
+
+  //! The number of values in MetricSource.
+  const size_t METRIC_SOURCE_COUNT = 3;
+
+  //! Return the name of a metric as used in the text exposition, such as "bytes_sent".
+  const char* metricName(Metric metric);
+
+  //! Return the name of a metric source as used in the text exposition, such as "tcp_socket".
+  const char* metricSourceName(MetricSource source);
+
+  //! A copy of a set of counters, taken at one moment.
+  struct MetricsSnapshot {
+    //! The counts, indexed by Metric.
+    std::array<uint64_t, METRIC_COUNT> values{};
+
+    //! Return one count.
+    uint64_t operator[](Metric metric) const { return values[static_cast<size_t>(metric)]; }
+
+    //! Add another snapshot's counts to this one's.
+    MetricsSnapshot& operator+=(const MetricsSnapshot& other);
+  };
+
+  /**
+   * The I/O counters of one socket.
+   * Each socket class holds one and updates it as it makes system calls; every update is also
+   * added to the global totals that MetricsRegistry reports. The counters are relaxed atomics,
+   * so reading them from another thread is safe, though a snapshot taken during I/O may be a
+   * moment out of date. To keep updates cheap they are a load and a store rather than a locked
+   * increment, which assumes one thread at a time does I/O on the socket. If two threads use it
+   * at once (say one sending while another receives), the counts they share, such as SYSCALLS,
+   * may come out slightly low. The global totals are not affected. Counts cover the life of the
+   * socket object, across reconnects.
+   */
+  class SocketMetrics {
+  public:
+    //! Create zeroed counters for a socket of the indicated kind.
+    explicit SocketMetrics(MetricSource source);
+
+    //! Copy the counts (used when a socket is moved).
+    SocketMetrics(const SocketMetrics& other);
+
+    //! Copy the counts (used when a socket is moved).
+    SocketMetrics& operator=(const SocketMetrics& other);
+
+    //! Return a copy of the counts.
+    MetricsSnapshot snapshot() const;
+
+    //! Zero the counts. Call it from the thread doing I/O on the socket. The global totals are not affected.
+    void reset();
+
+  private:
+#ifndef SSOCKS_NO_METRICS
+    MetricSource source;
+    std::array<std::atomic<uint64_t>, METRIC_COUNT> counters;
+
+    void add(std::atomic<uint64_t>* totals, Metric metric, uint64_t amount) noexcept;
+
+    void sent(size_t bytes, size_t wanted) noexcept;
+    void received(size_t bytes) noexcept;
+    void wouldBlock() noexcept;
+    void failed() noexcept;
+    void accepted() noexcept;
+    void connected() noexcept;
+#else
+    void sent(size_t, size_t) noexcept {}
+    void received(size_t) noexcept {}
+    void wouldBlock() noexcept {}
+    void failed() noexcept {}
+    void accepted() noexcept {}
+    void connected() noexcept {}
+#endif
+
+    friend class TCPSocket;
+    friend class TCPServer;
+    friend class UDPSocket;
+
+  };
+
+  /**
+   * The global I/O totals, summed over every socket of each kind.
+   * Sockets add to the totals as they go, into counters owned by the thread doing the I/O, so
+   * threads never contend on a cache line or need a locked instruction. The per-thread counters
+   * are only summed when a snapshot is asked for, and a thread's counts are kept when it exits.
+   * Every function is safe to call from any thread.
+   */
+  class MetricsRegistry {
+  public:
+    //! Return the totals for one kind of socket, since the program started or reset() was called.
+    static MetricsSnapshot snapshot(MetricSource source);
+
+    //! Return the totals for every kind of socket together.
+    static MetricsSnapshot snapshot();
+
+    /**
+     * Return the totals in the Prometheus text exposition format, for a metrics scraper.
+     * Each metric is a counter named "<prefix>_<metric>_total", with one sample per kind of
+     * socket, as in: ssocks_bytes_sent_total{source="tcp_socket"} 1024
+     * @param prefix The prefix for the metric names.
+     */
+    static std::string exposition(const std::string& prefix = "ssocks");
+
+    //! Zero the totals. Counts made by other threads at the same moment may land on either side.
+    static void reset();
+
+    //! Return false if the counters were compiled out with SSOCKS_NO_METRICS.
+    static bool isEnabled();
+
+  };
+
+}
@@ -0,0 +1,295 @@
+#include "cl_Poller.h"
+#include "cl_TCPSocket.h"
+#include "cl_TCPServer.h"
+#include "cl_UDPSocket.h"
+#include "ns_Platform.h"
+#include <cmath>
+#include <climits>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+namespace {
+  //Convert the float seconds used throughout SSocks to the milliseconds that the polling calls want.
+  //Partial milliseconds are rounded up so that a short timeout doesn't turn into a busy loop.
+  int toMilliseconds(float timeoutSeconds) {
+    if(timeoutSeconds < 0) { return -1; }
+    const double MS_PER_SEC = 1000.0;
+    //very long timeouts (such as a large value standing in for SELECT_FOREVER) don't fit in an int
+    double ms = std::ceil(timeoutSeconds * MS_PER_SEC);
+    return ms >= INT_MAX ? INT_MAX : static_cast<int>(ms);
+  }
+}
+
+#ifdef __linux__
+
+////////////////////////////EPOLL BACKEND////////////////////////////
+
+struct SSocks::Poller::State {
+  int epfd = Utility::Platform::INVALID_SOCK;
+  //scratch space for epoll_wait(), kept between calls so that waiting doesn't allocate
+  std::vector<epoll_event> buffer;
+  //registered handle -> object that added it, and back (see track())
+  std::unordered_map<int, const void*> owners;
+  std::unordered_map<const void*, int> handles;
+};
+
+namespace {
+  //translate SSocks interest flags to epoll flags
+  epoll_event toEpoll(uint32_t interest, void* userData) {
+    epoll_event ev = {};
+    if(interest & SSocks::Poller::READ)  { ev.events |= EPOLLIN; }
+    if(interest & SSocks::Poller::WRITE) { ev.events |= EPOLLOUT; }
+    if(interest & SSocks::Poller::EDGE)  { ev.events |= EPOLLET; }
+    ev.data.ptr = userData;
+    return ev;
+  }
+}
+
+SSocks::Poller::Poller() : state(new State) {
+  state->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if(state->epfd == -1) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
+}
+
+SSocks::Poller::~Poller() {
+  //a moved-from Poller has no state
+  if(state) { ::close(state->epfd); }
+}
+
+void SSocks::Poller::addSock(int sock, uint32_t interest, void* userData, const void* owner) {
+  if(sock == Utility::Platform::INVALID_SOCK) { throw std::runtime_error("Attempted to add closed socket to Poller."); }
+
+  epoll_event ev = toEpoll(interest, userData);
+  if(epoll_ctl(state->epfd, EPOLL_CTL_ADD, sock, &ev)) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
+
+  //If the handle was already tracked then it belonged to a socket that was closed without being
+  //removed (which drops it from epoll), and the number has since been reused. track() replaces it.
+  track(sock, owner);
+}
+
+void SSocks::Poller::modifySock(int sock, uint32_t interest, void* userData) {
+  epoll_event ev = toEpoll(interest, userData);
+  if(epoll_ctl(state->epfd, EPOLL_CTL_MOD, sock, &ev)) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
+}
+
+void SSocks::Poller::removeSock(int sock, const void* owner) {
+  auto iter = state->owners.find(sock);
+  if(iter == state->owners.end() || (owner && iter->second != owner)) { return; }
+
+  //a socket that was closed has already been dropped by epoll, so a failure here is not an error
+  epoll_ctl(state->epfd, EPOLL_CTL_DEL, sock, nullptr);
+  untrack(sock);
+}
+
+size_t SSocks::Poller::wait(Event* events, size_t maxEvents, float timeoutSeconds) {
+  if(maxEvents == 0) { return 0; }
+
+  //only grows, so steady-state waits don't touch the allocator
+  if(state->buffer.size() < maxEvents) { state->buffer.resize(maxEvents); }
+
+  int result = epoll_wait(state->epfd, state->buffer.data(), static_cast<int>(maxEvents), toMilliseconds(timeoutSeconds));
+  if(result == -1) {
+    //a signal interrupted the wait, which is reported the same as a timeout
+    int err = Utility::Platform::lastError();
+    if(err == EINTR) { return 0; }
+    throw std::runtime_error(Utility::lastErrStr(err));
+  }
+
+  //translate the results back into SSocks terms
+  for(int i = 0; i < result; i++) {
+    const epoll_event& ev = state->buffer[i];
+    uint32_t flags = 0;
+    if(ev.events & EPOLLIN)  { flags |= READ; }
+    if(ev.events & EPOLLOUT) { flags |= WRITE; }
+    if(ev.events & (EPOLLERR | EPOLLHUP)) { flags |= FAULT; }
+    events[i].flags = flags;
+    events[i].userData = ev.data.ptr;
+  }
+
+  return result;
+}
+
+#else
+
+////////////////////////////POLL BACKEND////////////////////////////
+
+struct SSocks::Poller::State {
+  //pollfds and user data are kept in parallel so the pollfd array can be passed straight to poll()
+  std::vector<pollfd> fds;
+  std::vector<void*> userData;
+  //socket -> position in the arrays above
+  std::unordered_map<int, size_t> index;
+  //registered handle -> object that added it, and back (see track())
+  std::unordered_map<int, const void*> owners;
+  std::unordered_map<const void*, int> handles;
+};
+
+namespace {
+  //translate SSocks interest flags to poll flags
+  short toPoll(uint32_t interest) {
+    if(interest & SSocks::Poller::EDGE) { throw std::runtime_error("Edge-triggered Poller mode is only available on Linux."); }
+
+    short events = 0;
+    if(interest & SSocks::Poller::READ)  { events |= POLLIN; }
+    if(interest & SSocks::Poller::WRITE) { events |= POLLOUT; }
+    return events;
+  }
+}
+
+SSocks::Poller::Poller() : state(new State) {
+  Utility::Platform::startup();
+}
+
+SSocks::Poller::~Poller() {
+  //nothing - the registered sockets are not owned by the Poller
+}
+
+void SSocks::Poller::addSock(int sock, uint32_t interest, void* userData, const void* owner) {
+  if(sock == Utility::Platform::INVALID_SOCK) { throw std::runtime_error("Attempted to add closed socket to Poller."); }
+  if(state->index.count(sock)) {
+    //An open handle belongs to one object, so if another object registered this number then that
+    //socket was closed without being removed and the number has been reused. Drop the stale entry.
+    if(state->owners[sock] == owner) { throw std::runtime_error("Attempted to add socket to Poller twice."); }
+    removeSock(sock, nullptr);
+  }
+
+  pollfd pfd = {};
+  pfd.fd = sock;
+  pfd.events = toPoll(interest);
+
+  state->index[sock] = state->fds.size();
+  state->fds.push_back(pfd);
+  state->userData.push_back(userData);
+  track(sock, owner);
+}
+
+void SSocks::Poller::modifySock(int sock, uint32_t interest, void* userData) {
+  auto iter = state->index.find(sock);
+  if(iter == state->index.end()) { throw std::runtime_error("Attempted to modify socket not registered with Poller."); }
+
+  state->fds[iter->second].events = toPoll(interest);
+  state->userData[iter->second] = userData;
+}
+
+void SSocks::Poller::removeSock(int sock, const void* owner) {
+  auto iter = state->index.find(sock);
+  if(iter == state->index.end()) { return; }
+  if(owner && state->owners[sock] != owner) { return; }
+  untrack(sock);
+
+  //swap the last registration into the vacated slot so removal is O(1)
+  size_t slot = iter->second;
+  state->index.erase(iter);
+
+  size_t last = state->fds.size() - 1;
+  if(slot != last) {
+    state->fds[slot] = state->fds[last];
+    state->userData[slot] = state->userData[last];
+    state->index[state->fds[slot].fd] = slot;
+  }
+
+  state->fds.pop_back();
+  state->userData.pop_back();
+}
+
+size_t SSocks::Poller::wait(Event* events, size_t maxEvents, float timeoutSeconds) {
+  if(maxEvents == 0 || state->fds.empty()) { return 0; }
+
+  int result = Utility::Platform::poll(state->fds.data(), state->fds.size(), toMilliseconds(timeoutSeconds));
+  if(result == Utility::Platform::SOCK_ERROR) {
+    int err = Utility::Platform::lastError();
+    #ifndef _WIN32
+    if(err == EINTR) { return 0; }
+    #endif
+    throw std::runtime_error(Utility::lastErrStr(err));
+  }
+
+  //collect the ready sockets
+  size_t count = 0;
+  std::vector<int> invalid;
+  for(size_t i = 0; i < state->fds.size() && count < maxEvents && result > 0; i++) {
+    short revents = state->fds[i].revents;
+    if(!revents) { continue; }
+    result--;
+
+    uint32_t flags = 0;
+    if(revents & POLLIN)  { flags |= READ; }
+    if(revents & POLLOUT) { flags |= WRITE; }
+    if(revents & (POLLERR | POLLHUP | POLLNVAL)) { flags |= FAULT; }
+    events[count].flags = flags;
+    events[count].userData = state->userData[i];
+    count++;
+
+    //The handle was closed without being removed. Report the fault once, then forget it (as
+    //epoll does) rather than report it on every wait.
+    if(revents & POLLNVAL) { invalid.push_back(static_cast<int>(state->fds[i].fd)); }
+  }
+  for(int sock : invalid) { removeSock(sock, nullptr); }
+
+  return count;
+}
+
+#endif
+
+////////////////////////////COMMON////////////////////////////
+
+SSocks::Poller::Poller(Poller&& moveFrom) : state(std::move(moveFrom.state)) {
+  //nothing
+}
+
+SSocks::Poller& SSocks::Poller::operator=(Poller&& moveFrom) {
+  //swapping hands our old state to the source, which will release it when it destructs
+  std::swap(state, moveFrom.state);
+  return *this;
+}
+
+size_t SSocks::Poller::wait(std::vector<Event>& events, float timeoutSeconds) {
+  return wait(events.data(), events.size(), timeoutSeconds);
+}
+
+size_t SSocks::Poller::size() const {
+  return state->owners.size();
+}
+
+//A socket that has closed itself no longer holds its handle, so removal falls back to the handle
+//that the same object registered. Tracking both ways keeps that lookup and size() cheap.
+void SSocks::Poller::track(int sock, const void* owner) {
+  untrack(sock);
+  state->owners[sock] = owner;
+  if(owner) { state->handles[owner] = sock; }
+}
+
+void SSocks::Poller::untrack(int sock) {
+  auto iter = state->owners.find(sock);
+  if(iter == state->owners.end()) { return; }
+
+  //the owner may have gone on to register a different handle, which keeps its entry
+  auto handle = state->handles.find(iter->second);
+  if(handle != state->handles.end() && handle->second == sock) { state->handles.erase(handle); }
+  state->owners.erase(iter);
+}
+
+void SSocks::Poller::removeOwned(int sock, const void* owner) {
+  if(sock == Utility::Platform::INVALID_SOCK) {
+    auto iter = state->handles.find(owner);
+    if(iter == state->handles.end()) { return; }
+    sock = iter->second;
+  }
+  removeSock(sock, nullptr);
+}
+
+//Each socket type simply hands its raw socket to the private implementation.
+void SSocks::Poller::add(const TCPSocket& sock, uint32_t interest, void* userData) { addSock(sock.sock, interest, userData, &sock); }
+void SSocks::Poller::add(const TCPServer& sock, uint32_t interest, void* userData) { addSock(sock.sock, interest, userData, &sock); }
+void SSocks::Poller::add(const UDPSocket& sock, uint32_t interest, void* userData) { addSock(sock.sock, interest, userData, &sock); }
+
+//a moved socket is modified through its new object, which from then on is the one to remove it by
+void SSocks::Poller::modify(const TCPSocket& sock, uint32_t interest, void* userData) { modifySock(sock.sock, interest, userData); track(sock.sock, &sock); }
+void SSocks::Poller::modify(const TCPServer& sock, uint32_t interest, void* userData) { modifySock(sock.sock, interest, userData); track(sock.sock, &sock); }
+void SSocks::Poller::modify(const UDPSocket& sock, uint32_t interest, void* userData) { modifySock(sock.sock, interest, userData); track(sock.sock, &sock); }
+
+void SSocks::Poller::remove(const TCPSocket& sock) { removeOwned(sock.sock, &sock); }
+void SSocks::Poller::remove(const TCPServer& sock) { removeOwned(sock.sock, &sock); }
+void SSocks::Poller::remove(const UDPSocket& sock) { removeOwned(sock.sock, &sock); }
@@ -0,0 +1,140 @@
+/** @file */
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "fn_select.h"
+
+namespace SSocks {
+  //forward declarations
+  class TCPSocket;
+  class TCPServer;
+  class UDPSocket;
+
+  /**
+   * Persistent readiness monitor for any mix of TCPSocket, TCPServer and UDPSocket objects.
+   * Unlike SSocks::select(), which rebuilds its set from scratch on every call, a Poller
+   * remembers its registrations between waits, so a wait only costs as much as the number of
+   * sockets that are actually ready. On Linux it is backed by epoll. On other platforms it
+   * falls back to poll() (WSAPoll() on Windows), which keeps the same interface but scans every
+   * registration per wait and does not support edge-triggered mode.\n
+   * Each socket may be registered once per Poller. Moving a socket object keeps the
+   * registration intact since the underlying socket is unchanged. A socket that closes itself
+   * (as TCPSocket does when the remote host hangs up) can still be removed afterwards through
+   * the object it was added or last modified with, since the Poller remembers which handle that
+   * object registered. Remove a socket before destroying it.
+   */
+  class Poller {
+  public:
+    /**
+     * Interest and event flags.
+     * READ, WRITE and EDGE may be passed as interest when registering a socket. Events returned
+     * from wait() carry READ, WRITE and FAULT. FAULT (an error or hang-up on the socket) is
+     * always reported and does not need to be requested. A TCPServer reports READ when it has
+     * a connection waiting to be accepted.
+     */
+    enum Flags : uint32_t {
+      READ  = 1 << 0, //!< The socket can be read from (or accepted from) without blocking.
+      WRITE = 1 << 1, //!< The socket can be written to without blocking.
+      FAULT = 1 << 2, //!< The socket has an error pending or was hung up. (Event only.)
+      EDGE  = 1 << 3  //!< Report readiness only on transitions rather than while it persists. (Interest only.)
+    };
+
+    //! A single readiness report produced by wait().
+    struct Event {
+      //! Which of READ, WRITE and FAULT are set for this socket.
+      uint32_t flags;
+      //! The user data given when the socket was registered.
+      void* userData;
+    };
+
+    //! Create an empty Poller.
+    Poller();
+
+    //! Copying is prohibited, as the Poller owns a system resource.
+    Poller(const Poller&) = delete;
+
+    //! Copying is prohibited, as the Poller owns a system resource.
+    Poller& operator=(const Poller&) = delete;
+
+    //! Move constructor to transfer ownership to a new Poller.
+    Poller(Poller&& moveFrom);
+
+    //! Move-assign operator to transfer ownership to a new Poller.
+    Poller& operator=(Poller&& moveFrom);
+
+    //! Destructor. Registered sockets are not affected.
+    ~Poller();
+
+    /**
+     * Begin monitoring a socket.
+     * @param sock The socket to monitor. It must be open.
+     * @param interest A combination of READ, WRITE and EDGE.
+     * @param userData An arbitrary pointer that is handed back in every Event for this socket.
+     */
+    void add(const TCPSocket& sock, uint32_t interest, void* userData = nullptr);
+    //! @copydoc add(const TCPSocket&, uint32_t, void*)
+    void add(const TCPServer& sock, uint32_t interest, void* userData = nullptr);
+    //! @copydoc add(const TCPSocket&, uint32_t, void*)
+    void add(const UDPSocket& sock, uint32_t interest, void* userData = nullptr);
+
+    /**
+     * Change the interest and user data of a registered socket.
+     * @param sock The socket to modify. It must already have been added.
+     * @param interest A combination of READ, WRITE and EDGE.
+     * @param userData An arbitrary pointer that is handed back in every Event for this socket.
+     */
+    void modify(const TCPSocket& sock, uint32_t interest, void* userData = nullptr);
+    //! @copydoc modify(const TCPSocket&, uint32_t, void*)
+    void modify(const TCPServer& sock, uint32_t interest, void* userData = nullptr);
+    //! @copydoc modify(const TCPSocket&, uint32_t, void*)
+    void modify(const UDPSocket& sock, uint32_t interest, void* userData = nullptr);
+
+    //! Stop monitoring a socket. Sockets that are not registered are ignored.
+    void remove(const TCPSocket& sock);
+    //! @copydoc remove(const TCPSocket&)
+    void remove(const TCPServer& sock);
+    //! @copydoc remove(const TCPSocket&)
+    void remove(const UDPSocket& sock);
+
+    /**
+     * Wait until one or more registered sockets are ready and report them.
+     * @param events Caller-owned buffer to receive the events.
+     * @param maxEvents The capacity of 'events'.
+     * @param timeoutSeconds The maximum number of seconds to wait. SELECT_FOREVER waits indefinitely and zero just checks.
+     * @return The number of events written to 'events'. Zero indicates a timeout (or an interrupted wait).
+     */
+    size_t wait(Event* events, size_t maxEvents, float timeoutSeconds = SELECT_FOREVER);
+
+    /**
+     * Wait until one or more registered sockets are ready and report them.
+     * @param events Caller-owned buffer to receive the events. Its size() is used as the capacity and is not changed.
+     * @param timeoutSeconds The maximum number of seconds to wait. SELECT_FOREVER waits indefinitely and zero just checks.
+     * @return The number of events written to the front of 'events'.
+     */
+    size_t wait(std::vector<Event>& events, float timeoutSeconds = SELECT_FOREVER);
+
+    //! Return the number of sockets currently registered.
+    size_t size() const;
+
+  private:
+    //The backend state is hidden so that the native polling headers don't leak into user code.
+    struct State;
+    std::unique_ptr<State> state;
+
+    //'owner' identifies the object that registered the handle, so that it can be found again after that object closes it
+    void addSock(int sock, uint32_t interest, void* userData, const void* owner);
+    void modifySock(int sock, uint32_t interest, void* userData);
+    //only removes the handle if it is still registered to 'owner' (or to anyone, if 'owner' is null)
+    void removeSock(int sock, const void* owner);
+    void removeOwned(int sock, const void* owner);
+    void track(int sock, const void* owner);
+    void untrack(int sock);
+
+    //EventLoop registers its raw wakeup handle alongside ordinary sockets
+    friend class EventLoop;
+
+  };
+
+}
@@ -0,0 +1,258 @@
+#include "cl_Resolver.h"
+#include "cl_WorkerPool.h"
+#include "ns_Platform.h"
+#include <unordered_map>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cctype>
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  //the cache is split by name hash so that lookups of different names rarely share a lock
+  const size_t SHARD_COUNT = 16;
+  //a shard this large is swept for expired entries before it grows further
+  const size_t SWEEP_THRESHOLD = 1024;
+
+  //this struct provides exception safety by calling freeaddrinfo()
+  struct GAI_RAII {
+    ~GAI_RAII() { if(root) { freeaddrinfo(root); } }
+    addrinfo* root = nullptr;
+  };
+
+  struct Waiter {
+    uint16_t port;
+    SSocks::Resolver::Callback onDone;
+  };
+
+  struct Entry {
+    std::vector<SSocks::HostAddress> addresses;
+    std::string error;
+    Clock::time_point expires;
+    bool pending = false; //a lookup is in flight and 'waiters' are queued on it
+    bool isStatic = false;
+    std::vector<Waiter> waiters;
+  };
+
+  //DNS names are case-insensitive, so the cache is keyed by the lowercase form
+  std::string toKey(const std::string& hostName) {
+    std::string key(hostName);
+    for(char& c : key) { c = static_cast<char>(std::tolower(static_cast<unsigned char>(c))); }
+    return key;
+  }
+
+  std::vector<SSocks::HostAddress> withPort(std::vector<SSocks::HostAddress> addresses, uint16_t port) {
+    for(SSocks::HostAddress& address : addresses) { address.setPort(port); }
+    return addresses;
+  }
+
+  Clock::duration toDuration(float seconds) {
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(seconds));
+  }
+}
+
+struct SSocks::Resolver::State {
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+  };
+
+  Shard shards[SHARD_COUNT];
+  Clock::duration positiveTtl;
+  Clock::duration negativeTtl;
+  bool negativeCaching;
+  std::atomic<bool> systemLookup;
+
+  //Declared last so that it's destroyed first: its threads finish the queued lookups while
+  //the cache they write to is still here.
+  std::unique_ptr<WorkerPool> pool;
+
+  Shard& shardFor(const std::string& key) {
+    return shards[std::hash<std::string>()(key) % SHARD_COUNT];
+  }
+
+  void complete(const std::string& hostName, const std::string& key);
+};
+
+//Runs on a pool thread. Looks the name up and answers everyone who asked for it meanwhile.
+void SSocks::Resolver::State::complete(const std::string& hostName, const std::string& key) {
+  std::vector<HostAddress> addresses;
+  std::string error;
+
+  //No retrying on EAI_AGAIN here: the failure is cached only briefly, and the next request
+  //after that tries again without anyone having been made to wait.
+  GAI_RAII data;
+  addrinfo hints = { 0 };
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM; //one entry per address rather than one per socket type
+  int result = getaddrinfo(hostName.c_str(), nullptr, &hints, &data.root);
+  if(result == 0) {
+    for(addrinfo* node = data.root; node; node = node->ai_next) { addresses.emplace_back(node->ai_addr); }
+  }
+  else {
+    error = "getaddrinfo() failed: " + Utility::Platform::gaiErrStr(result);
+  }
+
+  Shard& shard = shardFor(key);
+  std::vector<Waiter> waiters;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry& entry = shard.entries[key];
+    waiters.swap(entry.waiters);
+    entry.pending = false;
+
+    if(entry.isStatic) {
+      //a static entry was added while the lookup was in flight, and it takes precedence
+      addresses = entry.addresses;
+      error.clear();
+    }
+    else if(error.empty() || negativeCaching) {
+      entry.addresses = addresses;
+      entry.error = error;
+      entry.expires = Clock::now() + (error.empty() ? positiveTtl : negativeTtl);
+    }
+    else {
+      shard.entries.erase(key);
+    }
+  }
+
+  for(Waiter& waiter : waiters) { waiter.onDone(withPort(addresses, waiter.port), error); }
+}
+
+SSocks::Resolver::Resolver(size_t threads, float positiveTtlSeconds, float negativeTtlSeconds) : state(new State) {
+  //winsock must be loaded for getaddrinfo() to work
+  Utility::Platform::startup();
+
+  state->positiveTtl = toDuration(positiveTtlSeconds);
+  state->negativeTtl = toDuration(negativeTtlSeconds);
+  state->negativeCaching = negativeTtlSeconds > 0;
+  state->systemLookup = true;
+
+  //the pool's connection handling isn't used; lookups are posted to it as general jobs
+  state->pool.reset(new WorkerPool([](TCPSocket&, size_t) { return false; }, threads == 0 ? 1 : threads));
+}
+
+SSocks::Resolver::~Resolver() {
+  state->pool->stop();
+}
+
+void SSocks::Resolver::resolve(const std::string& hostName, uint16_t port, Callback onDone) {
+  std::string key = toKey(hostName);
+  State::Shard& shard = state->shardFor(key);
+  std::unique_lock<std::mutex> lock(shard.mutex);
+
+  auto iter = shard.entries.find(key);
+  if(iter != shard.entries.end()) {
+    Entry& entry = iter->second;
+
+    //someone already asked, so wait on their lookup
+    if(entry.pending) {
+      entry.waiters.push_back(Waiter{ port, std::move(onDone) });
+      return;
+    }
+
+    //answer from the cache if the entry is still fresh
+    if(entry.isStatic || Clock::now() < entry.expires) {
+      std::vector<HostAddress> addresses = withPort(entry.addresses, port);
+      std::string error = entry.error;
+      lock.unlock();
+      onDone(addresses, error);
+      return;
+    }
+  }
+  else if(shard.entries.size() >= SWEEP_THRESHOLD) {
+    Clock::time_point now = Clock::now();
+    for(auto it = shard.entries.begin(); it != shard.entries.end();) {
+      const Entry& entry = it->second;
+      if(!entry.pending && !entry.isStatic && now >= entry.expires) { it = shard.entries.erase(it); }
+      else { ++it; }
+    }
+  }
+
+  if(!state->systemLookup) {
+    lock.unlock();
+    onDone(std::vector<HostAddress>(), "No static entry for host: " + hostName);
+    return;
+  }
+
+  //start a lookup and queue this request as its first waiter
+  Entry& entry = shard.entries[key];
+  entry.pending = true;
+  entry.waiters.push_back(Waiter{ port, std::move(onDone) });
+  lock.unlock();
+
+  State* s = state.get();
+  state->pool->post([s, hostName, key](size_t) { s->complete(hostName, key); });
+}
+
+std::future<std::vector<SSocks::HostAddress>> SSocks::Resolver::resolve(const std::string& hostName, uint16_t port) {
+  auto promise = std::make_shared<std::promise<std::vector<HostAddress>>>();
+  std::future<std::vector<HostAddress>> result = promise->get_future();
+
+  resolve(hostName, port, [promise](const std::vector<HostAddress>& addresses, const std::string& error) {
+    if(error.empty()) { promise->set_value(addresses); }
+    else { promise->set_exception(std::make_exception_ptr(std::runtime_error(error))); }
+  });
+
+  return result;
+}
+
+std::vector<SSocks::HostAddress> SSocks::Resolver::lookup(const std::string& hostName, uint16_t port) {
+  return resolve(hostName, port).get();
+}
+
+void SSocks::Resolver::addHost(const std::string& hostName, const std::vector<HostAddress>& addresses) {
+  std::string key = toKey(hostName);
+  State::Shard& shard = state->shardFor(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  Entry& entry = shard.entries[key];
+  entry.addresses = addresses;
+  entry.error.clear();
+  entry.isStatic = true;
+}
+
+size_t SSocks::Resolver::loadHosts(const std::string& path) {
+  std::ifstream file(path);
+  if(!file) { throw std::runtime_error("Could not open hosts file: " + path); }
+
+  //a name may appear on several lines, so gather everything before adding it
+  std::map<std::string, std::vector<HostAddress>> hosts;
+  std::string line;
+  while(std::getline(file, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+
+    std::string addressStr;
+    if(!(fields >> addressStr)) { continue; }
+
+    HostAddress address;
+    if(!HostAddress::parse(addressStr, 0, address)) { continue; }
+
+    std::string name;
+    while(fields >> name) { hosts[toKey(name)].push_back(address); }
+  }
+
+  for(auto& host : hosts) { addHost(host.first, host.second); }
+  return hosts.size();
+}
+
+void SSocks::Resolver::setSystemLookup(bool enabled) {
+  state->systemLookup = enabled;
+}
+
+void SSocks::Resolver::clear() {
+  for(State::Shard& shard : state->shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for(auto it = shard.entries.begin(); it != shard.entries.end();) {
+      const Entry& entry = it->second;
+      if(!entry.pending && !entry.isStatic) { it = shard.entries.erase(it); }
+      else { ++it; }
+    }
+  }
+}
@@ -0,0 +1,110 @@
+/** @file */
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <future>
+#include <memory>
+#include <cstdint>
+#include "cl_HostAddress.h"
+
+namespace SSocks {
+
+  /**
+   * Asynchronous DNS resolver with a cache.
+   * Lookups run on a small pool of the resolver's own threads, so the caller never waits on
+   * getaddrinfo(). Results are cached: successful ones for the positive TTL and failures for the
+   * negative TTL. (getaddrinfo() doesn't report the records' own TTLs, so these are fixed
+   * lifetimes chosen by the user.) Concurrent lookups of a name that is already being resolved
+   * join the lookup in flight instead of starting another. The cache is split into shards with
+   * their own locks, so lookups of different names rarely contend.\n
+   * Static entries can be added with addHost() or loadHosts(), in the manner of a hosts file.
+   * They take precedence over DNS and never expire. With system lookups disabled, only static
+   * entries resolve, which makes the resolver usable offline and in tests.\n
+   * Every member function is safe to call from any thread.
+   */
+  class Resolver {
+  public:
+    /**
+     * Callback invoked when a lookup completes.
+     * A cache hit calls it straight away on the calling thread; otherwise it runs on one of the
+     * resolver's threads, so it should be quick and must not destroy the resolver.
+     * @param addresses The addresses found, with the requested port set. Empty on failure.
+     * @param error Empty on success; otherwise an explanation of the failure.
+     */
+    typedef std::function<void(const std::vector<HostAddress>& addresses, const std::string& error)> Callback;
+
+    /**
+     * Start the resolver threads.
+     * @param threads The number of lookups that may run at once.
+     * @param positiveTtlSeconds How long successful results are cached.
+     * @param negativeTtlSeconds How long failures are cached. Zero disables negative caching.
+     */
+    explicit Resolver(size_t threads = 2, float positiveTtlSeconds = 60, float negativeTtlSeconds = 5);
+
+    //! Copying is prohibited, as the resolver owns its threads.
+    Resolver(const Resolver&) = delete;
+
+    //! Copying is prohibited, as the resolver owns its threads.
+    Resolver& operator=(const Resolver&) = delete;
+
+    //! Destructor. Lookups already queued are finished first, so no callback is lost.
+    ~Resolver();
+
+    /**
+     * Look up a host, reporting the result through a callback.
+     * @param hostName Canonical name of host to look up, such as "google.com".
+     * @param port Port to set in the returned addresses.
+     * @param onDone Invoked once with the result.
+     */
+    void resolve(const std::string& hostName, uint16_t port, Callback onDone);
+
+    /**
+     * Look up a host, returning the result through a future.
+     * The future's get() throws std::runtime_error if the lookup failed.
+     * @param hostName Canonical name of host to look up, such as "google.com".
+     * @param port Port to set in the returned addresses.
+     */
+    std::future<std::vector<HostAddress>> resolve(const std::string& hostName, uint16_t port = 0);
+
+    /**
+     * Look up a host and wait for the result. A cached result is returned without waiting.
+     * @see nsLookup()
+     * @throw std::runtime_error if the lookup failed.
+     */
+    std::vector<HostAddress> lookup(const std::string& hostName, uint16_t port = 0);
+
+    /**
+     * Add a static entry, which is used in place of DNS and never expires.
+     * Adding a name that already has a static entry replaces it.
+     * @param hostName The name to resolve.
+     * @param addresses The addresses it resolves to. Their ports are ignored.
+     */
+    void addHost(const std::string& hostName, const std::vector<HostAddress>& addresses);
+
+    /**
+     * Add static entries from a file in hosts-file format.
+     * Each line holds an address followed by one or more names, and '#' starts a comment.
+     * Lines whose address can't be parsed are skipped.
+     * @param path The file to read.
+     * @return The number of names added.
+     * @throw std::runtime_error if the file can't be opened.
+     */
+    size_t loadHosts(const std::string& path);
+
+    /**
+     * Set whether names without a static entry are looked up through the system resolver.
+     * When disabled they fail with a "not found" error. Enabled by default.
+     */
+    void setSystemLookup(bool enabled);
+
+    //! Forget every cached result. Static entries are kept.
+    void clear();
+
+  private:
+    struct State;
+    std::unique_ptr<State> state;
+
+  };
+
+}
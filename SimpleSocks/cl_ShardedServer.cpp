@@ -0,0 +1,90 @@
+#include "cl_ShardedServer.h"
+#include "cl_TCPServer.h"
+#include "cl_EventLoop.h"
+#include <thread>
+
+//each shard is a listener with its own loop and the thread that runs it
+struct SSocks::ShardedServer::Shard {
+  TCPServer server;
+  EventLoop loop;
+  std::thread thread;
+};
+
+SSocks::ShardedServer::ShardedServer() {
+  //nothing
+}
+
+SSocks::ShardedServer::~ShardedServer() {
+  stop();
+}
+
+void SSocks::ShardedServer::start(uint16_t port, size_t shardCount, AcceptCallback onAccept, const std::string& localHostAddr) {
+  //halt service if already running
+  if(isOpen()) { stop(); }
+
+  if(shardCount == 0) { shardCount = std::thread::hardware_concurrency(); }
+  if(shardCount == 0) { shardCount = 1; } //hardware_concurrency() may not know
+
+  //Open every listener before starting any threads, so that a failure part way through
+  //(such as the port being taken) leaves nothing running.
+  std::vector<std::unique_ptr<Shard>> opened;
+  for(size_t i = 0; i < shardCount; i++) {
+    std::unique_ptr<Shard> shard(new Shard);
+    shard->server.setOptions(options);
+    shard->server.start(port, false, localHostAddr, true);
+    shard->loop.watch(shard->server, [onAccept, i](TCPSocket sock) { onAccept(std::move(sock), i); });
+    opened.push_back(std::move(shard));
+  }
+
+  shards = std::move(opened);
+  for(size_t i = 0; i < shards.size(); i++) {
+    EventLoop* loop = &shards[i]->loop;
+    ErrorCallback onError = this->onError;
+    shards[i]->thread = std::thread([loop, onError, i]() {
+      //An exception leaves run() mid-round, and running again picks up where it left off. If
+      //stop() was called meanwhile then run() returns at once.
+      while(true) {
+        try {
+          loop->run();
+          return;
+        }
+        catch(...) {
+          if(onError) { onError(std::current_exception(), i); }
+        }
+      }
+    });
+  }
+}
+
+void SSocks::ShardedServer::setOptions(const SocketOptions& options) {
+  this->options = options;
+}
+
+void SSocks::ShardedServer::setErrorCallback(ErrorCallback onError) {
+  this->onError = std::move(onError);
+}
+
+void SSocks::ShardedServer::stop() {
+  //signal everyone first so the shards wind down in parallel
+  for(auto& shard : shards) { shard->loop.stop(); }
+
+  for(auto& shard : shards) {
+    if(shard->thread.joinable()) { shard->thread.join(); }
+    shard->loop.unwatch(shard->server);
+  }
+
+  //releasing the shards closes the listeners
+  shards.clear();
+}
+
+bool SSocks::ShardedServer::isOpen() const {
+  return !shards.empty();
+}
+
+size_t SSocks::ShardedServer::size() const {
+  return shards.size();
+}
+
+SSocks::EventLoop& SSocks::ShardedServer::loop(size_t shard) {
+  return shards.at(shard)->loop;
+}
@@ -0,0 +1,100 @@
+/** @file */
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <cstdint>
+#include "cl_TCPSocket.h"
+
+namespace SSocks {
+  //forward declaration
+  class EventLoop;
+
+  /**
+   * A TCP server that accepts on several threads at once.
+   * ShardedServer opens one TCPServer per shard, all listening on the same port with port
+   * sharing (SO_REUSEPORT) enabled, and gives each shard its own thread and EventLoop. The
+   * kernel spreads incoming connections across the shards, so accepts no longer funnel through
+   * a single thread and queue.\n
+   * The accept callback runs on the shard's own thread. Connections can be handled right there,
+   * or watched on the shard's EventLoop (see loop()) so that they stay on the same thread.
+   * Anything thrown on a shard's thread, whether by a callback or by its listener, is handed to
+   * the error callback (see setErrorCallback()) and the shard carries on serving.
+   * Port sharing is not available on Windows, so start() throws there.
+   */
+  class ShardedServer {
+  public:
+    /**
+     * Callback invoked on a shard's thread for each connection it accepts.
+     * @param sock The new connection, in blocking mode until it is watched on an EventLoop.
+     * @param shard The index of the shard that accepted it.
+     */
+    typedef std::function<void(TCPSocket sock, size_t shard)> AcceptCallback;
+
+    /**
+     * Callback invoked on a shard's thread when something it runs throws.
+     * @param error The exception, which can be examined with std::rethrow_exception().
+     * @param shard The index of the shard that caught it.
+     */
+    typedef std::function<void(std::exception_ptr error, size_t shard)> ErrorCallback;
+
+    //! Generate an inactive server.
+    ShardedServer();
+
+    //! Copying is prohibited, as sockets are unique resources.
+    ShardedServer(const ShardedServer&) = delete;
+
+    //! Copying is prohibited, as sockets are unique resources.
+    ShardedServer& operator=(const ShardedServer&) = delete;
+
+    //! Destructor. Stops the server.
+    ~ShardedServer();
+
+    /**
+     * Open the listeners and start the shard threads.
+     * @param port The port to listen on.
+     * @param shards The number of listeners and threads. Zero uses one per hardware thread.
+     * @param onAccept Invoked on the accepting shard's thread for each incoming connection.
+     * @param localHostAddr Address of local interface to listen on.
+     */
+    void start(uint16_t port, size_t shards, AcceptCallback onAccept, const std::string& localHostAddr = "0.0.0.0");
+
+    /**
+     * Set the tuning options for accepted connections. They take effect on the next start().
+     * @see TCPServer::setOptions()
+     */
+    void setOptions(const SocketOptions& options);
+
+    /**
+     * Set the callback for exceptions caught on the shard threads. It takes effect on the next
+     * start(). Without one, such exceptions are discarded. The callback must not throw.
+     */
+    void setErrorCallback(ErrorCallback onError);
+
+    //! Stop every shard, join the threads and release the listeners.
+    void stop();
+
+    //! Indicates whether the server is running.
+    bool isOpen() const;
+
+    //! Return the number of shards.
+    size_t size() const;
+
+    /**
+     * Access a shard's event loop.
+     * Use this from within that shard's accept callback to watch the new connection on the same
+     * thread. From any other thread only EventLoop::post() may be used.
+     */
+    EventLoop& loop(size_t shard);
+
+  private:
+    struct Shard;
+    std::vector<std::unique_ptr<Shard>> shards;
+    SocketOptions options;
+    ErrorCallback onError;
+
+  };
+
+}
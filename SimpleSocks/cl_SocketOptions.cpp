@@ -0,0 +1,85 @@
+#include "cl_SocketOptions.h"
+#include "ns_Platform.h"
+
+//macOS calls the keepalive idle time TCP_KEEPALIVE
+#if !defined(TCP_KEEPIDLE) && defined(TCP_KEEPALIVE)
+#define TCP_KEEPIDLE TCP_KEEPALIVE
+#endif
+
+namespace {
+  //Once one option has failed the rest are skipped, so 'err' ends up holding the first failure.
+  //The code is read straight away, before anything else can overwrite it.
+  void setInt(int& err, int sock, int level, int name, int value) {
+    if(err) { return; }
+    int result = setsockopt(sock, level, name, reinterpret_cast<char*>(&value), sizeof(value));
+    if(result) { err = SSocks::Utility::Platform::lastError(); }
+  }
+}
+
+SSocks::SocketOptions SSocks::SocketOptions::lowLatency() {
+  SocketOptions opts;
+  opts.noDelay = true;
+  opts.quickAck = true;
+  //busyPoll is left out, since raising it needs CAP_NET_ADMIN; set it by hand where allowed
+  return opts;
+}
+
+SSocks::SocketOptions SSocks::SocketOptions::bulkThroughput() {
+  const int BULK_BUFFER = 4 * 1024 * 1024;
+  SocketOptions opts;
+  opts.noDelay = false;
+  opts.sendBuffer = BULK_BUFFER;
+  opts.recvBuffer = BULK_BUFFER;
+  opts.keepAlive = true;
+  return opts;
+}
+
+void SSocks::SocketOptions::apply(int sock, bool tcp) const {
+  int err = tryApply(sock, tcp);
+  if(err) { throw std::runtime_error(Utility::lastErrStr(err)); }
+}
+
+int SSocks::SocketOptions::tryApply(int sock, bool tcp) const {
+  int err = 0;
+  //options common to every socket
+  if(sendBuffer) { setInt(err, sock, SOL_SOCKET, SO_SNDBUF, *sendBuffer); }
+  if(recvBuffer) { setInt(err, sock, SOL_SOCKET, SO_RCVBUF, *recvBuffer); }
+  if(tos) {
+    //IPv6 calls it the traffic class
+    sockaddr_storage self = {};
+    Utility::Platform::AddrLen len = sizeof(self);
+    bool v6 = getsockname(sock, reinterpret_cast<sockaddr*>(&self), &len) == 0 && self.ss_family == AF_INET6;
+    if(v6) {
+      #ifdef IPV6_TCLASS
+      setInt(err, sock, IPPROTO_IPV6, IPV6_TCLASS, *tos);
+      #endif
+    }
+    else { setInt(err, sock, IPPROTO_IP, IP_TOS, *tos); }
+  }
+  #ifdef SO_BUSY_POLL
+  if(busyPoll)   { setInt(err, sock, SOL_SOCKET, SO_BUSY_POLL, *busyPoll); }
+  #endif
+
+  if(!tcp) { return err; }
+
+  //TCP options
+  if(noDelay)   { setInt(err, sock, IPPROTO_TCP, TCP_NODELAY, *noDelay); }
+  if(keepAlive) { setInt(err, sock, SOL_SOCKET, SO_KEEPALIVE, *keepAlive); }
+  #ifdef TCP_KEEPIDLE
+  if(keepAliveIdle)     { setInt(err, sock, IPPROTO_TCP, TCP_KEEPIDLE, *keepAliveIdle); }
+  #endif
+  #ifdef TCP_KEEPINTVL
+  if(keepAliveInterval) { setInt(err, sock, IPPROTO_TCP, TCP_KEEPINTVL, *keepAliveInterval); }
+  #endif
+  #ifdef TCP_KEEPCNT
+  if(keepAliveCount)    { setInt(err, sock, IPPROTO_TCP, TCP_KEEPCNT, *keepAliveCount); }
+  #endif
+  #ifdef TCP_QUICKACK
+  if(quickAck)    { setInt(err, sock, IPPROTO_TCP, TCP_QUICKACK, *quickAck); }
+  #endif
+  #ifdef TCP_USER_TIMEOUT
+  if(userTimeout) { setInt(err, sock, IPPROTO_TCP, TCP_USER_TIMEOUT, *userTimeout); }
+  #endif
+
+  return err;
+}
@@ -0,0 +1,68 @@
+/** @file */
+#pragma once
+#include <optional>
+
+namespace SSocks {
+
+  /**
+   * A set of tuning options for TCPSocket, TCPServer and UDPSocket.
+   * Only the options that have been given a value are applied; everything else keeps the
+   * system default. Each socket class remembers its options and applies them whenever it
+   * connects, starts or opens. Options given to a TCPServer are also applied to every
+   * connection it accepts (including through EventLoop, ShardedServer and IOUring), so a
+   * whole server can be tuned in one place.\n
+   * Options that only make sense for TCP are ignored by UDPSocket. Options the platform
+   * doesn't have (marked below) are skipped rather than treated as errors, so that the same
+   * profile can be used everywhere. A failure to set an option the platform does have throws.
+   */
+  struct SocketOptions {
+    //! Send small writes immediately rather than waiting to coalesce them (TCP_NODELAY). TCP only.
+    std::optional<bool> noDelay;
+    //! Acknowledge incoming data immediately rather than delaying acks (TCP_QUICKACK). TCP only; Linux only.
+    //! The kernel may drop back to delayed acks by itself, so this is best reapplied from time to time.
+    std::optional<bool> quickAck;
+    //! Probe idle connections so that dead peers are noticed (SO_KEEPALIVE). TCP only.
+    std::optional<bool> keepAlive;
+    //! Seconds of idleness before the first keepalive probe (TCP_KEEPIDLE). TCP only.
+    std::optional<int> keepAliveIdle;
+    //! Seconds between keepalive probes (TCP_KEEPINTVL). TCP only.
+    std::optional<int> keepAliveInterval;
+    //! Unanswered probes before the connection is dropped (TCP_KEEPCNT). TCP only.
+    std::optional<int> keepAliveCount;
+    //! Milliseconds that sent data may go unacknowledged before the connection is dropped (TCP_USER_TIMEOUT). TCP only; Linux only.
+    std::optional<int> userTimeout;
+    //! Size of the kernel send buffer in bytes (SO_SNDBUF). Set it before connecting for it to affect window scaling.
+    std::optional<int> sendBuffer;
+    //! Size of the kernel receive buffer in bytes (SO_RCVBUF). Set it before connecting for it to affect window scaling.
+    std::optional<int> recvBuffer;
+    //! Microseconds to busy-poll the device queue on a blocking read (SO_BUSY_POLL). Linux only.
+    std::optional<int> busyPoll;
+    //! The type-of-service / DSCP byte (IP_TOS, or IPV6_TCLASS on an IPv6 socket).
+    std::optional<int> tos;
+
+    /**
+     * A profile for request/response traffic where every microsecond counts.
+     * Small writes go out at once and acks aren't delayed. Consider adding busyPoll (which
+     * usually needs privileges) on hosts that allow it.
+     */
+    static SocketOptions lowLatency();
+
+    /**
+     * A profile for moving a lot of data over long-lived connections.
+     * Writes are coalesced, the kernel buffers are enlarged to 4 MiB and keepalive is on.
+     */
+    static SocketOptions bulkThroughput();
+
+  private:
+    void apply(int sock, bool tcp) const;
+    //apply() without the throw; returns zero, or the error code of the first option that failed
+    int tryApply(int sock, bool tcp) const;
+
+    friend class TCPSocket;
+    friend class TCPServer;
+    friend class UDPSocket;
+    friend class IOUring;
+
+  };
+
+}
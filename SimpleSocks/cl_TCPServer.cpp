@@ -1,15 +1,15 @@
 #include "cl_TCPServer.h"
-#include <WS2tcpip.h>
+#include "ns_Platform.h"
 
 //Set members to default values.
-//SOCKET_ERROR is used here to indicate that the socket is closed
-SSocks::TCPServer::TCPServer() : sock(SOCKET_ERROR), blocking(true) {
+//INVALID_SOCK is used here to indicate that the socket is closed
+SSocks::TCPServer::TCPServer() : sock(Utility::Platform::INVALID_SOCK), blocking(true), metrics(MetricSource::TCP_SERVER) {
   //nothing
 }
 
 //invoke the default constructor and then call start()
-SSocks::TCPServer::TCPServer(uint16_t port, bool forceBind, const std::string& localHostAddr) : TCPServer() {
-  start(port, forceBind, localHostAddr);
+SSocks::TCPServer::TCPServer(uint16_t port, bool forceBind, const std::string& localHostAddr, bool sharePort) : TCPServer() {
+  start(port, forceBind, localHostAddr, sharePort);
 }
 
 //release the socket
@@ -18,54 +18,74 @@ SSocks::TCPServer::~TCPServer() {
 }
 
 //copy values from source and then break its ownership of the socket
-SSocks::TCPServer::TCPServer(TCPServer&& moveFrom) : sock(moveFrom.sock), blocking(moveFrom.blocking) {
+SSocks::TCPServer::TCPServer(TCPServer&& moveFrom) : sock(moveFrom.sock), blocking(moveFrom.blocking), options(moveFrom.options), metrics(moveFrom.metrics) {
   //force source to disown resource so that it won't be released when source destructs
-  moveFrom.sock = SOCKET_ERROR;
+  moveFrom.sock = Utility::Platform::INVALID_SOCK;
 }
 
 void SSocks::TCPServer::operator=(TCPServer&& moveFrom) {
   sock = moveFrom.sock;
   blocking = moveFrom.blocking;
+  options = moveFrom.options;
+  metrics = moveFrom.metrics;
 
-  moveFrom.sock = SOCKET_ERROR;
+  moveFrom.sock = Utility::Platform::INVALID_SOCK;
 }
 
-void SSocks::TCPServer::start(uint16_t port, bool forceBind, const std::string& localHostAddr) {
+void SSocks::TCPServer::start(uint16_t port, bool forceBind, const std::string& localHostAddr, bool sharePort) {
   //halt service if already running
   if(isOpen()) { stop(); }
 
-  //We need a sockaddr_in to bind the server to a port and interface.
-  sockaddr_in sain = {0};
-  sain.sin_family = AF_INET;
-  sain.sin_port = htons(port);
-
   if(port == 0) { throw std::runtime_error("SSocks::TCPSever does not support port zero."); }
 
-  //This shouldn't fail unless the user types in gibberish, but let's be safe.
-  int result = inet_pton(AF_INET, localHostAddr.c_str(), &sain.sin_addr);
-  switch(result) {
-  case 0: throw std::runtime_error("Attempted to start server on interaface with invalid address string.");
-  case -1: throw std::runtime_error(Utility::lastErrStr(WSAGetLastError()));
+  //We need an address to bind the server to a port and interface.
+  HostAddress local;
+  if(!HostAddress::parse(localHostAddr, port, local)) {
+    throw std::runtime_error("Attempted to start server on interaface with invalid address string.");
   }
 
   //TSock helps here because if an exception is thrown it ensures that the socket resource is released.
-  Utility::TSock tsock(SOCK_STREAM, IPPROTO_TCP);
+  Utility::TSock tsock(static_cast<const sockaddr*>(local)->sa_family, SOCK_STREAM, IPPROTO_TCP);
+  int result;
+
+  //An IPv6 listener takes IPv4 connections too (as IPv4-mapped addresses). Some systems
+  //default to IPv6 only, so ask for this explicitly.
+  if(local.getFamily() == HostAddress::Family::IPV6) {
+    int temp = 0;
+    result = setsockopt(tsock, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast<char*>(&temp), sizeof(temp));
+    if(result) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
+  }
 
   //forceBind will allow the bind to take over from an existing bind. See comments in header.
   if(forceBind) {
     //Here's another nasty legacy call...
-    BOOL temp = TRUE;
+    int temp = 1;
     result = setsockopt(tsock, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<char*>(&temp), sizeof(temp));
-    if(result) { throw std::runtime_error(Utility::lastErrStr(WSAGetLastError())); }
+    if(result) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
+  }
+
+  //sharePort lets several servers listen on the same port, with the kernel balancing between them
+  if(sharePort) {
+    #ifdef SO_REUSEPORT
+    int temp = 1;
+    result = setsockopt(tsock, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<char*>(&temp), sizeof(temp));
+    if(result) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
+    #else
+    throw std::runtime_error("Port sharing (SO_REUSEPORT) is not supported on this platform.");
+    #endif
   }
 
+  //Accepted connections inherit the listener's buffer sizes, which is the only way for them to
+  //affect the window scale offered in the handshake. The TCP options are set per connection.
+  options.apply(tsock, false);
+
   //bind the socket
-  result = bind(tsock, reinterpret_cast<sockaddr*>(&sain), sizeof(sain));
-  if(result) { throw std::runtime_error(Utility::lastErrStr(WSAGetLastError())); }
+  result = bind(tsock, local, local.size());
+  if(result) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
 
   //start listening for connections
   result = listen(tsock, SOMAXCONN);
-  if(result) { throw std::runtime_error(Utility::lastErrStr(WSAGetLastError())); }
+  if(result) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
 
   //everything seems okay, so take ownership of the resource
   sock = tsock.validate();
@@ -73,33 +93,73 @@ void SSocks::TCPServer::start(uint16_t port, bool forceBind, const std::string&
 
 void SSocks::TCPServer::stop() {
   //release the resource if it exists
-  if(isOpen()) { closesocket(sock); }
+  if(isOpen()) { Utility::Platform::closeSocket(sock); }
 
   //and reset to defaults
-  sock = SOCKET_ERROR;
+  sock = Utility::Platform::INVALID_SOCK;
   blocking = true;
 }
 
 SSocks::TCPSocket SSocks::TCPServer::accept() {
+  int err;
+  TCPSocket nuSock = acceptSock(err);
+
+  //EWOULDBLOCK happens on a non-blocking socket when there's no incoming connection.
+  //We can just return the unconnected socket to indicate that. (It will simply be an unopened TCPSocket.)
+  if(err && !Utility::Platform::wouldBlock(err)) { throw std::runtime_error(Utility::lastErrStr(err)); }
+
+  return nuSock;
+}
+
+SSocks::TCPSocket SSocks::TCPServer::acceptPending() {
+  int err;
+  TCPSocket nuSock = acceptSock(err);
+
+  //a connection that died in the backlog isn't the listener's failure, so it's as if none had come yet
+  if(err && !Utility::Platform::wouldBlock(err) && !Utility::Platform::acceptAborted(err)) {
+    throw std::runtime_error(Utility::lastErrStr(err));
+  }
+
+  return nuSock;
+}
+
+SSocks::TCPSocket SSocks::TCPServer::acceptSock(int& err) {
   if(!isOpen()) { throw std::runtime_error("Attemtped to wait for connections on closed TCPServer."); }
 
   //Create a TCPSocket object
   TCPSocket nuSock;
 
   //and inject the incoming connection into it
-  nuSock.sock = ::accept(sock, nullptr, nullptr);
-  if(nuSock.sock == SOCKET_ERROR) {
-    //WSAEWOULDBLOCK happens on a non-blocking socket when there's no incoming connection.
-    //We can just return the unconnected socket to indicate that. (It will simply be an unopened TCPSocket.)
-    int err = WSAGetLastError();
-    if(err != WSAEWOULDBLOCK) { throw std::runtime_error(Utility::lastErrStr(err)); }
+  nuSock.sock = Utility::Platform::acceptSocket(sock, nullptr, nullptr);
+  if(nuSock.sock == Utility::Platform::INVALID_SOCK) {
+    err = Utility::Platform::lastError();
+    if(Utility::Platform::wouldBlock(err)) { metrics.wouldBlock(); }
+    else { metrics.failed(); }
+    return nuSock;
   }
+  err = 0;
+  metrics.accepted();
+
+  //pass the server's options on to the connection
+  nuSock.setOptions(options);
 
   return nuSock;
 }
 
+void SSocks::TCPServer::setOptions(const SocketOptions& options) {
+  this->options = options;
+}
+
+const SSocks::SocketOptions& SSocks::TCPServer::getOptions() const {
+  return options;
+}
+
+SSocks::MetricsSnapshot SSocks::TCPServer::getMetrics() const {
+  return metrics.snapshot();
+}
+
 bool SSocks::TCPServer::isOpen() const {
-  return sock != SOCKET_ERROR;
+  return sock != Utility::Platform::INVALID_SOCK;
 }
 
 bool SSocks::TCPServer::isBlocking() const {
@@ -112,14 +172,10 @@ void SSocks::TCPServer::setBlocking(bool block) {
   //avoid needless system calls
   if(block == blocking) { return; }
 
-  //I really hate all this legacy crap that tries to make one function do everything.
-  //It makes the interfaces really unpleasant.
-  unsigned long temp = block ? 0 : 1;
   //set actual socket behavior according to state info
-  int result = ioctlsocket(sock, FIONBIO, &temp);
-  if(result == SOCKET_ERROR) {
+  if(!Utility::Platform::setBlocking(sock, block)) {
     stop(); //assume socket is invalidated
-    throw std::runtime_error(Utility::lastErrStr(WSAGetLastError()));
+    throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError()));
   }
 
   //update state info
@@ -1,9 +1,13 @@
 #pragma once
 #include <string>
 #include "ns_Utility.h"
+#include "fn_select.h"
 #include "cl_TCPSocket.h"
 
 namespace SSocks {
+  //forward declaration
+  namespace Utility { struct AsyncAccept; }
+
   //! Class representing a bound TCP socket that listens for incoming TCP connections.
   class TCPServer {
   public:
@@ -15,9 +19,10 @@ namespace SSocks {
      * @param port The port to listen on.
      * @param forceBind Whether to force the bind even if the indicated port appears to be in use.
      * @param localHostAddr Address of local interface to listen on.
+     * @param sharePort Whether other servers may listen on the same port at the same time.
      * @see start()
      */
-    TCPServer(uint16_t port, bool forceBind = false, const std::string& localHostAddr = "0.0.0.0");
+    TCPServer(uint16_t port, bool forceBind = false, const std::string& localHostAddr = "0.0.0.0", bool sharePort = false);
 
     //! Copying is prohibited, as sockets are unique resources.
     TCPServer(const TCPServer&) = delete;
@@ -46,9 +51,14 @@ namespace SSocks {
      * @param forceBind Whether to force the bind even if the indicated port appears to be in use.
      * This option is present because a bound port takes a certain amount of time to become free again after being released. In general it should not be necessary to use it.
      * @param localHostAddr Address of local interface to listen on.
-     * This must be an IPv4 address in dot-quad notation, such as "127.0.0.1". The default address of "0.0.0.0" will listen on all available interfaces.
+     * This must be an IPv4 or IPv6 address, such as "127.0.0.1" or "::1". The default address of "0.0.0.0" will listen on all available IPv4 interfaces.
+     * "::" listens on every interface for both IPv6 and IPv4 connections, the latter appearing as IPv4-mapped addresses.
+     * @param sharePort Whether other servers may listen on the same port at the same time (SO_REUSEPORT).
+     * Every server sharing the port must set this. The kernel then spreads incoming connections across
+     * them, which lets several threads each accept from their own server. Not available on Windows.
+     * @see ShardedServer
      */
-    void start(uint16_t port, bool forceBind = false, const std::string& localHostAddr = "0.0.0.0");
+    void start(uint16_t port, bool forceBind = false, const std::string& localHostAddr = "0.0.0.0", bool sharePort = false);
 
     /**
      * Stop listening and release the socket.
@@ -68,6 +78,24 @@ namespace SSocks {
      */
     TCPSocket accept();
 
+    /**
+     * Set the tuning options for connections accepted by this server.
+     * Every accepted connection gets them (and keeps them in its getOptions()). The buffer sizes
+     * are also applied to the listening socket whenever the server starts, so that they're in
+     * place before the handshake. Options given to a running server apply to the next connection.
+     * @param options The options to use.
+     */
+    void setOptions(const SocketOptions& options);
+
+    //! Return the tuning options for accepted connections.
+    const SocketOptions& getOptions() const;
+
+    /**
+     * Return this socket's I/O counters: bytes, system calls, partial sends, would-block
+     * returns and errors, since the object was created. @see MetricsRegistry for the totals.
+     */
+    MetricsSnapshot getMetrics() const;
+
     /**
      * Indicates whether the server is bound to a port and listening for connections.
      * @return true if the server is listening; false if it is not.
@@ -91,12 +119,21 @@ namespace SSocks {
     void setBlocking(bool block);
 
   private:
-    SSocks::Utility::Winsock wsa;
-
     int sock;
     bool blocking;
+    SocketOptions options;
+    SocketMetrics metrics;
+
+    //accept() without the throw; 'err' is zero on success or the code accept() failed with
+    TCPSocket acceptSock(int& err);
+    //accept() that also returns an unopened socket when the connection was aborted in the backlog
+    TCPSocket acceptPending();
 
     template<class T> friend std::vector<T*> select(const std::vector<T*>& sockets, float timeoutSeconds);
+    friend class Poller;
+    friend class IOUring;
+    friend class EventLoop;
+    friend struct Utility::AsyncAccept;
 
   };
 
@@ -1,8 +1,19 @@
 #include "cl_TCPSocket.h"
-#include <WS2tcpip.h>
+#include "ns_Platform.h"
+#include <algorithm>
+#include <system_error>
+#include <cerrno>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 //Set default values
-SSocks::TCPSocket::TCPSocket() : sock(SOCKET_ERROR), blocking(true) {
+SSocks::TCPSocket::TCPSocket() : sock(Utility::Platform::INVALID_SOCK), blocking(true), zeroCopyThreshold(0), zeroCopySent(0), zeroCopyDone(0), metrics(MetricSource::TCP_SOCKET) {
   //nothing
 }
 
@@ -11,24 +22,37 @@ SSocks::TCPSocket::TCPSocket(const HostAddress& host) : TCPSocket() {
   connect(host);
 }
 
+//invoke default constructor, set the options and then call connect()
+SSocks::TCPSocket::TCPSocket(const HostAddress& host, const SocketOptions& options) : TCPSocket() {
+  this->options = options;
+  connect(host);
+}
+
 //close the socket
 SSocks::TCPSocket::~TCPSocket() {
   close();
 }
 
 //copy values from the other object and then break its ownership of the socket
-SSocks::TCPSocket::TCPSocket(TCPSocket&& moveFrom) : sock(moveFrom.sock), blocking(moveFrom.blocking) {
+SSocks::TCPSocket::TCPSocket(TCPSocket&& moveFrom) :
+  sock(moveFrom.sock), blocking(moveFrom.blocking), zeroCopyThreshold(moveFrom.zeroCopyThreshold),
+  zeroCopySent(moveFrom.zeroCopySent), zeroCopyDone(moveFrom.zeroCopyDone), options(moveFrom.options), metrics(moveFrom.metrics) {
   //remove ownership from source so the resource won't be released when the source destructs
-  moveFrom.sock = SOCKET_ERROR;
+  moveFrom.sock = Utility::Platform::INVALID_SOCK;
 }
 
 //copy values from the other object and then break its ownership of the socket
 void SSocks::TCPSocket::operator=(TCPSocket&& moveFrom) {
   sock = moveFrom.sock;
   blocking = moveFrom.blocking;
+  zeroCopyThreshold = moveFrom.zeroCopyThreshold;
+  zeroCopySent = moveFrom.zeroCopySent;
+  zeroCopyDone = moveFrom.zeroCopyDone;
+  options = moveFrom.options;
+  metrics = moveFrom.metrics;
 
   //remove ownership from source so the resource won't be released when the source destructs
-  moveFrom.sock = SOCKET_ERROR;
+  moveFrom.sock = Utility::Platform::INVALID_SOCK;
 }
 
 void SSocks::TCPSocket::connect(const HostAddress& host) {
@@ -36,23 +60,204 @@ void SSocks::TCPSocket::connect(const HostAddress& host) {
   if(isOpen()) { close(); }
 
   //Using TSock here will ensure that the socket is released even if the funciton doesn't succeed
-  Utility::TSock tsock(SOCK_STREAM, IPPROTO_TCP);
+  Utility::TSock tsock(static_cast<const sockaddr*>(host)->sa_family, SOCK_STREAM, IPPROTO_TCP);
+
+  //apply options before connecting, so that buffer sizes can affect window scaling
+  options.apply(tsock, true);
 
   //try to connect to 'host'
   int err = ::connect(tsock, host, host.size());
-  if(err) { throw std::runtime_error(Utility::lastErrStr(WSAGetLastError())); }
+  if(err) {
+    metrics.failed();
+    throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError()));
+  }
 
   //everything looks okay, so take ownership of the resource and return
   sock = tsock.validate();
+  metrics.connected();
+}
+
+void SSocks::TCPSocket::connect(const HostAddress& host, float timeoutSeconds) {
+  connectAny(std::vector<HostAddress>(1, host), timeoutSeconds, 0);
+}
+
+bool SSocks::TCPSocket::beginConnect(const HostAddress& host) {
+  //discard any existing connection and reset state
+  if(isOpen()) { close(); }
+
+  Utility::TSock tsock(static_cast<const sockaddr*>(host)->sa_family, SOCK_STREAM, IPPROTO_TCP);
+  options.apply(tsock, true);
+  if(!Utility::Platform::setBlocking(tsock, false)) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
+
+  bool connected = ::connect(tsock, host, host.size()) == 0;
+  if(!connected) {
+    int err = Utility::Platform::lastError();
+    if(!Utility::Platform::connectPending(err)) {
+      metrics.failed();
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+  }
+  else { metrics.connected(); }
+
+  sock = tsock.validate();
+  blocking = false;
+  return connected;
+}
+
+void SSocks::TCPSocket::finishConnect() {
+  if(!isOpen()) { throw std::runtime_error("Attempted to finish connecting a closed TCPSocket."); }
+
+  int err = Utility::Platform::connectResult(sock);
+  if(err) {
+    metrics.failed();
+    close();
+    throw std::runtime_error(Utility::lastErrStr(err));
+  }
+  metrics.connected();
+}
+
+namespace {
+  //Closes the sockets of connection attempts that were abandoned, however connectAny() exits.
+  struct PendingConnects {
+    std::vector<pollfd> fds;
+    std::vector<size_t> hostIndex;
+
+    ~PendingConnects() {
+      for(pollfd& pfd : fds) { SSocks::Utility::Platform::closeSocket(pfd.fd); }
+    }
+
+    int take(size_t i) {
+      int sock = fds[i].fd;
+      fds.erase(fds.begin() + i);
+      hostIndex.erase(hostIndex.begin() + i);
+      return sock;
+    }
+  };
+}
+
+size_t SSocks::TCPSocket::connectAny(const std::vector<HostAddress>& hosts, float timeoutSeconds, float staggerSeconds) {
+  //discard any existing connection and reset state
+  if(isOpen()) { close(); }
+  if(hosts.empty()) { throw std::runtime_error("Attempted to connect with no addresses."); }
+
+  typedef std::chrono::steady_clock Clock;
+  auto toDuration = [](float seconds) { return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(seconds)); };
+  Clock::time_point start = Clock::now();
+  Clock::time_point deadline = start + toDuration(std::max(timeoutSeconds, 0.0f));
+  Clock::time_point nextStart = start;
+
+  PendingConnects pending;
+  pending.fds.reserve(hosts.size());
+  pending.hostIndex.reserve(hosts.size());
+
+  size_t next = 0;
+  int lastErr = 0;
+  int winner = Utility::Platform::INVALID_SOCK;
+  size_t winnerIndex = 0;
+
+  while(winner == Utility::Platform::INVALID_SOCK) {
+    Clock::time_point now = Clock::now();
+    if(timeoutSeconds >= 0 && now >= deadline) { throw std::runtime_error("Connection attempt timed out."); }
+
+    //start the next attempt if it's due, or at once if nothing else is in flight
+    if(next < hosts.size() && (pending.fds.empty() || now >= nextStart)) {
+      size_t index = next++;
+      nextStart = now + toDuration(staggerSeconds);
+
+      Utility::TSock tsock(static_cast<const sockaddr*>(hosts[index])->sa_family, SOCK_STREAM, IPPROTO_TCP);
+      options.apply(tsock, true);
+      if(!Utility::Platform::setBlocking(tsock, false)) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
+
+      if(::connect(tsock, hosts[index], hosts[index].size()) == 0) {
+        //this can happen at once, as with a local host
+        winner = tsock.validate();
+        winnerIndex = index;
+        break;
+      }
+
+      int err = Utility::Platform::lastError();
+      if(Utility::Platform::connectPending(err)) {
+        pollfd pfd = { 0 };
+        pfd.fd = tsock.validate();
+        pfd.events = POLLOUT;
+        pending.fds.push_back(pfd);
+        pending.hostIndex.push_back(index);
+      }
+      else { lastErr = err; } //TSock closes the failed socket
+      continue;
+    }
+
+    //everything has been tried and nothing is left in flight
+    if(pending.fds.empty()) { throw std::runtime_error(Utility::lastErrStr(lastErr)); }
+
+    //wait until an attempt finishes, the next is due to start, or time runs out
+    Clock::time_point wakeAt = Clock::time_point::max();
+    if(next < hosts.size()) { wakeAt = nextStart; }
+    if(timeoutSeconds >= 0) { wakeAt = std::min(wakeAt, deadline); }
+    int timeoutMs = -1;
+    if(wakeAt != Clock::time_point::max()) {
+      std::chrono::duration<float> left = wakeAt - now;
+      timeoutMs = static_cast<int>(std::ceil(std::max(left.count(), 0.0f) * 1000.0f));
+    }
+
+    if(Utility::Platform::poll(pending.fds.data(), pending.fds.size(), timeoutMs) == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      if(Utility::Platform::interrupted(err)) { continue; }
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+
+    for(size_t i = 0; i < pending.fds.size();) {
+      if(pending.fds[i].revents == 0) { i++; continue; }
+
+      int err = Utility::Platform::connectResult(pending.fds[i].fd);
+      if(err == 0) {
+        winnerIndex = pending.hostIndex[i];
+        winner = pending.take(i);
+        break;
+      }
+
+      //this one failed, so don't keep the next one waiting for its turn
+      Utility::Platform::closeSocket(pending.take(i));
+      lastErr = err;
+      nextStart = Clock::now();
+    }
+  }
+
+  //the remaining attempts are closed as 'pending' goes out of scope
+  if(!Utility::Platform::setBlocking(winner, true)) {
+    int err = Utility::Platform::lastError();
+    Utility::Platform::closeSocket(winner);
+    throw std::runtime_error(Utility::lastErrStr(err));
+  }
+
+  sock = winner;
+  metrics.connected();
+  return winnerIndex;
+}
+
+void SSocks::TCPSocket::setOptions(const SocketOptions& options) {
+  if(isOpen()) { options.apply(sock, true); }
+  this->options = options;
+}
+
+const SSocks::SocketOptions& SSocks::TCPSocket::getOptions() const {
+  return options;
+}
+
+SSocks::MetricsSnapshot SSocks::TCPSocket::getMetrics() const {
+  return metrics.snapshot();
 }
 
 void SSocks::TCPSocket::close() {
   //release the resource if it exists
-  if(isOpen()) { closesocket(sock); }
+  if(isOpen()) { Utility::Platform::closeSocket(sock); }
 
   //and reset to defaults
-  sock = SOCKET_ERROR;
+  sock = Utility::Platform::INVALID_SOCK;
   blocking = true;
+  zeroCopyThreshold = 0;
+  zeroCopySent = 0;
+  zeroCopyDone = 0;
 }
 
 size_t SSocks::TCPSocket::send(const void* data, size_t len) {
@@ -72,15 +277,21 @@ size_t SSocks::TCPSocket::send(const void* data, size_t len) {
   //the documentation is written on MSDN I've added it just in case.
   do {
     //send the data
-    int sent = ::send(sock, datap, len, 0);
-    if(sent == SOCKET_ERROR) {
+    int sent = ::send(sock, datap, len, Utility::Platform::SEND_FLAGS);
+    if(sent == Utility::Platform::SOCK_ERROR) {
       //EWOULDBLOCK indicates that we're non-blocking and the outbound buffer
       //is full, so just return and indicate that no bytes were sent
-      if(WSAGetLastError() == EWOULDBLOCK) { return 0; }
+      int err = Utility::Platform::lastError();
+      if(Utility::Platform::wouldBlock(err)) {
+        metrics.wouldBlock();
+        return totalSent;
+      }
       //for all other errors...
+      metrics.failed();
       close(); //close the socket (assume it's now invalid ) and throw
-      throw std::runtime_error(Utility::lastErrStr(WSAGetLastError()));
+      throw std::runtime_error(Utility::lastErrStr(err));
     }
+    metrics.sent(sent, len);
     
     totalSent += sent; //update return value
     len -= sent; //adjust length remaining
@@ -92,19 +303,438 @@ size_t SSocks::TCPSocket::send(const void* data, size_t len) {
 
 //overloads for send()
 size_t SSocks::TCPSocket::send(const std::string& data)      { return send(data.data(), data.size()); }
-size_t SSocks::TCPSocket::send(const std::vector<char> data) { return send(data.data(), data.size()); }
+size_t SSocks::TCPSocket::send(const std::vector<char>& data) { return send(data.data(), data.size()); }
+
+size_t SSocks::TCPSocket::sendAll(const void* data, size_t len) {
+  const char* datap = reinterpret_cast<const char*>(data);
+  size_t totalSent = 0;
+
+  //A blocking send() already sends everything. A non-blocking one stops when the outbound
+  //buffer fills, so wait until it drains a little and carry on from there.
+  while(true) {
+    totalSent += send(datap + totalSent, len - totalSent);
+    if(totalSent == len) { break; }
+
+    pollfd pfd = { 0 };
+    pfd.fd = sock;
+    pfd.events = POLLOUT;
+    if(Utility::Platform::poll(&pfd, 1, -1) == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      if(Utility::Platform::interrupted(err)) { continue; }
+      close(); //assume the socket is invalidated and throw
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+  }
+
+  return totalSent;
+}
+
+size_t SSocks::TCPSocket::sendAll(std::string_view data) { return sendAll(data.data(), data.size()); }
+
+namespace {
+  //Step past 'amount' bytes of a buffer array, where 'skip' bytes of the first buffer are
+  //already done. Empty buffers are stepped over too, so that on return either 'count' is zero
+  //or the first buffer has something left in it.
+  template<class Buffer>
+  void advance(const Buffer*& buffers, size_t& count, size_t& skip, size_t amount) {
+    skip += amount;
+    while(count && skip >= buffers->size) {
+      skip -= buffers->size;
+      buffers++;
+      count--;
+    }
+  }
+}
+
+size_t SSocks::TCPSocket::sendv(const ConstBuffer* buffers, size_t count) {
+  if(!isOpen()) { throw std::runtime_error("Attempted send on closed TCPSocket."); }
+
+  size_t totalSent = 0;
+  size_t skip = 0;
+  advance(buffers, count, skip, 0);
+
+  //the total is only needed to tell partial sends apart
+  size_t totalLen = 0;
+  for(size_t i = 0; i < count; i++) { totalLen += buffers[i].size; }
+
+  //just as in send(), keep going while blocking and make one attempt otherwise
+  while(count) {
+    std::ptrdiff_t sent = Utility::Platform::sendv(sock, buffers, count, skip);
+    if(sent == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      if(Utility::Platform::wouldBlock(err)) {
+        metrics.wouldBlock();
+        break;
+      }
+      metrics.failed();
+      close(); //assume the socket is invalidated and throw
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+    metrics.sent(sent, totalLen - totalSent);
+
+    totalSent += sent;
+    advance(buffers, count, skip, sent);
+    if(!blocking) { break; }
+  }
+
+  return totalSent;
+}
+
+size_t SSocks::TCPSocket::sendv(std::initializer_list<ConstBuffer> buffers) {
+  return sendv(buffers.begin(), buffers.size());
+}
+
+size_t SSocks::TCPSocket::recvv(const MutableBuffer* buffers, size_t count) {
+  if(!isOpen()) { throw std::runtime_error("Attempted recv on closed TCPSocket."); }
+
+  size_t totalRead = 0;
+  size_t skip = 0;
+  advance(buffers, count, skip, 0);
+
+  while(count) {
+    std::ptrdiff_t got = Utility::Platform::recvv(sock, buffers, count, skip);
+    if(got == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      if(Utility::Platform::wouldBlock(err)) {
+        metrics.wouldBlock();
+        break;
+      }
+      metrics.failed();
+      close(); //assume the socket is invalidated and throw
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+    metrics.received(got);
+
+    //zero means that the remote host closed the connection
+    if(got == 0) { close(); break; }
+
+    totalRead += got;
+    advance(buffers, count, skip, got);
+    if(!blocking) { break; }
+  }
+
+  return totalRead;
+}
+
+size_t SSocks::TCPSocket::recvv(std::initializer_list<MutableBuffer> buffers) {
+  return recvv(buffers.begin(), buffers.size());
+}
+
+namespace {
+  //File errors are C library errno values on every platform, not socket errors.
+  std::runtime_error fileError(const std::string& what) {
+    return std::runtime_error(what + std::generic_category().message(errno));
+  }
+
+  //closes a file opened by sendFile(path) however the call ends
+  struct FileCloser {
+    int fd;
+    ~FileCloser() { SSocks::Utility::Platform::closeFile(fd); }
+  };
+}
+
+size_t SSocks::TCPSocket::sendFile(int fd, uint64_t offset, size_t length) {
+  if(!isOpen()) { throw std::runtime_error("Attempted sendFile on closed TCPSocket."); }
+
+  //zero length means "the rest of the file"
+  if(length == 0) {
+    int64_t size = Utility::Platform::fileSize(fd);
+    if(size < 0) { throw fileError("Could not find size of file for sendFile(): "); }
+    if(static_cast<uint64_t>(size) <= offset) { return 0; }
+    length = static_cast<size_t>(size - offset);
+  }
+
+  size_t totalSent = 0;
+  while(totalSent < length) {
+    std::ptrdiff_t sent = Utility::Platform::sendFile(sock, fd, offset + totalSent, length - totalSent);
+
+    //the kernel can't do this one, so copy the rest by hand
+    if(sent == Utility::Platform::NO_SENDFILE) {
+      return totalSent + copyFile(fd, offset + totalSent, length - totalSent);
+    }
+
+    if(sent == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      if(Utility::Platform::wouldBlock(err)) {
+        metrics.wouldBlock();
+        break;
+      }
+      metrics.failed();
+      close(); //assume the socket is invalidated and throw
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+    metrics.sent(sent, length - totalSent);
+
+    //the file ended before 'length' bytes
+    if(sent == 0) { break; }
+
+    totalSent += sent;
+
+    //just as in send(), keep going while blocking and make one attempt otherwise
+    if(!blocking) { break; }
+  }
+
+  return totalSent;
+}
 
+size_t SSocks::TCPSocket::sendFile(const std::string& path, uint64_t offset, size_t length) {
+  if(!isOpen()) { throw std::runtime_error("Attempted sendFile on closed TCPSocket."); }
+
+  int fd = Utility::Platform::openFile(path);
+  if(fd == -1) { throw fileError("Could not open '" + path + "' for sendFile(): "); }
+  FileCloser closer{fd};
+
+  return sendFile(fd, offset, length);
+}
+
+size_t SSocks::TCPSocket::copyFile(int fd, uint64_t offset, size_t length) {
+  const size_t COPY_BLOCK = 64 * 1024;
+  std::vector<char> buffer(std::min(length, COPY_BLOCK));
+
+  size_t totalSent = 0;
+  while(totalSent < length) {
+    size_t want = std::min(buffer.size(), length - totalSent);
+    std::ptrdiff_t got = Utility::Platform::readFile(fd, buffer.data(), want, offset + totalSent);
+    if(got < 0) { throw fileError("Could not read file for sendFile(): "); }
+    if(got == 0) { break; } //the file ended before 'length' bytes
+
+    //A blocking send() takes the whole block. A non-blocking one may not, but what it leaves
+    //is simply read again next time, since the caller resumes from the offset.
+    size_t sent = send(buffer.data(), got);
+    totalSent += sent;
+    if(sent < static_cast<size_t>(got) || !blocking) { break; }
+  }
+
+  return totalSent;
+}
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+
+bool SSocks::TCPSocket::enableZeroCopy(size_t threshold) {
+  if(!isOpen()) { throw std::runtime_error("Attempted to enable zero-copy on closed TCPSocket."); }
+
+  int temp = 1;
+  if(setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &temp, sizeof(temp))) {
+    //an older kernel just doesn't have it, which leaves us copying as before
+    zeroCopyThreshold = 0;
+    return false;
+  }
+
+  //a threshold of zero would mean "disabled", so the smallest real threshold is one byte
+  zeroCopyThreshold = std::max<size_t>(threshold, 1);
+  return true;
+}
+
+size_t SSocks::TCPSocket::sendZeroCopy(const void* data, size_t len, uint64_t& token) {
+  token = 0;
+  if(zeroCopyThreshold == 0 || len < zeroCopyThreshold) { return send(data, len); }
+  if(!isOpen()) { throw std::runtime_error("Attempted send on closed TCPSocket."); }
+
+  const char* datap = reinterpret_cast<const char*>(data);
+  size_t totalSent = 0;
+
+  //the same loop as send(), but every successful call consumes one completion id
+  do {
+    ssize_t sent = ::send(sock, datap + totalSent, len - totalSent, Utility::Platform::SEND_FLAGS | MSG_ZEROCOPY);
+    if(sent == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      if(Utility::Platform::wouldBlock(err)) {
+        metrics.wouldBlock();
+        break;
+      }
+      //ENOBUFS means we've hit the limit on pinned memory, so copy this part instead
+      if(err == ENOBUFS) { totalSent += send(datap + totalSent, len - totalSent); break; }
+      metrics.failed();
+      close(); //assume the socket is invalidated and throw
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+    metrics.sent(sent, len - totalSent);
+
+    totalSent += sent;
+    token = ++zeroCopySent;
+  } while(totalSent < len && blocking);
+
+  return totalSent;
+}
+
+size_t SSocks::TCPSocket::reapZeroCopy() {
+  if(!isOpen()) { return 0; }
+
+  size_t notices = 0;
+  while(zeroCopyDone != zeroCopySent) {
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(sock_extended_err))];
+    msghdr msg = {};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    //completion notices arrive on the socket's error queue
+    if(::recvmsg(sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == Utility::Platform::SOCK_ERROR) { break; }
+
+    for(cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+      sock_extended_err ee;
+      std::memcpy(&ee, CMSG_DATA(cm), sizeof(ee));
+      if(ee.ee_errno != 0 || ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY) { continue; }
+
+      //Each notice covers the ids [ee_info, ee_data]. The kernel's ids are 32-bit send counts
+      //starting from zero, so widen the last one to match our 64-bit count of calls issued.
+      uint64_t latest = zeroCopySent - 1;
+      uint64_t last = latest - static_cast<uint32_t>(static_cast<uint32_t>(latest) - ee.ee_data);
+      zeroCopyDone = std::max(zeroCopyDone, last + 1);
+      notices++;
+    }
+  }
+
+  return notices;
+}
+
+#else
+
+//Without zero-copy support everything is copied, so every token is complete immediately.
+
+bool SSocks::TCPSocket::enableZeroCopy(size_t) {
+  if(!isOpen()) { throw std::runtime_error("Attempted to enable zero-copy on closed TCPSocket."); }
+  return false;
+}
+
+size_t SSocks::TCPSocket::sendZeroCopy(const void* data, size_t len, uint64_t& token) {
+  token = 0;
+  return send(data, len);
+}
+
+size_t SSocks::TCPSocket::reapZeroCopy() {
+  return 0;
+}
+
+#endif
+
+bool SSocks::TCPSocket::isZeroCopyDone(uint64_t token) {
+  if(token > zeroCopyDone) { reapZeroCopy(); }
+  return token <= zeroCopyDone;
+}
+
+bool SSocks::TCPSocket::waitZeroCopy(uint64_t token, float timeoutSeconds) {
+  const int MAX_BACKOFF_MS = 50;
+
+  auto start = std::chrono::steady_clock::now();
+  int backoffMs = 0;
+  while(!isZeroCopyDone(token)) {
+    if(!isOpen()) { throw std::runtime_error("TCPSocket closed while waiting for zero-copy completion."); }
+
+    int timeoutMs = -1;
+    if(timeoutSeconds >= 0) {
+      std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+      if(elapsed.count() >= timeoutSeconds) { return false; }
+      timeoutMs = static_cast<int>(std::ceil((timeoutSeconds - elapsed.count()) * 1000.0f));
+    }
+
+    //a pending error queue shows up as POLLERR, which poll() reports without being asked
+    pollfd pfd = { 0 };
+    pfd.fd = sock;
+    if(Utility::Platform::poll(&pfd, 1, timeoutMs) == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      if(Utility::Platform::interrupted(err)) { continue; }
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+
+    //Once the peer hangs up or the connection fails, poll() returns at once on every call
+    //whether or not a notice is waiting. The notices still come as the kernel lets go of the
+    //data, so back off between checks rather than spin.
+    if((pfd.revents & (POLLHUP | POLLERR)) && reapZeroCopy() == 0) {
+      backoffMs = std::min(backoffMs ? backoffMs * 2 : 1, MAX_BACKOFF_MS);
+      int sleepMs = timeoutMs < 0 ? backoffMs : std::min(backoffMs, timeoutMs);
+      std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs));
+    }
+    else { backoffMs = 0; }
+  }
+
+  return true;
+}
+
+//The vector versions are wrappers over the buffer versions. They allocate for the largest
+//possible read and then shrink the vector to match what was actually read.
 std::vector<char> SSocks::TCPSocket::recv(size_t len) {
-  if(blocking) { return fullRecv(len); }
-  else { return singlePassRecv(len, 0); }
+  std::vector<char> data(len);
+  data.resize(recvInto(data.data(), len));
+  return data;
 }
 
 std::vector<char> SSocks::TCPSocket::peek(size_t len) {
-  return singlePassRecv(len, MSG_PEEK);
+  std::vector<char> data(len);
+  data.resize(singlePassRecv(data.data(), len, MSG_PEEK));
+  return data;
+}
+
+size_t SSocks::TCPSocket::recvInto(void* buffer, size_t len) {
+  if(blocking) { return fullRecv(reinterpret_cast<char*>(buffer), len); }
+  else { return singlePassRecv(reinterpret_cast<char*>(buffer), len, 0); }
+}
+
+size_t SSocks::TCPSocket::recvSome(void* buffer, size_t len) {
+  return singlePassRecv(reinterpret_cast<char*>(buffer), len, 0);
+}
+
+size_t SSocks::TCPSocket::send(const void* data, size_t len, Deadline deadline) {
+  if(!isOpen()) { throw std::runtime_error("Attempted send on closed TCPSocket."); }
+
+  const char* datap = reinterpret_cast<const char*>(data);
+  size_t totalSent = 0;
+
+  //Where a single call can be made non-blocking, try before waiting, since there's usually
+  //room in the outbound buffer. Otherwise a blocking socket has to be polled first.
+  bool tryFirst = Utility::Platform::NO_WAIT != 0 || !blocking;
+
+  while(totalSent < len && (tryFirst || Utility::waitReady(sock, true, deadline))) {
+    tryFirst = false;
+
+    int sent = ::send(sock, datap + totalSent, len - totalSent, Utility::Platform::SEND_FLAGS | Utility::Platform::NO_WAIT);
+    if(sent == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      if(Utility::Platform::wouldBlock(err)) {
+        metrics.wouldBlock();
+        continue;
+      }
+      metrics.failed();
+      close(); //assume the socket is invalidated and throw
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+    metrics.sent(sent, len - totalSent);
+
+    totalSent += sent;
+  }
+
+  return totalSent;
+}
+
+std::vector<char> SSocks::TCPSocket::recv(size_t len, Deadline deadline) {
+  std::vector<char> data(len);
+  data.resize(recvInto(data.data(), len, deadline));
+  return data;
+}
+
+size_t SSocks::TCPSocket::recvInto(void* buffer, size_t len, Deadline deadline) {
+  if(!isOpen()) { throw std::runtime_error("Attempted recv on closed TCPSocket."); }
+
+  char* readTo = reinterpret_cast<char*>(buffer);
+  size_t totalRead = 0;
+
+  //as in send(), try before waiting where that can't block
+  bool tryFirst = Utility::Platform::NO_WAIT != 0 || !blocking;
+
+  //each wait gets only what's left of the deadline, however many pieces the data comes in
+  while(totalRead < len && (tryFirst || Utility::waitReady(sock, false, deadline))) {
+    tryFirst = false;
+
+    size_t got = singlePassRecv(readTo + totalRead, len - totalRead, Utility::Platform::NO_WAIT);
+    if(!isOpen()) { break; } //the remote host closed the connection
+
+    totalRead += got;
+  }
+
+  return totalRead;
 }
 
 bool SSocks::TCPSocket::isOpen() const {
-  return sock != SOCKET_ERROR;
+  return sock != Utility::Platform::INVALID_SOCK;
 }
 
 bool SSocks::TCPSocket::isBlocking() const {
@@ -117,14 +747,10 @@ void SSocks::TCPSocket::setBlocking(bool block) {
   //avoid needless system calls
   if(block == blocking) { return; }
 
-  //I really hate all this legacy crap that tries to make one function do everything.
-  //It makes the interfaces really unpleasant.
-  unsigned long temp = block ? 0 : 1;
   //set actual socket behavior according to state info
-  int result = ioctlsocket(sock, FIONBIO, &temp);
-  if(result == SOCKET_ERROR) {
+  if(!Utility::Platform::setBlocking(sock, block)) {
     close();  //assume socket is invalidated
-    throw std::runtime_error(Utility::lastErrStr(WSAGetLastError()));
+    throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError()));
   }
 
   //update state info
@@ -132,71 +758,93 @@ void SSocks::TCPSocket::setBlocking(bool block) {
 
 }
 
-std::vector<char> SSocks::TCPSocket::fullRecv(size_t len) {
+void SSocks::TCPSocket::setNoDelay(bool noDelay) {
+  if(!isOpen()) { throw std::runtime_error("Attempted to set no-delay on closed TCPSocket."); }
+
+  int temp = noDelay ? 1 : 0;
+  int result = setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char*>(&temp), sizeof(temp));
+  if(result) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
+}
+
+void SSocks::TCPSocket::setCork(bool cork) {
+  if(!isOpen()) { throw std::runtime_error("Attempted to set cork on closed TCPSocket."); }
+
+  #if defined(TCP_CORK) || defined(TCP_NOPUSH)
+  #ifdef TCP_CORK
+  const int CORK_OPTION = TCP_CORK;
+  #else
+  const int CORK_OPTION = TCP_NOPUSH;
+  #endif
+  int temp = cork ? 1 : 0;
+  int result = setsockopt(sock, IPPROTO_TCP, CORK_OPTION, reinterpret_cast<char*>(&temp), sizeof(temp));
+  if(result) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
+  #else
+  (void)cork;
+  throw std::runtime_error("Corking (TCP_CORK) is not supported on this platform.");
+  #endif
+}
+
+size_t SSocks::TCPSocket::fullRecv(char* buffer, size_t len) {
   if(!isOpen()) { throw std::runtime_error("Attempted recv on closed TCPSocket."); }
 
-  //allocate buffer to store data
-  std::vector<char> data(len);
-  
   //Need to be able to advance the data pointer in case we have to
   //read more than once. (If we want 20 bytes and we only get 10 the first time
   //then we want to advance the pointer by 10 so the next read continues where
   //the last one left off.)
-  char* readTo = data.data();
+  char* readTo = buffer;
   //and keep track of how much has been read
   size_t totalRead = 0;
 
-  //If blocking and not peeking then read continuously until 'len' bytes or socket closure.
-  //Otherwise (peeking OR non-blocking) read once and just return whatever comes back.
-  do {
+  //read continuously until 'len' bytes or socket closure
+  while(len) {
     //read to pointer position
     int got = ::recv(sock, readTo, len, 0);
+    if(got == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      metrics.failed();
+      close(); //assume the socket is invalidated and throw
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+    metrics.received(got);
+
     //if recv() returns zero it means that the remote host closed the connection
     //so we close the socket and break the loop
     if(got == 0) { close(); break; }
 
-    if(got == SOCKET_ERROR) {
-      close(); //assume the socket is invalidated and throw
-      throw std::runtime_error(Utility::lastErrStr(WSAGetLastError()));
-    }
-
     totalRead += got; //update our counter
     len -= got; //reduce the amount left to read
     readTo += got; //advance the pointer to the next read position
+  }
 
-  } while(len);
-
-  //we may not have filled the whole buffer, so resize it to match what we read
-  data.resize(totalRead);
-
-  return data;
+  return totalRead;
 }
 
-std::vector<char> SSocks::TCPSocket::singlePassRecv(size_t len, int flags) {
+size_t SSocks::TCPSocket::singlePassRecv(char* buffer, size_t len, int flags) {
   if(!isOpen()) { throw std::runtime_error("Attempted recv on closed TCPSocket."); }
 
-  //allocate buffer to store data
-  std::vector<char> data(len);
-
   //read to buffer
-  int got = ::recv(sock, data.data(), data.size(), 0);
+  int got = ::recv(sock, buffer, len, flags);
 
   //if recv() returns zero it means that the remote host closed the connection
-  if(got == 0) { close(); }
-  else if(got == SOCKET_ERROR) {
-    int err = WSAGetLastError();
-    if(err == WSAEWOULDBLOCK) {
-      //blocking socket had no data pending, so just return empty vector
+  //(a zero-length read is not a closure, so don't mistake one for it)
+  if(got == 0) {
+    metrics.received(0);
+    if(len) { close(); }
+  }
+  else if(got == Utility::Platform::SOCK_ERROR) {
+    int err = Utility::Platform::lastError();
+    if(Utility::Platform::wouldBlock(err)) {
+      //blocking socket had no data pending, so just report nothing read
+      metrics.wouldBlock();
       got = 0;
     }
     else {
+      metrics.failed();
       close(); //assume the socket is invalidated and throw
       throw std::runtime_error(Utility::lastErrStr(err));
     }
   }
+  else { metrics.received(got); }
 
-  //we may not have filled the whole buffer, so resize it to match what we read
-  data.resize(got);
-
-  return data;
+  return got;
 }
@@ -1,8 +1,16 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <string_view>
+#include <initializer_list>
+#include <cstdint>
 #include "ns_Utility.h"
+#include "cl_BufferView.h"
+#include "fn_select.h"
 #include "cl_HostAddress.h"
+#include "cl_SocketOptions.h"
+#include "cl_Metrics.h"
+#include "cl_Deadline.h"
 
 namespace SSocks {
 
@@ -18,6 +26,13 @@ namespace SSocks {
      */
     TCPSocket(const HostAddress& host);
 
+    /**
+     * Generate socket with the given options and connect to indicated host.
+     * @param host A HostAddress object indicating the host and port to connect to.
+     * @param options Tuning options, applied before connecting. @see setOptions()
+     */
+    TCPSocket(const HostAddress& host, const SocketOptions& options);
+
     //! Copying is prohibited, as sockets are unique resources.
     TCPSocket(const TCPSocket&) = delete;
 
@@ -45,6 +60,66 @@ namespace SSocks {
      */
     void connect(const HostAddress& host);
 
+    /**
+     * Connect to indicated host, giving up after a time limit.
+     * A plain connect() to a dead host waits for the system's own timeout, which can be tens of
+     * seconds or more. This connects without blocking and waits only as long as requested.
+     * The socket is left in blocking mode either way.
+     * @param host A HostAddress object indicating the host and port to connect to.
+     * @param timeoutSeconds The longest to wait for the connection. SELECT_FOREVER waits as long as the system allows.
+     * @throw std::runtime_error if the connection fails or the time runs out.
+     */
+    void connect(const HostAddress& host, float timeoutSeconds);
+
+    /**
+     * Connect to whichever of several addresses for the same host answers first.
+     * Attempts are started in order, a little apart, and race one another: each new attempt
+     * starts after 'staggerSeconds' or as soon as an earlier one fails, and the first to
+     * succeed is kept while the rest are abandoned. A slow or dead address therefore costs only
+     * the stagger delay rather than a whole connection timeout. ("Happy Eyeballs", RFC 8305.)
+     * Pass it the results of nsLookup(). The socket is left in blocking mode.
+     * @param hosts The addresses to try, in order of preference.
+     * @param timeoutSeconds The longest to wait overall. SELECT_FOREVER waits as long as the system allows.
+     * @param staggerSeconds How long to give each attempt before starting the next alongside it.
+     * @return The index in 'hosts' of the address that was connected to.
+     * @throw std::runtime_error if every attempt fails or the time runs out.
+     */
+    size_t connectAny(const std::vector<HostAddress>& hosts, float timeoutSeconds = SELECT_FOREVER, float staggerSeconds = 0.25f);
+
+    /**
+     * Start connecting to a host without waiting for the connection to finish.
+     * The socket is left in non-blocking mode. If this returns false the connection is still in
+     * progress: wait for the socket to become writable (see EventLoop::waitWritable()), then
+     * call finishConnect() to learn how it went.
+     * @param host A HostAddress object indicating the host and port to connect to.
+     * @return true if the connection was made at once, as it may be with a local host.
+     * @throw std::runtime_error if the attempt fails outright.
+     */
+    bool beginConnect(const HostAddress& host);
+
+    /**
+     * Complete a connection started by beginConnect(), once the socket has become writable.
+     * @throw std::runtime_error if the connection failed, in which case the socket is closed.
+     */
+    void finishConnect();
+
+    /**
+     * Set the tuning options for this socket.
+     * They are applied immediately if the socket is connected, and again whenever it connects.
+     * They are kept across close().
+     * @param options The options to use.
+     */
+    void setOptions(const SocketOptions& options);
+
+    //! Return the tuning options for this socket.
+    const SocketOptions& getOptions() const;
+
+    /**
+     * Return this socket's I/O counters: bytes, system calls, partial sends, would-block
+     * returns and errors, since the object was created. @see MetricsRegistry for the totals.
+     */
+    MetricsSnapshot getMetrics() const;
+
     /**
      * Close the present connection.
      * If no connection exists then no action will be taken.
@@ -78,7 +153,102 @@ namespace SSocks {
     * @param data A vector of char holding the data to send.
     * @return The number of bytes sent.
     */
-    size_t send(const std::vector<char> data);
+    size_t send(const std::vector<char>& data);
+
+    /**
+     * Send all of the data through the socket, whether or not the socket is blocking.
+     * A non-blocking socket waits for room in the outbound buffer as needed, so this always
+     * sends everything unless an error is thrown.
+     * @param data A pointer to the data to be sent.
+     * @param len The number of bytes to send.
+     * @return The number of bytes sent, which is always 'len'.
+     */
+    size_t sendAll(const void* data, size_t len);
+
+    //! @copydoc sendAll(const void*, size_t)
+    size_t sendAll(std::string_view data);
+
+    /**
+     * Send several buffers through the socket as one stream, without joining them first.
+     * This is a single gather-write system call (more than one only if the socket is blocking
+     * and the data doesn't all go at once), so a header and a payload in separate buffers go
+     * out together without being copied and without Nagle splitting them. As with send(), a
+     * blocking socket sends everything, while a non-blocking one makes one attempt.
+     * @param buffers The buffers to send, in order.
+     * @param count The number of buffers.
+     * @return The total number of bytes sent.
+     */
+    size_t sendv(const ConstBuffer* buffers, size_t count);
+
+    //! @copydoc sendv(const ConstBuffer*, size_t)
+    size_t sendv(std::initializer_list<ConstBuffer> buffers);
+
+    /**
+     * Send part of a file through the socket.
+     * Where the kernel supports it (sendfile() on Linux) the data goes straight from the file
+     * to the socket without being copied through user memory. Otherwise the file is read and
+     * sent a block at a time. As with send(), a blocking socket sends everything, while a
+     * non-blocking one makes one attempt and reports how far it got; call again with the
+     * offset advanced by that much to continue.
+     * @param fd An open file descriptor. Its position is not relied upon, and on POSIX systems is not changed.
+     * @param offset The position in the file to start from.
+     * @param length The number of bytes to send. Zero sends everything from 'offset' to the end of the file.
+     * @return The number of bytes sent. This is less than requested if the file ends early.
+     */
+    size_t sendFile(int fd, uint64_t offset = 0, size_t length = 0);
+
+    /**
+     * Send part of a file through the socket.
+     * The file is opened for the duration of the call.
+     * @see sendFile(int, uint64_t, size_t)
+     * @param path The file to send.
+     * @param offset The position in the file to start from.
+     * @param length The number of bytes to send. Zero sends everything from 'offset' to the end of the file.
+     * @return The number of bytes sent.
+     */
+    size_t sendFile(const std::string& path, uint64_t offset = 0, size_t length = 0);
+
+    /**
+     * Turn on zero-copy sending for sendZeroCopy(). (SO_ZEROCOPY on Linux.)
+     * With zero-copy the kernel sends straight from the caller's memory instead of copying it
+     * first, which saves a lot of CPU on multi-megabyte sends. The catch is that the memory
+     * must be left alone until the kernel reports that it is done with it; see sendZeroCopy().
+     * Pinning pages has a fixed cost, so smaller sends are simply copied as usual.
+     * @param threshold Sends shorter than this many bytes are copied rather than pinned.
+     * @return true if zero-copy is available; false if sendZeroCopy() will always copy.
+     */
+    bool enableZeroCopy(size_t threshold = 16 * 1024);
+
+    /**
+     * Send data, without copying it if zero-copy is enabled and the data is large enough.
+     * This otherwise behaves as send() does. Unlike send(), the data must not be changed or
+     * freed until the returned token is complete (see isZeroCopyDone() and waitZeroCopy()).
+     * Tokens complete in the order they were issued.
+     * @param data A pointer to the data to be sent.
+     * @param len The number of bytes to send.
+     * @param token Set to a completion token for the data. Zero means the data was copied and
+     * may be reused immediately.
+     * @return The number of bytes sent.
+     */
+    size_t sendZeroCopy(const void* data, size_t len, uint64_t& token);
+
+    /**
+     * Collect any zero-copy completion notices waiting on the socket, without blocking.
+     * isZeroCopyDone() and waitZeroCopy() call this themselves.
+     * @return The number of notices collected.
+     */
+    size_t reapZeroCopy();
+
+    //! Indicates whether the memory sent under a zero-copy token may be reused. Token zero is always done.
+    bool isZeroCopyDone(uint64_t token);
+
+    /**
+     * Wait until the memory sent under a zero-copy token may be reused.
+     * @param token A token from sendZeroCopy().
+     * @param timeoutSeconds The maximum number of seconds to wait. SELECT_FOREVER waits indefinitely.
+     * @return true if the token is complete; false if the wait timed out.
+     */
+    bool waitZeroCopy(uint64_t token, float timeoutSeconds = SELECT_FOREVER);
 
     /**
      * Recieve up to 'len' bytes of data from the remote machine.
@@ -108,6 +278,87 @@ namespace SSocks {
      */
     std::vector<char> peek(size_t len);
 
+    /**
+     * Recieve up to 'len' bytes into a caller-provided buffer.
+     * This behaves as recv() does, filling the buffer when blocking and reading once when not,
+     * but allocates nothing. Check isOpen() afterward, as with recv().
+     * @param buffer Where to store the data. It must have room for 'len' bytes.
+     * @param len The maximum number of bytes to read.
+     * @return The number of bytes read. In non-blocking mode this may be zero.
+     */
+    size_t recvInto(void* buffer, size_t len);
+
+    /**
+     * Recieve whatever is available, up to 'len' bytes, into a caller-provided buffer.
+     * Unlike recvInto(), this never waits for the buffer to fill. A blocking socket waits only
+     * until some data arrives. Check isOpen() afterward, as with recv().
+     * @param buffer Where to store the data. It must have room for 'len' bytes.
+     * @param len The maximum number of bytes to read.
+     * @return The number of bytes read. In non-blocking mode this may be zero.
+     */
+    size_t recvSome(void* buffer, size_t len);
+
+    /**
+     * Recieve into several buffers in turn, filling each before moving to the next.
+     * This is a single scatter-read system call per pass. As with recv(), a blocking socket
+     * reads until every buffer is full or the remote host closes the connection, while a
+     * non-blocking one reads once. Check isOpen() afterward, as with recv().
+     * @param buffers The buffers to fill, in order.
+     * @param count The number of buffers.
+     * @return The total number of bytes read. In non-blocking mode this may be zero.
+     */
+    size_t recvv(const MutableBuffer* buffers, size_t count);
+
+    //! @copydoc recvv(const MutableBuffer*, size_t)
+    size_t recvv(std::initializer_list<MutableBuffer> buffers);
+
+    /**
+     * Send 'len' bytes, giving up when a deadline passes.
+     * This works the same in blocking and non-blocking mode, and leaves the mode as it was.
+     * A deadline that has already passed still sends whatever fits without waiting.
+     * @param data A pointer to the data to send.
+     * @param len The number of bytes to send.
+     * @param deadline When to give up. @see Deadline
+     * @return The number of bytes sent. Less than 'len' means the deadline passed, with the
+     * rest unsent and the socket still open. Errors are thrown as std::runtime_error instead.
+     */
+    size_t send(const void* data, size_t len, Deadline deadline);
+
+    /**
+     * Recieve exactly 'len' bytes, giving up when a deadline passes.
+     * The deadline covers the whole read, however many pieces the data arrives in, so a peer
+     * that trickles data in can't hold the caller past it. This works the same in blocking and
+     * non-blocking mode, and leaves the mode as it was.
+     * @param len The number of bytes to read.
+     * @param deadline When to give up. @see Deadline
+     * @return Everything recieved. If it's shorter than 'len' then either the remote host closed
+     * the connection (isOpen() is false) or the deadline passed (isOpen() is still true, and
+     * the rest can be read later). Errors are thrown as std::runtime_error instead.
+     */
+    std::vector<char> recv(size_t len, Deadline deadline);
+
+    /**
+     * Recieve exactly 'len' bytes into a caller-provided buffer, giving up when a deadline passes.
+     * @see recv(size_t, Deadline)
+     * @param buffer Where to store the data. It must have room for 'len' bytes.
+     * @param len The number of bytes to read.
+     * @param deadline When to give up.
+     * @return The number of bytes read. Less than 'len' means the connection closed or the
+     * deadline passed; check isOpen() to tell which.
+     */
+    size_t recvInto(void* buffer, size_t len, Deadline deadline);
+
+#ifdef SSOCKS_HAS_SPAN
+    //! @copydoc sendAll(const void*, size_t)
+    size_t sendAll(std::span<const std::byte> data) { return sendAll(data.data(), data.size()); }
+
+    //! @copydoc recvInto(void*, size_t)
+    size_t recvInto(std::span<std::byte> buffer) { return recvInto(buffer.data(), buffer.size()); }
+
+    //! @copydoc recvSome(void*, size_t)
+    size_t recvSome(std::span<std::byte> buffer) { return recvSome(buffer.data(), buffer.size()); }
+#endif
+
     /**
      * Indicates whether the socket is connected to a remote host.
      * Calls to send() and recv() can update this value if the remote host closed the connection.
@@ -132,18 +383,47 @@ namespace SSocks {
     */
     void setBlocking(bool block);
 
-  private:
-    Utility::Winsock wsa;
+    /**
+     * Set whether small writes are sent immediately (TCP_NODELAY).
+     * By default TCP holds back a small segment while earlier data is unacknowledged (Nagle's
+     * algorithm), trading latency for fewer packets. Turning that off sends every write at once.
+     * @param noDelay Set true to send small writes immediately; false for the default behavior.
+     */
+    void setNoDelay(bool noDelay);
 
+    /**
+     * Set whether partial segments are held back until corked data fills a full segment (TCP_CORK).
+     * While corked, writes are only sent in full-sized segments (or after a timeout of about
+     * 200ms). Uncorking sends whatever is held at once. This packs a burst of small writes into
+     * as few packets as possible. (TCP_NOPUSH on BSD and macOS.) Throws on platforms without it.
+     * @param cork Set true to cork the socket; false to uncork it.
+     */
+    void setCork(bool cork);
+
+  private:
     int sock;
     bool blocking;
 
-    std::vector<char> fullRecv(size_t len);
-    std::vector<char> singlePassRecv(size_t len, int flags);
+    //zero-copy state: sends smaller than the threshold are copied (zero means disabled), and
+    //tokens count zero-copy send calls issued and completed
+    size_t zeroCopyThreshold;
+    uint64_t zeroCopySent;
+    uint64_t zeroCopyDone;
+
+    SocketOptions options;
+    SocketMetrics metrics;
+
+    size_t fullRecv(char* buffer, size_t len);
+    size_t singlePassRecv(char* buffer, size_t len, int flags);
+    size_t copyFile(int fd, uint64_t offset, size_t length);
 
     template<class T> friend std::vector<T*> select(const std::vector<T*>& sockets, float timeoutSeconds);
+    friend class Poller;
+    friend class IOUring;
+    friend class EventLoop;
 
     friend class TCPServer;
+    friend class ConnectionPool;
 
   };
 
@@ -0,0 +1,160 @@
+/** @file */
+#pragma once
+#include "ns_Utility.h"
+
+//Coroutines need C++20; see SSOCKS_HAS_COROUTINES in ns_Utility.h.
+#ifdef SSOCKS_HAS_COROUTINES
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace SSocks {
+  template<class T> class Task;
+
+  namespace Utility {
+
+    //When a task finishes, hand control straight to whoever was awaiting it (if anyone).
+    struct TaskFinal {
+      bool await_ready() noexcept { return false; }
+      template<class P> std::coroutine_handle<> await_suspend(std::coroutine_handle<P> done) noexcept {
+        std::coroutine_handle<> next = done.promise().continuation;
+        return next ? next : std::noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+
+    //The parts of a task's promise that don't depend on its result type.
+    struct TaskPromiseBase {
+      std::coroutine_handle<> continuation;
+      std::exception_ptr error;
+
+      std::suspend_always initial_suspend() noexcept { return {}; }
+      TaskFinal final_suspend() noexcept { return {}; }
+      void unhandled_exception() noexcept { error = std::current_exception(); }
+    };
+
+    template<class T> struct TaskPromise : TaskPromiseBase {
+      std::optional<T> value;
+
+      Task<T> get_return_object() noexcept;
+      template<class U> void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+      T take() {
+        if(error) { std::rethrow_exception(error); }
+        return std::move(*value);
+      }
+    };
+
+    template<> struct TaskPromise<void> : TaskPromiseBase {
+      Task<void> get_return_object() noexcept;
+      void return_void() noexcept {}
+      void take() {
+        if(error) { std::rethrow_exception(error); }
+      }
+    };
+
+    //A spawned task's frame: it starts at once and frees itself when it finishes.
+    struct Detached {
+      struct promise_type {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+      };
+    };
+
+  }
+
+  /**
+   * A coroutine that produces a T, or nothing for Task<void>.
+   * A function returning Task may use co_await and co_return. It doesn't start running until
+   * it is awaited by another coroutine, and then runs until it finishes, with the awaiting
+   * coroutine resuming as soon as it does. Exceptions thrown inside the task come out of the
+   * co_await. The outermost task is started with spawn().\n
+   * Used with the operations in fn_async.h, a connection can be handled as straight-line code:
+   * @code
+   * SSocks::Task<> echo(SSocks::EventLoop& loop, SSocks::TCPSocket sock) {
+   *   char buffer[4096];
+   *   while(size_t got = co_await SSocks::asyncRecv(loop, sock, buffer, sizeof(buffer))) {
+   *     co_await SSocks::asyncSend(loop, sock, buffer, got);
+   *   }
+   * }
+   * @endcode
+   * This is only available when compiling as C++20 or later.
+   */
+  template<class T = void> class Task {
+  public:
+    //! The coroutine promise type, as required by the compiler.
+    typedef Utility::TaskPromise<T> promise_type;
+
+    //! Move constructor.
+    Task(Task&& moveFrom) noexcept : handle(std::exchange(moveFrom.handle, nullptr)) {}
+
+    //! Move-assign. A task that hasn't finished is destroyed without running further.
+    Task& operator=(Task&& moveFrom) noexcept {
+      if(this != &moveFrom) {
+        if(handle) { handle.destroy(); }
+        handle = std::exchange(moveFrom.handle, nullptr);
+      }
+      return *this;
+    }
+
+    //! Copying is prohibited, as the task owns its coroutine.
+    Task(const Task&) = delete;
+
+    //! Copying is prohibited, as the task owns its coroutine.
+    Task& operator=(const Task&) = delete;
+
+    //! Destructor. A task that hasn't finished is destroyed without running further.
+    ~Task() { if(handle) { handle.destroy(); } }
+
+    //! Return true if the task has run to completion.
+    bool isDone() const noexcept { return !handle || handle.done(); }
+
+    //! Awaiting a task always runs it.
+    bool await_ready() const noexcept { return false; }
+
+    //! Run the task, resuming the awaiting coroutine when it finishes.
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+      handle.promise().continuation = awaiter;
+      return handle;
+    }
+
+    //! Return the task's result, or throw what it threw.
+    T await_resume() { return handle.promise().take(); }
+
+  private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) noexcept : handle(handle) {}
+
+    friend promise_type;
+
+  };
+
+  template<class T> inline Task<T> Utility::TaskPromise<T>::get_return_object() noexcept {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+  }
+
+  inline Task<void> Utility::TaskPromise<void>::get_return_object() noexcept {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+  }
+
+  namespace Utility {
+    inline Detached runDetached(Task<void> task) { co_await task; }
+  }
+
+  /**
+   * Start a task without waiting for it to finish.
+   * The task runs on the calling thread until it first has to wait, then carries on from
+   * whatever resumes it (usually EventLoop::run()), and frees itself when it finishes.
+   * An exception escaping a spawned task calls std::terminate(), so catch what you expect.
+   * @param task The task to run.
+   */
+  inline void spawn(Task<void> task) {
+    Utility::runDetached(std::move(task));
+  }
+
+}
+
+#endif
@@ -1,15 +1,21 @@
 #include "cl_UDPSocket.h"
-#include <WS2tcpip.h>
+#include "ns_Platform.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef __linux__
+#include <netinet/udp.h>
+#endif
 
 //set default values
-SSocks::UDPSocket::UDPSocket() : sock(SOCKET_ERROR), blocking(true), connected(false) {
+SSocks::UDPSocket::UDPSocket() : sock(Utility::Platform::INVALID_SOCK), blocking(true), connected(false), v6(false), metrics(MetricSource::UDP_SOCKET) {
   //nothing
 }
 
 //copy source object values and then break its ownership
-SSocks::UDPSocket::UDPSocket(UDPSocket&& moveFrom) : sock(moveFrom.sock), blocking(moveFrom.blocking), connected(moveFrom.connected) {
+SSocks::UDPSocket::UDPSocket(UDPSocket&& moveFrom) : sock(moveFrom.sock), blocking(moveFrom.blocking), connected(moveFrom.connected), v6(moveFrom.v6), options(moveFrom.options), metrics(moveFrom.metrics) {
   //remove resource ownership from the source
-  moveFrom.sock = SOCKET_ERROR;
+  moveFrom.sock = Utility::Platform::INVALID_SOCK;
 }
 
 
@@ -18,9 +24,12 @@ void SSocks::UDPSocket::operator=(UDPSocket&& moveFrom) {
   sock = moveFrom.sock;
   blocking = moveFrom.blocking;
   connected = moveFrom.connected;
+  v6 = moveFrom.v6;
+  options = moveFrom.options;
+  metrics = moveFrom.metrics;
 
   //remove resource ownership from the source
-  moveFrom.sock = SOCKET_ERROR;
+  moveFrom.sock = Utility::Platform::INVALID_SOCK;
 }
 
 //close socket
@@ -32,48 +41,76 @@ void SSocks::UDPSocket::open(uint16_t port, bool forceBind, const std::string& l
   //release any existing socket
   close();
 
-  //We need a sockaddr_in to bind the port and interface.
-  sockaddr_in sain = { 0 };
-  sain.sin_family = AF_INET;
-  sain.sin_port = htons(port);
-
-  //This shouldn't fail unless you type in gibberish, but let's be safe.
-  int result = inet_pton(AF_INET, localHostAddr.c_str(), &sain.sin_addr);
-  switch(result) {
-  case 0: throw std::runtime_error("Attempted to bind UDPSocket on interaface with invalid address string.");
-  case -1: throw std::runtime_error(Utility::lastErrStr(WSAGetLastError()));
+  //We need an address to bind the port and interface.
+  HostAddress local;
+  if(!HostAddress::parse(localHostAddr, port, local)) {
+    throw std::runtime_error("Attempted to bind UDPSocket on interaface with invalid address string.");
   }
+  bool isV6 = local.getFamily() == HostAddress::Family::IPV6;
 
   //TSock will release the resource if the bind fails.
-  Utility::TSock temp(SOCK_DGRAM, IPPROTO_UDP);
-  
+  Utility::TSock temp(static_cast<const sockaddr*>(local)->sa_family, SOCK_DGRAM, IPPROTO_UDP);
+  int result;
+
+  //an IPv6 socket talks to IPv4 hosts too, but some systems need to be asked
+  if(isV6) {
+    int off = 0;
+    result = setsockopt(temp, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast<char*>(&off), sizeof(off));
+    if(result) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
+  }
+
+  options.apply(temp, false);
+
   if(port != 0) { //ephemeral binding is assumed, so if port is zero then we can skip this.
-    result = bind(temp, reinterpret_cast<sockaddr*>(&sain), sizeof(sain));
-    if(result) { throw std::runtime_error(Utility::lastErrStr(WSAGetLastError())); }
+    result = bind(temp, local, local.size());
+    if(result) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
   }
 
   //looks like we're okay, so take ownership of the resource
   sock = temp.validate();
+  v6 = isV6;
+}
+
+void SSocks::UDPSocket::setOptions(const SocketOptions& options) {
+  if(isOpen()) { options.apply(sock, false); }
+  this->options = options;
+}
+
+const SSocks::SocketOptions& SSocks::UDPSocket::getOptions() const {
+  return options;
+}
+
+SSocks::MetricsSnapshot SSocks::UDPSocket::getMetrics() const {
+  return metrics.snapshot();
 }
 
 bool SSocks::UDPSocket::isOpen() const {
-  return sock != SOCKET_ERROR;
+  return sock != Utility::Platform::INVALID_SOCK;
 }
 
 void SSocks::UDPSocket::close() {
   //close socket and reset all state
-  if(isOpen()) { closesocket(sock); }
+  if(isOpen()) { Utility::Platform::closeSocket(sock); }
 
-  sock = SOCKET_ERROR;
+  sock = Utility::Platform::INVALID_SOCK;
   blocking = true;
   connected = false;
+  v6 = false;
 }
 
 size_t SSocks::UDPSocket::sendTo(const HostAddress& host, const char* data, size_t len) {
   if(!isOpen()) { throw std::runtime_error("Attempted sendTo on unopened UDP socket."); }
 
-  size_t sent = ::sendto(sock, data, len, 0, host, host.size());
-  if(sent == SOCKET_ERROR) { throw std::runtime_error(Utility::lastErrStr(WSAGetLastError())); }
+  HostAddress mapped;
+  const HostAddress& to = reachable(host, mapped);
+  int sent = ::sendto(sock, data, len, Utility::Platform::SEND_FLAGS, to, to.size());
+  if(sent == Utility::Platform::SOCK_ERROR) {
+    int err = Utility::Platform::lastError();
+    if(Utility::Platform::wouldBlock(err)) { metrics.wouldBlock(); }
+    else { metrics.failed(); }
+    throw std::runtime_error(Utility::lastErrStr(err));
+  }
+  metrics.sent(sent, len);
 
   return sent;
 }
@@ -88,60 +125,498 @@ size_t SSocks::UDPSocket::sendTo(const HostAddress& host, const std::vector<char
   return sendTo(host, data.data(), data.size());
 }
 
+namespace {
+  //largest payload a UDP datagram can carry (this is actually slightly larger than needed)
+  const size_t MAX_UDP_DATAGRAM_LENGTH = 0xFFFF;
+
+  //The vector-returning receives read into this first, so that they allocate only as much as
+  //the datagram needs rather than allocating (and zeroing) the largest possible one every time.
+  thread_local char scratch[MAX_UDP_DATAGRAM_LENGTH];
+}
+
 std::pair<std::vector<char>, SSocks::HostAddress> SSocks::UDPSocket::recvFrom() {
   if(!isOpen()) { throw std::runtime_error("Attempted recvFrom on unopened UDP socket."); }
 
   //create an address object for storing data about the origin of the datagram
-  sockaddr_in from = { 0 };
-  int fromLen = sizeof(from);
+  sockaddr_storage from = { 0 };
+
+  //read into scratch space and copy out just what arrived
+  size_t got = recvDatagram(scratch, sizeof(scratch), &from);
+
+  //return the data and a HostAddress pointing to the sender
+  return std::make_pair(std::vector<char>(scratch, scratch + got), HostAddress(reinterpret_cast<sockaddr*>(&from)));
+}
+
+std::pair<SSocks::PooledBuffer, SSocks::HostAddress> SSocks::UDPSocket::recvFrom(BufferPool& pool) {
+  if(!isOpen()) { throw std::runtime_error("Attempted recvFrom on unopened UDP socket."); }
+
+  sockaddr_storage from = { 0 };
+  PooledBuffer buffer = pool.acquire();
+  buffer.resize(recvDatagram(buffer.data(), buffer.capacity(), &from));
+
+  return std::make_pair(std::move(buffer), HostAddress(reinterpret_cast<sockaddr*>(&from)));
+}
+
+size_t SSocks::UDPSocket::recvFrom(void* buffer, size_t len, HostAddress& from) {
+  if(!isOpen()) { throw std::runtime_error("Attempted recvFrom on unopened UDP socket."); }
+
+  sockaddr_storage sender = { 0 };
+  size_t result = recvDatagram(buffer, len, &sender);
+
+  //an empty sender means nothing was read
+  if(sender.ss_family != 0) { from = HostAddress(reinterpret_cast<sockaddr*>(&sender)); }
+
+  return result;
+}
+
+std::optional<std::pair<std::vector<char>, SSocks::HostAddress>> SSocks::UDPSocket::recvFrom(Deadline deadline) {
+  HostAddress from;
+  std::optional<size_t> got = recvFrom(scratch, sizeof(scratch), from, deadline);
+  if(!got) { return std::nullopt; }
+  return std::make_pair(std::vector<char>(scratch, scratch + *got), from);
+}
+
+std::optional<size_t> SSocks::UDPSocket::recvFrom(void* buffer, size_t len, HostAddress& from, Deadline deadline) {
+  if(!isOpen()) { throw std::runtime_error("Attempted recvFrom on unopened UDP socket."); }
+
+  //Where a single call can be made non-blocking, try before waiting, since a datagram may
+  //already be queued. Otherwise a blocking socket has to be polled first.
+  bool tryFirst = Utility::Platform::NO_WAIT != 0 || !blocking;
 
-  //prepare a buffer that can hold the largest possible datagram
-  const size_t MAX_UDP_DATAGRAM_LENGTH = 0xFFFF; //(this is actually slightly larger than needed)
-  std::vector<char> buffer(MAX_UDP_DATAGRAM_LENGTH);
+  while(tryFirst || Utility::waitReady(sock, false, deadline)) {
+    tryFirst = false;
+
+    sockaddr_storage sender = { 0 };
+    size_t got = recvDatagram(buffer, len, &sender, Utility::Platform::NO_WAIT);
+
+    //an empty sender means nothing was read, as can happen when a datagram fails its checksum
+    if(sender.ss_family != 0) {
+      from = HostAddress(reinterpret_cast<sockaddr*>(&sender));
+      return got;
+    }
+  }
+
+  return std::nullopt;
+}
+
+size_t SSocks::UDPSocket::recvDatagram(void* buffer, size_t len, sockaddr_storage* from, int flags) {
+  Utility::Platform::AddrLen fromLen = sizeof(*from);
+  sockaddr* fromp = reinterpret_cast<sockaddr*>(from);
 
   //read into the buffer
-  int result = ::recvfrom(sock, buffer.data(), buffer.size(), 0, reinterpret_cast<sockaddr*>(&from), &fromLen);
-  if(result == SOCKET_ERROR) {
-    int err = WSAGetLastError();
-    if(err == WSAEWOULDBLOCK) {
+  int result = ::recvfrom(sock, reinterpret_cast<char*>(buffer), len, flags, fromp, from ? &fromLen : nullptr);
+  if(result == Utility::Platform::SOCK_ERROR) {
+    int err = Utility::Platform::lastError();
+    if(Utility::Platform::wouldBlock(err)) {
       //non-blocking socket had no data incoming, so just return an empty result
-      result = 0;
+      metrics.wouldBlock();
+      return 0;
     }
-    else {
-      //otherwise assume the socket is invalidated and throw
-      close();
+    //otherwise assume the socket is invalidated and throw
+    metrics.failed();
+    close();
+    throw std::runtime_error(Utility::lastErrStr(err));
+  }
+  metrics.received(result);
+
+  return result;
+}
+
+#ifdef __linux__
+
+namespace {
+  //Datagrams are handed to the kernel this many at a time. The message arrays live on the
+  //stack, so a batch costs no allocation however large it is.
+  const size_t BATCH_CHUNK = 64;
+}
+
+size_t SSocks::UDPSocket::sendBatch(const Datagram* datagrams, size_t count) {
+  if(!isOpen()) { throw std::runtime_error("Attempted sendBatch on unopened UDP socket."); }
+
+  mmsghdr msgs[BATCH_CHUNK];
+  iovec iovs[BATCH_CHUNK];
+  HostAddress mapped[BATCH_CHUNK];
+
+  size_t totalSent = 0;
+  while(totalSent < count) {
+    size_t chunk = std::min(count - totalSent, BATCH_CHUNK);
+    size_t chunkBytes = 0;
+    for(size_t i = 0; i < chunk; i++) {
+      const Datagram& dg = datagrams[totalSent + i];
+      chunkBytes += dg.size;
+      iovs[i].iov_base = dg.data;
+      iovs[i].iov_len = dg.size;
+      msgs[i] = mmsghdr{};
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      if(!connected) {
+        const HostAddress& to = reachable(dg.host, mapped[i]);
+        msgs[i].msg_hdr.msg_name = const_cast<sockaddr*>(static_cast<const sockaddr*>(to));
+        msgs[i].msg_hdr.msg_namelen = to.size();
+      }
+    }
+
+    int sent = sendmmsg(sock, msgs, chunk, Utility::Platform::SEND_FLAGS);
+    if(sent == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      //a full send buffer on a non-blocking socket just ends the batch early
+      if(Utility::Platform::wouldBlock(err)) {
+        metrics.wouldBlock();
+        break;
+      }
+      metrics.failed();
+      //if some of the batch already went out then report that, and let the next call hit the error
+      if(totalSent > 0) { break; }
       throw std::runtime_error(Utility::lastErrStr(err));
     }
+
+    size_t sentBytes = 0;
+    for(int i = 0; i < sent; i++) { sentBytes += msgs[i].msg_len; }
+    metrics.sent(sentBytes, chunkBytes);
+
+    totalSent += sent;
+    if(static_cast<size_t>(sent) < chunk) { break; }
   }
 
-  //size down the buffer to fit the recieved data
-  buffer.resize(result);
+  return totalSent;
+}
+
+size_t SSocks::UDPSocket::recvBatch(Datagram* datagrams, size_t count) {
+  if(!isOpen()) { throw std::runtime_error("Attempted recvBatch on unopened UDP socket."); }
+
+  mmsghdr msgs[BATCH_CHUNK];
+  iovec iovs[BATCH_CHUNK];
+  sockaddr_storage from[BATCH_CHUNK];
+
+  size_t totalRead = 0;
+  while(totalRead < count) {
+    size_t chunk = std::min(count - totalRead, BATCH_CHUNK);
+    for(size_t i = 0; i < chunk; i++) {
+      Datagram& dg = datagrams[totalRead + i];
+      iovs[i].iov_base = dg.data;
+      iovs[i].iov_len = dg.capacity;
+      msgs[i] = mmsghdr{};
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_name = &from[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+    }
 
-  //return the buffer and a HostAddress pointing to the sender
-  return std::make_pair(buffer, HostAddress(&from));
+    //Only the very first read may block, and then only until one datagram arrives.
+    //After that we take what's already waiting and stop.
+    int flags = (totalRead == 0) ? MSG_WAITFORONE : MSG_DONTWAIT;
+    int got = recvmmsg(sock, msgs, chunk, flags, nullptr);
+    if(got == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      bool blocked = Utility::Platform::wouldBlock(err);
+      if(blocked) { metrics.wouldBlock(); }
+      else { metrics.failed(); }
+      if(blocked || totalRead > 0) { break; }
+      close(); //assume the socket is invalidated and throw
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+
+    size_t gotBytes = 0;
+    for(int i = 0; i < got; i++) {
+      Datagram& dg = datagrams[totalRead + i];
+      dg.size = msgs[i].msg_len;
+      gotBytes += dg.size;
+      dg.host = HostAddress(reinterpret_cast<sockaddr*>(&from[i]));
+      dg.truncated = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+    }
+    metrics.received(gotBytes);
+
+    totalRead += got;
+    if(static_cast<size_t>(got) < chunk) { break; }
+  }
+
+  return totalRead;
 }
 
+#else
+
+//Without sendmmsg()/recvmmsg() the batch is simply sent and recieved one datagram at a time.
+
+size_t SSocks::UDPSocket::sendBatch(const Datagram* datagrams, size_t count) {
+  if(!isOpen()) { throw std::runtime_error("Attempted sendBatch on unopened UDP socket."); }
+
+  size_t totalSent = 0;
+  for(; totalSent < count; totalSent++) {
+    const Datagram& dg = datagrams[totalSent];
+    HostAddress mapped;
+    const HostAddress& host = reachable(dg.host, mapped);
+    const sockaddr* to = connected ? nullptr : static_cast<const sockaddr*>(host);
+    int toLen = connected ? 0 : static_cast<int>(host.size());
+
+    int sent = ::sendto(sock, dg.data, static_cast<int>(dg.size), Utility::Platform::SEND_FLAGS, to, toLen);
+    if(sent == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      bool blocked = Utility::Platform::wouldBlock(err);
+      if(blocked) { metrics.wouldBlock(); }
+      else { metrics.failed(); }
+      if(blocked || totalSent > 0) { break; }
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+    metrics.sent(sent, dg.size);
+  }
+
+  return totalSent;
+}
+
+size_t SSocks::UDPSocket::recvBatch(Datagram* datagrams, size_t count) {
+  if(!isOpen()) { throw std::runtime_error("Attempted recvBatch on unopened UDP socket."); }
+
+  //a blocking socket waits for the first datagram only, just as with recvmmsg()
+  bool wasBlocking = blocking;
+  size_t totalRead = 0;
+  for(; totalRead < count; totalRead++) {
+    Datagram& dg = datagrams[totalRead];
+    sockaddr_storage from = { 0 };
+    Utility::Platform::AddrLen fromLen = sizeof(from);
+
+    int got = ::recvfrom(sock, dg.data, static_cast<int>(dg.capacity), 0, reinterpret_cast<sockaddr*>(&from), &fromLen);
+    if(got == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      //Winsock reports a truncated datagram as an error, having stored what fit
+      bool tooLong = false;
+      #ifdef _WIN32
+      tooLong = (err == WSAEMSGSIZE);
+      #endif
+      if(tooLong) {
+        got = static_cast<int>(dg.capacity);
+        dg.truncated = true;
+      }
+      else if(Utility::Platform::wouldBlock(err)) {
+        metrics.wouldBlock();
+        break;
+      }
+      else {
+        metrics.failed();
+        if(totalRead > 0) { break; }
+        close(); //assume the socket is invalidated and throw
+        throw std::runtime_error(Utility::lastErrStr(err));
+      }
+    }
+    else { dg.truncated = false; }
+    metrics.received(got);
+
+    dg.size = got;
+    dg.host = HostAddress(reinterpret_cast<sockaddr*>(&from));
+
+    if(totalRead == 0 && blocking) { setBlocking(false); }
+  }
+
+  if(wasBlocking && !blocking) { setBlocking(true); }
+
+  return totalRead;
+}
+
+#endif
+
+size_t SSocks::UDPSocket::sendSegmented(const HostAddress& host, const void* data, size_t len, uint16_t segmentSize) {
+  if(!isOpen()) { throw std::runtime_error("Attempted sendSegmented on unopened UDP socket."); }
+  HostAddress mapped;
+  const HostAddress& to = reachable(host, mapped);
+  return sendSegments(to, to.size(), reinterpret_cast<const char*>(data), len, segmentSize);
+}
+
+size_t SSocks::UDPSocket::sendSegmented(const void* data, size_t len, uint16_t segmentSize) {
+  if(!connected) { throw std::runtime_error("Attempted send on unconnected UDP socket. (did you mean to use sendTo?)"); }
+  return sendSegments(nullptr, 0, reinterpret_cast<const char*>(data), len, segmentSize);
+}
+
+#if defined(__linux__) && defined(UDP_SEGMENT)
+
+namespace {
+  //The kernel accepts at most this many segments per send, and no more than a single
+  //datagram's worth of payload in total.
+  const size_t MAX_GSO_SEGMENTS = 64;
+  const size_t MAX_GSO_PAYLOAD = 0xFFFF - 8 - 20; //less the UDP and IPv4 headers
+}
+
+size_t SSocks::UDPSocket::sendSegments(const sockaddr* to, size_t toLen, const char* data, size_t len, uint16_t segmentSize) {
+  if(segmentSize == 0) { throw std::invalid_argument("UDP segment size must be nonzero."); }
+
+  //the most we can hand over per call, in whole segments
+  size_t perCall = std::min(MAX_GSO_SEGMENTS, std::max<size_t>(MAX_GSO_PAYLOAD / segmentSize, 1)) * segmentSize;
+
+  //control message carrying the segment size
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+
+  size_t totalSent = 0;
+  while(totalSent < len) {
+    size_t chunk = std::min(len - totalSent, perCall);
+
+    iovec iov;
+    iov.iov_base = const_cast<char*>(data + totalSent);
+    iov.iov_len = chunk;
+
+    msghdr msg = {};
+    msg.msg_name = const_cast<sockaddr*>(to);
+    msg.msg_namelen = toLen;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    //a chunk no bigger than one segment is just an ordinary datagram
+    if(chunk > segmentSize) {
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+      cm->cmsg_level = SOL_UDP;
+      cm->cmsg_type = UDP_SEGMENT;
+      cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      std::memcpy(CMSG_DATA(cm), &segmentSize, sizeof(segmentSize));
+    }
+
+    ssize_t sent = ::sendmsg(sock, &msg, Utility::Platform::SEND_FLAGS);
+    if(sent == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      if(Utility::Platform::wouldBlock(err)) {
+        metrics.wouldBlock();
+        break;
+      }
+      metrics.failed();
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+    metrics.sent(sent, chunk);
+
+    totalSent += sent;
+  }
+
+  return totalSent;
+}
+
+void SSocks::UDPSocket::setReceiveOffload(bool enable) {
+  if(!isOpen()) { throw std::runtime_error("Attempted to set receive offload on unopened UDP socket."); }
+
+  int temp = enable ? 1 : 0;
+  int result = setsockopt(sock, SOL_UDP, UDP_GRO, &temp, sizeof(temp));
+  if(result) { throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError())); }
+}
+
+size_t SSocks::UDPSocket::recvSegmented(void* buffer, size_t len, HostAddress& from, size_t& segmentSize) {
+  if(!isOpen()) { throw std::runtime_error("Attempted recvSegmented on unopened UDP socket."); }
+
+  sockaddr_storage sender = { 0 };
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+
+  iovec iov;
+  iov.iov_base = buffer;
+  iov.iov_len = len;
+
+  msghdr msg = {};
+  msg.msg_name = &sender;
+  msg.msg_namelen = sizeof(sender);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t got = ::recvmsg(sock, &msg, 0);
+  if(got == Utility::Platform::SOCK_ERROR) {
+    int err = Utility::Platform::lastError();
+    if(Utility::Platform::wouldBlock(err)) {
+      metrics.wouldBlock();
+      return 0;
+    }
+    metrics.failed();
+    close(); //assume the socket is invalidated and throw
+    throw std::runtime_error(Utility::lastErrStr(err));
+  }
+  metrics.received(got);
+
+  //with no UDP_GRO message the read was a single datagram
+  segmentSize = got;
+  for(cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+    if(cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+      int gso;
+      std::memcpy(&gso, CMSG_DATA(cm), sizeof(gso));
+      segmentSize = gso;
+    }
+  }
+
+  from = HostAddress(reinterpret_cast<sockaddr*>(&sender));
+  return got;
+}
+
+#else
+
+//Without segmentation offload each segment is sent as its own datagram.
+size_t SSocks::UDPSocket::sendSegments(const sockaddr* to, size_t toLen, const char* data, size_t len, uint16_t segmentSize) {
+  if(segmentSize == 0) { throw std::invalid_argument("UDP segment size must be nonzero."); }
+
+  size_t totalSent = 0;
+  while(totalSent < len) {
+    size_t chunk = std::min<size_t>(len - totalSent, segmentSize);
+    int sent = ::sendto(sock, data + totalSent, static_cast<int>(chunk), Utility::Platform::SEND_FLAGS, to, static_cast<Utility::Platform::AddrLen>(toLen));
+    if(sent == Utility::Platform::SOCK_ERROR) {
+      int err = Utility::Platform::lastError();
+      if(Utility::Platform::wouldBlock(err)) {
+        metrics.wouldBlock();
+        break;
+      }
+      metrics.failed();
+      throw std::runtime_error(Utility::lastErrStr(err));
+    }
+    metrics.sent(sent, chunk);
+    totalSent += sent;
+  }
+
+  return totalSent;
+}
+
+void SSocks::UDPSocket::setReceiveOffload(bool enable) {
+  //turning it off is always fine, since it was never on
+  if(enable) { throw std::runtime_error("UDP receive offload (UDP_GRO) is not supported on this platform."); }
+}
+
+//without receive offload every read is a single datagram
+size_t SSocks::UDPSocket::recvSegmented(void* buffer, size_t len, HostAddress& from, size_t& segmentSize) {
+  size_t got = recvFrom(buffer, len, from);
+  segmentSize = got;
+  return got;
+}
+
+#endif
+
 void SSocks::UDPSocket::connect(const HostAddress& host) {
   if(!isOpen()) { throw std::runtime_error("Attempted connection on unopened UDP socket."); }
 
   //Any existing connection will simply be overridden by ::connect().
-
-  int result = ::connect(sock, host, sizeof(host));
+  HostAddress mapped;
+  const HostAddress& to = reachable(host, mapped);
+  int result = ::connect(sock, to, to.size());
   if(result) {
     close(); //assume socket is invalidated
-    throw std::runtime_error(Utility::lastErrStr(WSAGetLastError()));
+    throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError()));
   }
 
   connected = true;
 }
 
+//An IPv6 socket can only address an IPv4 host by its IPv4-mapped form (::ffff:a.b.c.d).
+const SSocks::HostAddress& SSocks::UDPSocket::reachable(const HostAddress& host, HostAddress& mapped) const {
+  if(!v6 || host.getFamily() == HostAddress::Family::IPV6) { return host; }
+
+  sockaddr_in6 sain6 = {};
+  sain6.sin6_family = AF_INET6;
+  sain6.sin6_port = static_cast<const sockaddr_in*>(host)->sin_port;
+  sain6.sin6_addr.s6_addr[10] = 0xFF;
+  sain6.sin6_addr.s6_addr[11] = 0xFF;
+  std::memcpy(&sain6.sin6_addr.s6_addr[12], &static_cast<const sockaddr_in*>(host)->sin_addr, 4);
+
+  mapped = HostAddress(reinterpret_cast<sockaddr*>(&sain6));
+  return mapped;
+}
+
 bool SSocks::UDPSocket::isConnected() const {
   return connected;
 }
 
 void SSocks::UDPSocket::disconnect() {
-  if(isConnected()) {
-    connect(HostAddress("0.0.0.0", 0)); //connecting to zero removes the connection behavior
+  if(isConnected() && !Utility::Platform::dissociate(sock)) {
+    close(); //assume socket is invalidated
+    throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError()));
   }
 
   connected = false;
@@ -160,40 +635,35 @@ int SSocks::UDPSocket::send(const std::vector<char>& data) {
 int SSocks::UDPSocket::send(const void* data, size_t len) {
   if(!connected) { throw std::runtime_error("Attempted send on unconnected UDP socket. (did you mean to use sendTo?)"); }
 
-  int result = ::send(sock, reinterpret_cast<const char*>(data), len, 0);
-  if(result == SOCKET_ERROR) {
+  int result = ::send(sock, reinterpret_cast<const char*>(data), len, Utility::Platform::SEND_FLAGS);
+  if(result == Utility::Platform::SOCK_ERROR) {
+    int err = Utility::Platform::lastError();
+    if(Utility::Platform::wouldBlock(err)) { metrics.wouldBlock(); }
+    else { metrics.failed(); }
     close(); //assume socket is invalidated
-    throw std::runtime_error(Utility::lastErrStr(WSAGetLastError()));
+    throw std::runtime_error(Utility::lastErrStr(err));
   }
+  metrics.sent(result, len);
 
   return result;
 }
 
 std::vector<char> SSocks::UDPSocket::recv() {
-  if(!connected) { throw std::runtime_error("Attempted recv on unconnected UDP socket. (did you mean to use recvFrom?)"); }
+  //read into scratch space and copy out just what arrived
+  size_t got = recvInto(scratch, sizeof(scratch));
+  return std::vector<char>(scratch, scratch + got);
+}
 
-  //allocate a buffer to hold the data
-  const size_t MAXIMUM_DATAGRAM_LENGTH = 0xFFFF;
-  std::vector<char> buffer(MAXIMUM_DATAGRAM_LENGTH);
-
-  //read into it
-  int result = ::recv(sock, buffer.data(), buffer.size(), 0);
-  if(result == SOCKET_ERROR) {
-    int err = WSAGetLastError();
-    if(err == WSAEWOULDBLOCK) {
-      //this is a non-blocking socket and no data was pending, so return an empty vector
-      result = 0;
-    }
-    else {
-      close(); //assume socket is invalidated
-      throw std::runtime_error(Utility::lastErrStr(err));
-    }
-  }
+SSocks::PooledBuffer SSocks::UDPSocket::recv(BufferPool& pool) {
+  PooledBuffer buffer = pool.acquire();
+  buffer.resize(recvInto(buffer.data(), buffer.capacity()));
+  return buffer;
+}
 
-  //shrink the vector to fit the data that was read
-  buffer.resize(result);
+size_t SSocks::UDPSocket::recvInto(void* buffer, size_t len) {
+  if(!connected) { throw std::runtime_error("Attempted recv on unconnected UDP socket. (did you mean to use recvFrom?)"); }
 
-  return buffer;
+  return recvDatagram(buffer, len, nullptr);
 }
 
 bool SSocks::UDPSocket::isBlocking() const {
@@ -206,14 +676,10 @@ void SSocks::UDPSocket::setBlocking(bool block) {
   //avoid needless system calls
   if(block == blocking) { return; }
 
-  //I really hate all this legacy crap that tries to make one function do everything.
-  //It makes the interfaces really unpleasant.
-  unsigned long temp = block ? 0 : 1;
   //set actual socket behavior according to state info
-  int result = ioctlsocket(sock, FIONBIO, &temp);
-  if(result == SOCKET_ERROR) {
+  if(!Utility::Platform::setBlocking(sock, block)) {
     close();  //assume socket is invalidated
-    throw std::runtime_error(Utility::lastErrStr(WSAGetLastError()));
+    throw std::runtime_error(Utility::lastErrStr(Utility::Platform::lastError()));
   }
 
   //update state info
@@ -1,8 +1,17 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <optional>
 #include "cl_HostAddress.h"
+#include "cl_BufferPool.h"
+#include "cl_SocketOptions.h"
+#include "cl_Metrics.h"
+#include "cl_Deadline.h"
 #include "ns_Utility.h"
+#include "fn_select.h"
+
+//Forward declaration so we don't have to leak the native socket headers into the user space
+struct sockaddr_storage;
 
 namespace SSocks {
   /**
@@ -10,6 +19,23 @@ namespace SSocks {
    */
   class UDPSocket {
   public:
+    /**
+     * One datagram in a batch for sendBatch() or recvBatch().
+     * The data is never copied into or out of the Datagram; it only points at caller-owned memory.
+     */
+    struct Datagram {
+      //! For sending, the data to send. For recieving, where to store the datagram.
+      char* data = nullptr;
+      //! For recieving, the capacity of 'data'. A longer datagram is truncated.
+      size_t capacity = 0;
+      //! For sending, the number of bytes to send. Set to the number of bytes stored when recieving.
+      size_t size = 0;
+      //! For sending, the destination (ignored if the socket is connected). Set to the sender when recieving.
+      HostAddress host;
+      //! Set when recieving if the datagram was longer than 'capacity' and was cut short.
+      bool truncated = false;
+    };
+
     //! Generate an inactive UDP socket object
     UDPSocket();
 
@@ -46,10 +72,28 @@ namespace SSocks {
      * @param forceBind Whether to force the bind even if the indicated port appears to be in use.\n
      * This option is present because a bound port takes a certain amount of time to become free again after being released. In general it should not be necessary to use it.
      * @param localHostAddr Address of local interface to listen on.\n
-     * This must be an IPv4 address in dot-quad notation, such as "127.0.0.1". The default address of "0.0.0.0" will listen on all available interfaces.
+     * This must be an IPv4 or IPv6 address, such as "127.0.0.1" or "::1". The default address of "0.0.0.0" will listen on all available IPv4 interfaces.
+     * "::" opens a dual-stack socket that can talk to both IPv6 and IPv4 hosts. IPv4 senders then appear as IPv4-mapped addresses.
      */
     void open(uint16_t port = 0, bool forceBind = false, const std::string& localHostAddr = "0.0.0.0");
 
+    /**
+     * Set the tuning options for this socket. TCP-only options are ignored.
+     * They are applied immediately if the socket is open, and again whenever it opens.
+     * They are kept across close().
+     * @param options The options to use.
+     */
+    void setOptions(const SocketOptions& options);
+
+    //! Return the tuning options for this socket.
+    const SocketOptions& getOptions() const;
+
+    /**
+     * Return this socket's I/O counters: bytes, system calls, partial sends, would-block
+     * returns and errors, since the object was created. @see MetricsRegistry for the totals.
+     */
+    MetricsSnapshot getMetrics() const;
+
     /**
      * Indicates whether the socket is active and may be used to send and recieve.
      * @return true if the socket is active; false if it is not.
@@ -109,6 +153,52 @@ namespace SSocks {
      */
     std::pair<std::vector<char>, HostAddress> recvFrom();
 
+    /**
+     * Attempt to read an incoming datagram into a caller-provided buffer.
+     * This allocates nothing, so it suits a receive loop that reuses one buffer. A datagram
+     * longer than 'len' is truncated, and the rest of it is lost.
+     * @param buffer Where to store the datagram. It must have room for 'len' bytes.
+     * @param len The capacity of 'buffer'.
+     * @param from Set to the address of the sender. It is left unchanged if nothing was read.
+     * @return The number of bytes stored. In non-blocking mode zero indicates that no incoming
+     * datagram was pending. (An empty datagram also reads as zero.)
+     */
+    size_t recvFrom(void* buffer, size_t len, HostAddress& from);
+
+    /**
+     * Attempt to read an incoming datagram into a buffer taken from a pool.
+     * The buffer goes back to the pool when the returned handle (and every copy of it) is
+     * destroyed, so a steady stream of datagrams recycles the same few buffers. A datagram
+     * longer than the pool's buffer size is truncated.
+     * @param pool The pool to take the buffer from. It must outlive the returned buffer.
+     * @return The data recieved and the address of the sender.\n
+     * In non-blocking mode the data may be empty, indicating that no incoming datagram was pending.
+     */
+    std::pair<PooledBuffer, HostAddress> recvFrom(BufferPool& pool);
+
+    /**
+     * Send several datagrams at once.
+     * On Linux the whole batch goes to the kernel in as few sendmmsg() calls as possible, rather
+     * than one call per datagram. Elsewhere the datagrams are sent one at a time.
+     * @param datagrams The datagrams to send. Each is sent to its own 'host', unless the socket
+     * is connected, in which case they all go to the associated host.
+     * @param count The number of datagrams.
+     * @return The number of datagrams sent. A non-blocking socket may send fewer than 'count'.
+     */
+    size_t sendBatch(const Datagram* datagrams, size_t count);
+
+    /**
+     * Read several incoming datagrams at once.
+     * On Linux this is done in as few recvmmsg() calls as possible. A blocking socket waits for
+     * the first datagram only, then takes whatever else is already waiting, up to 'count'.
+     * @param datagrams Where to store the datagrams. Set each 'data' and 'capacity' beforehand;
+     * 'size', 'host' and 'truncated' are filled in for each one recieved.
+     * @param count The number of datagrams available.
+     * @return The number of datagrams recieved. In non-blocking mode zero indicates that no
+     * incoming datagram was pending.
+     */
+    size_t recvBatch(Datagram* datagrams, size_t count);
+
     /**
      * Associate the socket with specific host.
      * UDP sockets do not 'connect' in the sense that TCP sockets do, but a UDP socket
@@ -171,6 +261,110 @@ namespace SSocks {
      */
     std::vector<char> recv();
 
+    /**
+     * Recieve a datagram from the associated host into a caller-provided buffer.
+     * UDPSocket::recvInto() will throw an exception if the socket is not connected to a specific host.
+     * A datagram longer than 'len' is truncated, and the rest of it is lost.
+     * @see connect()
+     * @see recvFrom()
+     * @param buffer Where to store the datagram. It must have room for 'len' bytes.
+     * @param len The capacity of 'buffer'.
+     * @return The number of bytes stored. In non-blocking mode zero indicates that no datagram was pending.
+     */
+    size_t recvInto(void* buffer, size_t len);
+
+    /**
+     * Recieve a datagram from the associated host into a buffer taken from a pool.
+     * UDPSocket::recv() will throw an exception if the socket is not connected to a specific host.
+     * A datagram longer than the pool's buffer size is truncated.
+     * @see connect()
+     * @see recvFrom(BufferPool&)
+     * @param pool The pool to take the buffer from. It must outlive the returned buffer.
+     * @return The recieved data. In non-blocking mode it may be empty, indicating that no datagram was pending.
+     */
+    PooledBuffer recv(BufferPool& pool);
+
+    /**
+     * Wait for an incoming datagram until a deadline passes.
+     * This works the same in blocking and non-blocking mode, and leaves the mode as it was.
+     * @param deadline When to give up. @see Deadline
+     * @return The data recieved and the address of the sender, or nothing if the deadline
+     * passed first. (An empty datagram is returned as empty data, so it isn't mistaken for that.)
+     * @throw std::runtime_error on a socket error.
+     */
+    std::optional<std::pair<std::vector<char>, HostAddress>> recvFrom(Deadline deadline);
+
+    /**
+     * Wait for an incoming datagram until a deadline passes, reading it into a caller-provided buffer.
+     * A datagram longer than 'len' is truncated, and the rest of it is lost.
+     * @see recvFrom(Deadline)
+     * @param buffer Where to store the datagram. It must have room for 'len' bytes.
+     * @param len The capacity of 'buffer'.
+     * @param from Set to the address of the sender. It is left unchanged if nothing was read.
+     * @param deadline When to give up.
+     * @return The number of bytes stored, or nothing if the deadline passed first.
+     */
+    std::optional<size_t> recvFrom(void* buffer, size_t len, HostAddress& from, Deadline deadline);
+
+#ifdef SSOCKS_HAS_SPAN
+    //! @copydoc recvFrom(void*, size_t, HostAddress&)
+    size_t recvFrom(std::span<std::byte> buffer, HostAddress& from) { return recvFrom(buffer.data(), buffer.size(), from); }
+
+    //! @copydoc recvInto(void*, size_t)
+    size_t recvInto(std::span<std::byte> buffer) { return recvInto(buffer.data(), buffer.size()); }
+
+    //! @copydoc send(const void*, size_t)
+    int send(std::span<const std::byte> data) { return send(data.data(), data.size()); }
+
+    //! @copydoc sendTo(const HostAddress&, const char*, size_t)
+    size_t sendTo(const HostAddress& host, std::span<const std::byte> data) { return sendTo(host, reinterpret_cast<const char*>(data.data()), data.size()); }
+#endif
+
+    /**
+     * Send a large buffer as a run of equal-sized datagrams, using segmentation offload.
+     * On Linux the buffer is handed to the kernel in as few calls as possible with UDP_SEGMENT
+     * (GSO), and split into datagrams further down the stack, often by the network card. That
+     * costs far less than one send per datagram. Elsewhere each datagram is sent separately.\n
+     * Every datagram holds 'segmentSize' bytes except possibly the last, which holds the remainder.
+     * @param host The host/port to send to.
+     * @param data A pointer to the data to send.
+     * @param len The number of bytes to send.
+     * @param segmentSize The payload size of each datagram. Keep it within the path MTU.
+     * @return The number of bytes sent, which may be fewer than requested on a non-blocking socket.
+     */
+    size_t sendSegmented(const HostAddress& host, const void* data, size_t len, uint16_t segmentSize);
+
+    /**
+     * Send a large buffer as a run of equal-sized datagrams to the associated host.
+     * @see sendSegmented(const HostAddress&, const void*, size_t, uint16_t)
+     * @see connect()
+     */
+    size_t sendSegmented(const void* data, size_t len, uint16_t segmentSize);
+
+    /**
+     * Allow the kernel to coalesce incoming datagrams (UDP_GRO).
+     * With this enabled on Linux, a run of same-sized datagrams from one sender may be delivered
+     * as a single read, which recvSegmented() reports along with the segment size. Ordinary
+     * receives would see the datagrams glued together, so use recvSegmented() while this is on.
+     * Throws on platforms without receive offload.
+     * @param enable Set true to allow coalescing; false to turn it back off.
+     */
+    void setReceiveOffload(bool enable);
+
+    /**
+     * Read an incoming datagram, or a run of datagrams coalesced by receive offload.
+     * Segment 'i' occupies bytes [i * segmentSize, (i + 1) * segmentSize) of the buffer, with
+     * the last segment possibly shorter. A lone datagram is reported as one segment. All
+     * segments of one read come from the same sender.
+     * @see setReceiveOffload()
+     * @param buffer Where to store the data. 64 KiB holds the largest coalesced read.
+     * @param len The capacity of 'buffer'.
+     * @param from Set to the address of the sender. It is left unchanged if nothing was read.
+     * @param segmentSize Set to the size of each segment.
+     * @return The total number of bytes stored. In non-blocking mode zero indicates that nothing was pending.
+     */
+    size_t recvSegmented(void* buffer, size_t len, HostAddress& from, size_t& segmentSize);
+
     /**
     * Indicates whether or not the socket is in blocking mode.
     * @see setBlocking()
@@ -190,13 +384,21 @@ namespace SSocks {
 
 
   private:
-    SSocks::Utility::Winsock wsa;
-
     int sock;
     bool blocking;
     bool connected;
+    bool v6; //an IPv6 (dual-stack) socket, which needs IPv4 destinations mapped
+    SocketOptions options;
+    SocketMetrics metrics;
+
+    size_t recvDatagram(void* buffer, size_t len, sockaddr_storage* from, int flags = 0);
+    const HostAddress& reachable(const HostAddress& host, HostAddress& mapped) const;
+    size_t sendSegments(const sockaddr* to, size_t toLen, const char* data, size_t len, uint16_t segmentSize);
 
     template<class T> friend std::vector<T*> select(const std::vector<T*>& sockets, float timeoutSeconds);
+    friend class Poller;
+    friend class IOUring;
+    friend class EventLoop;
 
   };
 
@@ -0,0 +1,201 @@
+#include "cl_WorkerPool.h"
+#include <deque>
+#include <stdexcept>
+#include <thread>
+
+//Each worker has two queues. 'shared' is fed at the back and served in order from the front by
+//its owner, while thieves take from the back. (Serving the owner LIFO would be friendlier to the
+//cache, but a requeued connection would then go straight back to the head of the line and
+//starve everything behind it.) 'pinned' holds affinity-mode connections, which only the owner
+//may run. The owner serves the two queues together in arrival order, by ticket.
+struct SSocks::WorkerPool::Worker {
+  std::mutex mutex;
+  std::deque<Job> shared;
+  std::deque<Job> pinned;
+  uint64_t nextTicket = 0;
+  std::thread thread;
+};
+
+namespace {
+  //lets dispatch() notice that it's being called from one of the pool's own workers
+  thread_local const SSocks::WorkerPool* currentPool = nullptr;
+  thread_local size_t currentWorker = 0;
+}
+
+SSocks::WorkerPool::WorkerPool(ConnectionHandler handler, size_t workerCount, bool affinity) :
+  handler(std::move(handler)), affinity(affinity), queued(0), epoch(0), nextWorker(0), stopping(false) {
+  if(workerCount == 0) { workerCount = std::thread::hardware_concurrency(); }
+  if(workerCount == 0) { workerCount = 1; } //hardware_concurrency() may not know
+
+  for(size_t i = 0; i < workerCount; i++) { workers.emplace_back(new Worker); }
+
+  //threads are started only after every queue exists, since any of them may steal from any other
+  for(size_t i = 0; i < workerCount; i++) {
+    workers[i]->thread = std::thread(&WorkerPool::workerMain, this, i);
+  }
+}
+
+SSocks::WorkerPool::~WorkerPool() {
+  stop();
+}
+
+void SSocks::WorkerPool::dispatch(TCPSocket sock) {
+  std::shared_ptr<TCPSocket> shared(new TCPSocket(std::move(sock)));
+
+  Job job;
+  job.sock = shared;
+  job.run = [this, shared](size_t self) { runConnection(shared, self); };
+  push(pickWorker(), std::move(job), false);
+}
+
+void SSocks::WorkerPool::post(Task task) {
+  Job job;
+  job.run = std::move(task);
+  push(pickWorker(), std::move(job), false);
+}
+
+void SSocks::WorkerPool::setErrorCallback(ErrorCallback onError) {
+  std::lock_guard<std::mutex> lock(errorMutex);
+  this->onError = std::move(onError);
+}
+
+size_t SSocks::WorkerPool::pickWorker() {
+  if(currentPool == this) { return currentWorker; }
+  return nextWorker++ % workers.size();
+}
+
+void SSocks::WorkerPool::push(size_t worker, Job job, bool pinned) {
+  //Workers only exit once 'stopping' is set and 'queued' is zero, both checked under the sleep
+  //lock, so counting the job here first means it can't be left behind by a stop in progress.
+  //Once stopping, only the workers themselves (which are still running) may add work.
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    if(stopping && currentPool != this) { throw std::runtime_error("Attempted to queue work on a stopped WorkerPool."); }
+    queued++;
+  }
+
+  {
+    Worker& target = *workers[worker];
+    std::lock_guard<std::mutex> lock(target.mutex);
+    job.ticket = target.nextTicket++;
+    if(pinned) { target.pinned.push_back(std::move(job)); }
+    else { target.shared.push_back(std::move(job)); }
+  }
+
+  //Bumping the epoch under the sleep lock means a worker can't check it, miss this job, and
+  //then go to sleep after our notify has already happened.
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    epoch++;
+  }
+  //a pinned job can only be run by its owner, so everyone has to hear about it
+  if(pinned) { wake.notify_all(); }
+  else { wake.notify_one(); }
+}
+
+bool SSocks::WorkerPool::take(size_t self, Job& job) {
+  //own queues first, taking whichever front job arrived earlier
+  {
+    Worker& mine = *workers[self];
+    std::lock_guard<std::mutex> lock(mine.mutex);
+    bool usePinned = !mine.pinned.empty() &&
+      (mine.shared.empty() || mine.pinned.front().ticket < mine.shared.front().ticket);
+    std::deque<Job>& queue = usePinned ? mine.pinned : mine.shared;
+    if(!queue.empty()) {
+      job = std::move(queue.front());
+      queue.pop_front();
+      return true;
+    }
+  }
+
+  //then steal the newest job from someone else, starting with our neighbor
+  for(size_t i = 1; i < workers.size(); i++) {
+    Worker& victim = *workers[(self + i) % workers.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if(!victim.shared.empty()) {
+      job = std::move(victim.shared.back());
+      victim.shared.pop_back();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void SSocks::WorkerPool::workerMain(size_t self) {
+  currentPool = this;
+  currentWorker = self;
+
+  Job job;
+  while(true) {
+    uint64_t seen = epoch;
+    if(take(self, job)) {
+      //Idle workers wait out a stop until the queues are empty, so tell them when that happens.
+      //Taking the lock means one can't check 'queued' and then sleep through the notify.
+      if(--queued == 0 && stopping) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_all();
+      }
+      try { job.run(self); }
+      catch(...) { reportError(std::current_exception(), self); }
+      job = Job();
+      continue;
+    }
+
+    //nothing to do here, so sleep until something is queued
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    if(stopping && queued == 0) { break; }
+    //Work that exists but can't be taken (another worker's pinned jobs) shouldn't make us spin,
+    //so rather than checking 'queued' we wait for a push that happened after our failed take,
+    //or for a stop once everything has been taken.
+    wake.wait(lock, [&]() { return epoch != seen || (stopping && queued == 0); });
+  }
+}
+
+void SSocks::WorkerPool::runConnection(const std::shared_ptr<TCPSocket>& sock, size_t self) {
+  bool again;
+  try { again = handler(*sock, self); }
+  catch(...) {
+    //the connection may be part way through a request, so it can't be served again
+    sock->close();
+    throw;
+  }
+
+  //a connection that wants more processing goes back to this worker's queue
+  if(again && sock->isOpen() && !stopping) {
+    Job job;
+    job.sock = sock;
+    job.run = [this, sock](size_t worker) { runConnection(sock, worker); };
+    push(self, std::move(job), affinity);
+  }
+}
+
+void SSocks::WorkerPool::reportError(std::exception_ptr error, size_t self) {
+  //copied out so that the callback runs without the lock, and can't stall other workers' errors
+  ErrorCallback callback;
+  {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    callback = onError;
+  }
+  if(callback) { callback(error, self); }
+}
+
+void SSocks::WorkerPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping = true;
+  }
+  wake.notify_all();
+
+  for(auto& worker : workers) {
+    if(worker->thread.joinable()) { worker->thread.join(); }
+  }
+}
+
+size_t SSocks::WorkerPool::size() const {
+  return workers.size();
+}
+
+size_t SSocks::WorkerPool::pending() const {
+  return queued;
+}
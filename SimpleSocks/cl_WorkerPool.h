@@ -0,0 +1,134 @@
+/** @file */
+#pragma once
+#include <functional>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cstdint>
+#include "cl_TCPSocket.h"
+
+namespace SSocks {
+
+  /**
+   * Thread pool for processing accepted connections, with work stealing.
+   * Every worker has its own queue, served in order. dispatch() hands connections to the workers
+   * in turn, and a worker that runs out of work takes jobs from the far end of a busy worker's
+   * queue, so one long request doesn't hold up the short ones queued behind it.\n
+   * The connection handler may ask for a connection to be queued again (for instance after
+   * serving one request on a keep-alive connection). In affinity mode a requeued connection is
+   * kept on the worker that last handled it and is never stolen, which keeps its state warm in
+   * that core's cache.\n
+   * A handler or task that throws doesn't take its worker down. The exception is handed to the
+   * error callback (see setErrorCallback()), and a connection whose handler threw is closed and
+   * released, since it may have been left part way through a request.
+   */
+  class WorkerPool {
+  public:
+    /**
+     * Callback that processes a connection on a worker thread.
+     * @param sock The connection. It stays owned by the pool.
+     * @param worker The index of the worker running the callback.
+     * @return true to queue the connection again for more processing; false to release it,
+     * which closes it unless the handler moved it elsewhere.
+     */
+    typedef std::function<bool(TCPSocket& sock, size_t worker)> ConnectionHandler;
+
+    //! A general job to run on a worker thread. It receives the index of the worker running it.
+    typedef std::function<void(size_t worker)> Task;
+
+    /**
+     * Callback invoked on a worker thread when a connection handler or task throws.
+     * @param error The exception, which can be examined with std::rethrow_exception().
+     * @param worker The index of the worker that caught it.
+     */
+    typedef std::function<void(std::exception_ptr error, size_t worker)> ErrorCallback;
+
+    /**
+     * Start the worker threads.
+     * @param handler Invoked for each dispatched connection.
+     * @param workers The number of worker threads. Zero uses one per hardware thread.
+     * @param affinity Whether requeued connections stay on the worker that last handled them.
+     */
+    explicit WorkerPool(ConnectionHandler handler, size_t workers = 0, bool affinity = false);
+
+    //! Copying is prohibited, as the pool owns its threads.
+    WorkerPool(const WorkerPool&) = delete;
+
+    //! Copying is prohibited, as the pool owns its threads.
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    //! Destructor. Calls stop().
+    ~WorkerPool();
+
+    /**
+     * Hand a connection to the pool.
+     * Called from a worker thread the connection joins that worker's own queue; otherwise the
+     * workers take turns. This is safe to call from any thread.
+     * @throw std::runtime_error if stop() has been called, unless called from one of the pool's
+     * own workers while it finishes the queued work. The connection is closed in that case.
+     */
+    void dispatch(TCPSocket sock);
+
+    /**
+     * Queue a general job. This is safe to call from any thread.
+     * @throw std::runtime_error if stop() has been called, unless called from one of the pool's
+     * own workers while it finishes the queued work. The job is discarded in that case.
+     */
+    void post(Task task);
+
+    /**
+     * Set the callback for exceptions thrown by the connection handler or by tasks. Without
+     * one, such exceptions are discarded. The callback must not throw. This is safe to call from
+     * any thread.
+     */
+    void setErrorCallback(ErrorCallback onError);
+
+    /**
+     * Finish all queued work and join the threads.
+     * Connections that keep asking to be requeued are released once the pool is stopping.
+     */
+    void stop();
+
+    //! Return the number of worker threads.
+    size_t size() const;
+
+    //! Return the number of jobs waiting to run.
+    size_t pending() const;
+
+  private:
+    struct Job {
+      Task run;
+      std::shared_ptr<TCPSocket> sock; //set for connection jobs, so they can be requeued
+      uint64_t ticket = 0; //arrival order within its worker, so pinned and shared jobs are served fairly
+    };
+    struct Worker;
+
+    ConnectionHandler handler;
+    bool affinity;
+
+    //guarded, since it may be set while the workers are running
+    std::mutex errorMutex;
+    ErrorCallback onError;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    //idle workers sleep here until a job is queued
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> queued;
+    std::atomic<uint64_t> epoch; //bumped on every push so sleepers can tell they missed one
+    std::atomic<size_t> nextWorker;
+    std::atomic<bool> stopping;
+
+    void push(size_t worker, Job job, bool pinned);
+    bool take(size_t self, Job& job);
+    void workerMain(size_t self);
+    void runConnection(const std::shared_ptr<TCPSocket>& sock, size_t self);
+    void reportError(std::exception_ptr error, size_t self);
+    size_t pickWorker();
+
+  };
+
+}
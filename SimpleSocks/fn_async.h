@@ -0,0 +1,227 @@
+/** @file */
+#pragma once
+#include "ns_Utility.h"
+
+//Coroutines need C++20; see SSOCKS_HAS_COROUTINES in ns_Utility.h.
+#ifdef SSOCKS_HAS_COROUTINES
+#include <exception>
+#include <utility>
+#include <cstddef>
+#include "cl_EventLoop.h"
+#include "cl_TCPSocket.h"
+#include "cl_TCPServer.h"
+#include "cl_UDPSocket.h"
+#include "cl_HostAddress.h"
+#include "cl_Task.h"
+
+namespace SSocks {
+  namespace Utility {
+
+    /**
+     * Awaitable that retries a non-blocking operation each time a socket becomes ready.
+     * Users should not need to make use of this class directly.
+     * The operation is tried at once, so a co_await that can complete without waiting never
+     * suspends. Otherwise the coroutine is suspended, and the EventLoop resumes it once the
+     * operation has succeeded or failed. 'Op' is called with the socket and returns true when
+     * the operation is finished; its result() is what the co_await yields.
+     */
+    template<class Sock, class Op, bool WRITE> class ReadyAwaitable {
+    public:
+      ReadyAwaitable(EventLoop& loop, Sock& sock, Op op) : loop(loop), sock(sock), op(std::move(op)) {}
+
+      bool await_ready() { return attempt(); }
+
+      void await_suspend(std::coroutine_handle<> awaiter) {
+        handle = awaiter;
+        wait();
+      }
+
+      decltype(auto) await_resume() {
+        if(error) { std::rethrow_exception(error); }
+        return op.result();
+      }
+
+    private:
+      EventLoop& loop;
+      Sock& sock;
+      Op op;
+      std::coroutine_handle<> handle;
+      std::exception_ptr error;
+
+      //failures are kept for await_resume(), so they come out of the co_await
+      bool attempt() {
+        try {
+          if(sock.isOpen() && sock.isBlocking()) { sock.setBlocking(false); }
+          return op(sock);
+        }
+        catch(...) {
+          error = std::current_exception();
+          return true;
+        }
+      }
+
+      void wait() {
+        auto onReady = [this]() {
+          if(!attempt()) {
+            try {
+              wait();
+              return;
+            }
+            catch(...) { error = std::current_exception(); }
+          }
+          handle.resume(); //the coroutine may finish and destroy this, so nothing follows
+        };
+        if constexpr(WRITE) { loop.waitWritable(sock, std::move(onReady)); }
+        else { loop.waitReadable(sock, std::move(onReady)); }
+      }
+
+    };
+
+    struct AsyncRecv {
+      void* buffer;
+      size_t len;
+      size_t got;
+
+      bool operator()(TCPSocket& sock) {
+        if(len == 0) { return true; }
+        got = sock.recvSome(buffer, len);
+        return got > 0 || !sock.isOpen(); //nothing read and still open means nothing was ready
+      }
+      size_t result() { return got; }
+    };
+
+    struct AsyncSend {
+      const char* data;
+      size_t len;
+      size_t sent;
+
+      bool operator()(TCPSocket& sock) {
+        sent += sock.send(data + sent, len - sent);
+        return sent == len;
+      }
+      size_t result() { return sent; }
+    };
+
+    struct AsyncConnect {
+      HostAddress host;
+      bool started;
+
+      bool operator()(TCPSocket& sock) {
+        if(!started) {
+          started = true;
+          return sock.beginConnect(host);
+        }
+        sock.finishConnect();
+        return true;
+      }
+      void result() {}
+    };
+
+    struct AsyncAccept {
+      TCPSocket client;
+
+      bool operator()(TCPServer& server) {
+        client = server.acceptPending();
+        return client.isOpen();
+      }
+      TCPSocket result() { return std::move(client); }
+    };
+
+    struct AsyncRecvFrom {
+      void* buffer;
+      size_t len;
+      HostAddress* from;
+      size_t got;
+
+      //A sender never has port zero, so an unchanged 'from' tells "nothing pending" apart from
+      //an empty datagram.
+      bool operator()(UDPSocket& sock) {
+        *from = HostAddress();
+        got = sock.recvFrom(buffer, len, *from);
+        return got > 0 || from->getPort() != 0;
+      }
+      size_t result() { return got; }
+    };
+
+  }
+
+  /**
+   * Receive whatever is available, up to 'len' bytes, suspending the coroutine until some
+   * data arrives. This is recvSome() for coroutines.
+   * The functions in this file must be awaited from a coroutine (such as a Task) whose
+   * resumption is driven by 'loop', by running it with EventLoop::run() or runOnce(). The
+   * socket is set to non-blocking mode. Only one read and one write may be in progress on a
+   * socket at a time, the socket can't also be watched with EventLoop::watch(), and it must
+   * not be closed or destroyed while an operation on it is suspended.
+   * This is only available when compiling as C++20 or later.
+   * @param loop The loop that will resume the coroutine.
+   * @param sock A connected socket.
+   * @param buffer Where to store the data. It must have room for 'len' bytes.
+   * @param len The maximum number of bytes to read.
+   * @return Awaitable yielding the number of bytes read. Zero means the remote host closed the
+   * connection (and the socket has closed itself). A failure is thrown as std::runtime_error.
+   */
+  inline auto asyncRecv(EventLoop& loop, TCPSocket& sock, void* buffer, size_t len) {
+    return Utility::ReadyAwaitable<TCPSocket, Utility::AsyncRecv, false>(loop, sock, Utility::AsyncRecv{ buffer, len, 0 });
+  }
+
+  /**
+   * Send all of 'len' bytes, suspending the coroutine whenever the outbound buffer is full.
+   * @see asyncRecv() for the rules shared by every async function.
+   * @param loop The loop that will resume the coroutine.
+   * @param sock A connected socket.
+   * @param data The data to send. It must stay valid until the co_await completes.
+   * @param len The number of bytes to send.
+   * @return Awaitable yielding the number of bytes sent, which is always 'len'. A failure is
+   * thrown as std::runtime_error.
+   */
+  inline auto asyncSend(EventLoop& loop, TCPSocket& sock, const void* data, size_t len) {
+    return Utility::ReadyAwaitable<TCPSocket, Utility::AsyncSend, true>(loop, sock, Utility::AsyncSend{ reinterpret_cast<const char*>(data), len, 0 });
+  }
+
+  /**
+   * Connect to a host, suspending the coroutine until the connection is made.
+   * Any existing connection is closed first. The socket is left in non-blocking mode.
+   * @see asyncRecv() for the rules shared by every async function.
+   * @see TCPSocket::beginConnect()
+   * @param loop The loop that will resume the coroutine.
+   * @param sock The socket to connect. Its options are applied as with connect().
+   * @param host The host and port to connect to.
+   * @return Awaitable yielding nothing. A failure is thrown as std::runtime_error.
+   */
+  inline auto asyncConnect(EventLoop& loop, TCPSocket& sock, const HostAddress& host) {
+    return Utility::ReadyAwaitable<TCPSocket, Utility::AsyncConnect, true>(loop, sock, Utility::AsyncConnect{ host, false });
+  }
+
+  /**
+   * Accept an incoming connection, suspending the coroutine until one arrives.
+   * The server is set to non-blocking mode; the accepted socket is in blocking mode, as with
+   * accept(), until it's used with one of these functions.
+   * @see asyncRecv() for the rules shared by every async function.
+   * @param loop The loop that will resume the coroutine.
+   * @param server A started server.
+   * @return Awaitable yielding the connected TCPSocket. A failure is thrown as std::runtime_error.
+   */
+  inline auto asyncAccept(EventLoop& loop, TCPServer& server) {
+    return Utility::ReadyAwaitable<TCPServer, Utility::AsyncAccept, false>(loop, server, Utility::AsyncAccept());
+  }
+
+  /**
+   * Receive a datagram, suspending the coroutine until one arrives.
+   * A datagram longer than 'len' is truncated, and the rest of it is lost.
+   * @see asyncRecv() for the rules shared by every async function.
+   * @param loop The loop that will resume the coroutine.
+   * @param sock An open socket.
+   * @param buffer Where to store the datagram. It must have room for 'len' bytes.
+   * @param len The capacity of 'buffer'.
+   * @param from Set to the address of the sender. It must stay valid until the co_await completes.
+   * @return Awaitable yielding the number of bytes stored, which is zero for an empty datagram.
+   * A failure is thrown as std::runtime_error.
+   */
+  inline auto asyncRecvFrom(EventLoop& loop, UDPSocket& sock, void* buffer, size_t len, HostAddress& from) {
+    return Utility::ReadyAwaitable<UDPSocket, Utility::AsyncRecvFrom, false>(loop, sock, Utility::AsyncRecvFrom{ buffer, len, &from, 0 });
+  }
+
+}
+
+#endif
@@ -1,5 +1,5 @@
 #include "fn_select.h"
-#include <WS2tcpip.h>
+#include "ns_Platform.h"
 
 const float SSocks::SELECT_FOREVER = -1.0f;
 
@@ -29,21 +29,29 @@ std::vector<T*> SSocks::select(const std::vector<T*>& sockets, float timeoutSeco
   }
 
   //populate the fd_set from the provided vector
-  fd_set set = {0};
+  //POSIX select() needs the highest descriptor plus one (Winsock ignores this argument)
+  fd_set set;
+  FD_ZERO(&set);
+  int maxSock = -1;
   for(auto sock : sockets) {
     if(sock->isOpen()) {
+      #ifndef _WIN32
+      //a POSIX fd_set is a bitmask, so descriptors past its end can't be represented
+      if(sock->sock >= FD_SETSIZE) { throw std::runtime_error("Socket descriptor exceeds FD_SETSIZE in SSocks::select()."); }
+      #endif
       FD_SET(sock->sock, &set);
+      if(sock->sock > maxSock) { maxSock = sock->sock; }
     }
   }
 
   //perform the selection - this removes non-ready sockets from the fd_set
-  int result = ::select(0, &set, nullptr, nullptr, tvp);
-  if(result == SOCKET_ERROR) { throw std::runtime_error(SSocks::Utility::lastErrStr(WSAGetLastError())); }
+  int result = ::select(maxSock + 1, &set, nullptr, nullptr, tvp);
+  if(result == Utility::Platform::SOCK_ERROR) { throw std::runtime_error(SSocks::Utility::lastErrStr(Utility::Platform::lastError())); }
 
   //fill the result vector based on the results
   std::vector<T*> pending;
   for(auto sock : sockets) {
-    if(FD_ISSET(sock->sock, &set)) {
+    if(sock->isOpen() && FD_ISSET(sock->sock, &set)) {
       pending.push_back(sock);
     }
   }
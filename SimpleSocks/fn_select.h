@@ -18,7 +18,8 @@ namespace SSocks {
    * read or accept from. The use of this function is to wait on a group of sockets until one or more
    * of them has incoming information to be processed. This function blocks for the amount of time
    * specified by 'timeoutSeconds' but will return immediately as soon as one or more sockets indicates
-   * that it is ready.
+   * that it is ready.\n
+   * For large or mixed groups of sockets, or to wait for writability, use SSocks::Poller instead.
    * 
    * @param sockets A vector of pointers to the sockets you want to check
    * @param timeoutSeconds The maximum number of seconds to wait before giving up.
@@ -0,0 +1,195 @@
+/** @file */
+#pragma once
+#include <string>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+#include "ns_Utility.h"
+#include "cl_BufferView.h"
+
+//This header pulls in the native socket API, so it must only be included from SimpleSocks
+//source files. The public headers deliberately avoid it so that <WS2tcpip.h> or the POSIX
+//socket headers don't leak into user code.
+
+#ifdef _WIN32
+#include <WS2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#endif
+
+namespace SSocks {
+  namespace Utility {
+    /**
+     * Thin layer over the native socket API.
+     * Users should not need to make use of these functions directly.
+     * Everything that differs between Winsock and POSIX sockets lives behind this namespace
+     * so that the socket classes themselves can be written once. Each platform gets its own
+     * implementation file (ns_Platform_Win32.cpp and ns_Platform_Posix.cpp).
+     */
+    namespace Platform {
+
+      //! Value used to indicate that a socket member does not hold a live socket.
+      const int INVALID_SOCK = -1;
+
+      //! Return value of a failed socket call. (SOCKET_ERROR on Windows, -1 on POSIX.)
+      const int SOCK_ERROR = -1;
+
+      //! Flags passed to every send call. On Linux this suppresses SIGPIPE on a dead peer.
+      #if defined(MSG_NOSIGNAL)
+      const int SEND_FLAGS = MSG_NOSIGNAL;
+      #else
+      const int SEND_FLAGS = 0;
+      #endif
+
+      //! Flag that makes a single receive or send call non-blocking, where the system has one.
+      #if defined(MSG_DONTWAIT)
+      const int NO_WAIT = MSG_DONTWAIT;
+      #else
+      const int NO_WAIT = 0;
+      #endif
+
+      #ifdef _WIN32
+      //! Winsock takes int lengths where POSIX takes socklen_t.
+      typedef int AddrLen;
+      #else
+      //! Winsock takes int lengths where POSIX takes socklen_t.
+      typedef socklen_t AddrLen;
+      #endif
+
+      /**
+       * Make sure the socket library is ready for use.
+       * On Windows this calls WSAStartup() exactly once per process (and WSACleanup() at exit),
+       * rather than once per socket object. On POSIX systems it does nothing.
+       */
+      void startup();
+
+      //! Return the error code of the last failed socket call on this thread.
+      int lastError();
+
+      //! Return true if 'code' indicates that a non-blocking call had nothing to do.
+      bool wouldBlock(int code);
+
+      //! Return true if 'code' indicates that a blocking call was cut short by a signal.
+      bool interrupted(int code);
+
+      //! Return true if 'code' indicates that a non-blocking connect() has started but not finished.
+      bool connectPending(int code);
+
+      /**
+       * Return true if 'code' from accept() only concerns the one connection it was taking, such
+       * as a handshake the client abandoned, so that the next connection may be accepted normally.
+       */
+      bool acceptAborted(int code);
+
+      //! Return true if 'code' indicates that the process or system has run out of sockets or buffers.
+      bool outOfResources(int code);
+
+      /**
+       * Find out how a non-blocking connect() ended, once the socket has become writable.
+       * @return Zero if the connection was made, otherwise the error code it failed with.
+       */
+      int connectResult(int sock);
+
+      /**
+       * Create a socket of the indicated type and protocol.
+       * On Linux the close-on-exec flag is set atomically at creation.
+       * @return The new socket, or INVALID_SOCK on failure.
+       */
+      int openSocket(int family, int type, int proto);
+
+      /**
+       * Accept a pending connection from a listening socket.
+       * On Linux this uses accept4() so that close-on-exec costs no extra syscall.
+       * @return The new socket, or INVALID_SOCK on failure.
+       */
+      int acceptSocket(int sock, sockaddr* addr, AddrLen* addrLen);
+
+      //! Release a socket.
+      void closeSocket(int sock);
+
+      /**
+       * Switch a socket between blocking and non-blocking mode.
+       * @return true on success; false on failure (check lastError()).
+       */
+      bool setBlocking(int sock, bool block);
+
+      /**
+       * Dissolve the association of a 'connected' UDP socket.
+       * @return true on success; false on failure (check lastError()).
+       */
+      bool dissociate(int sock);
+
+      /**
+       * Wait for events on an array of pollfd structures. (WSAPoll() on Windows.)
+       * @return The number of ready entries, zero on timeout, or SOCK_ERROR.
+       */
+      int poll(pollfd* fds, size_t count, int timeoutMs);
+
+      //! The most buffers sendv() and recvv() pass to the system per call.
+      const size_t MAX_IOV = 64;
+
+      /**
+       * Gather-send from an array of buffers in one call. (sendmsg() or WSASend().)
+       * At most MAX_IOV buffers are used; the rest are left for the next call.
+       * @param skip The number of bytes at the start of buffers[0] that were already sent.
+       * @return The number of bytes sent, or SOCK_ERROR.
+       */
+      std::ptrdiff_t sendv(int sock, const ConstBuffer* buffers, size_t count, size_t skip);
+
+      /**
+       * Scatter-recieve into an array of buffers in one call. (recvmsg() or WSARecv().)
+       * At most MAX_IOV buffers are used.
+       * @param skip The number of bytes at the start of buffers[0] that were already filled.
+       * @return The number of bytes recieved, zero if the remote host closed the connection, or SOCK_ERROR.
+       */
+      std::ptrdiff_t recvv(int sock, const MutableBuffer* buffers, size_t count, size_t skip);
+
+      //! Returned by sendFile() when the kernel can't send from this file, so it must be copied instead.
+      const std::ptrdiff_t NO_SENDFILE = -2;
+
+      /**
+       * Send part of a file straight from the kernel, without copying it through user memory.
+       * (sendfile() on Linux.) The file's own position is not changed.
+       * @return The number of bytes sent (zero at end of file), SOCK_ERROR, or NO_SENDFILE.
+       */
+      std::ptrdiff_t sendFile(int sock, int fd, uint64_t offset, size_t count);
+
+      /**
+       * Open a file for reading.
+       * @return The file descriptor, or -1 on failure.
+       */
+      int openFile(const std::string& path);
+
+      //! Close a file opened with openFile().
+      void closeFile(int fd);
+
+      /**
+       * Find the size of an open file.
+       * @return The size in bytes, or -1 on failure.
+       */
+      int64_t fileSize(int fd);
+
+      /**
+       * Read from an open file at the indicated offset.
+       * On POSIX systems the file's own position is not changed. On Windows it is.
+       * @return The number of bytes read (zero at end of file), or -1 on failure.
+       */
+      std::ptrdiff_t readFile(int fd, void* buffer, size_t len, uint64_t offset);
+
+      //! Return the explanation of a getaddrinfo() error code.
+      std::string gaiErrStr(int code);
+
+    }
+  }
+}
@@ -0,0 +1,180 @@
+#ifndef _WIN32
+#include "ns_Platform.h"
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+void SSocks::Utility::Platform::startup() {
+  //POSIX sockets need no library initialization
+}
+
+int SSocks::Utility::Platform::lastError() {
+  return errno;
+}
+
+bool SSocks::Utility::Platform::wouldBlock(int code) {
+  //EAGAIN and EWOULDBLOCK are the same value on Linux, but POSIX allows them to differ
+  return code == EAGAIN || code == EWOULDBLOCK;
+}
+
+bool SSocks::Utility::Platform::interrupted(int code) {
+  return code == EINTR;
+}
+
+bool SSocks::Utility::Platform::connectPending(int code) {
+  return code == EINPROGRESS;
+}
+
+bool SSocks::Utility::Platform::acceptAborted(int code) {
+  switch(code) {
+    case ECONNABORTED:
+    case EPROTO:
+    case EINTR:
+    case EPERM: //refused by a firewall rule
+    //Linux hands errors already pending on the new connection back from accept()
+    case ENETDOWN:
+    case ENETUNREACH:
+    case EHOSTDOWN:
+    case EHOSTUNREACH:
+    case ENOPROTOOPT:
+    case EOPNOTSUPP:
+    #ifdef ENONET
+    case ENONET:
+    #endif
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool SSocks::Utility::Platform::outOfResources(int code) {
+  return code == EMFILE || code == ENFILE || code == ENOBUFS || code == ENOMEM;
+}
+
+int SSocks::Utility::Platform::connectResult(int sock) {
+  int err = 0;
+  socklen_t len = sizeof(err);
+  if(getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len)) { return errno; }
+  return err;
+}
+
+int SSocks::Utility::Platform::openSocket(int family, int type, int proto) {
+  #ifdef SOCK_CLOEXEC
+  //set close-on-exec atomically instead of following up with fcntl()
+  return ::socket(family, type | SOCK_CLOEXEC, proto);
+  #else
+  int sock = ::socket(family, type, proto);
+  if(sock != INVALID_SOCK) { fcntl(sock, F_SETFD, FD_CLOEXEC); }
+  return sock;
+  #endif
+}
+
+int SSocks::Utility::Platform::acceptSocket(int sock, sockaddr* addr, AddrLen* addrLen) {
+  #ifdef __linux__
+  //accept4() lets us set close-on-exec without a second syscall
+  return ::accept4(sock, addr, addrLen, SOCK_CLOEXEC);
+  #else
+  int nuSock = ::accept(sock, addr, addrLen);
+  if(nuSock != INVALID_SOCK) { fcntl(nuSock, F_SETFD, FD_CLOEXEC); }
+  return nuSock;
+  #endif
+}
+
+void SSocks::Utility::Platform::closeSocket(int sock) {
+  ::close(sock);
+}
+
+bool SSocks::Utility::Platform::setBlocking(int sock, bool block) {
+  int flags = fcntl(sock, F_GETFL, 0);
+  if(flags == -1) { return false; }
+
+  flags = block ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+  return fcntl(sock, F_SETFL, flags) != -1;
+}
+
+bool SSocks::Utility::Platform::dissociate(int sock) {
+  //connecting to an AF_UNSPEC address dissolves a UDP association
+  sockaddr sa = { 0 };
+  sa.sa_family = AF_UNSPEC;
+  if(::connect(sock, &sa, sizeof(sa)) == 0) { return true; }
+  //some BSDs report EAFNOSUPPORT even though the association was removed
+  return errno == EAFNOSUPPORT;
+}
+
+int SSocks::Utility::Platform::poll(pollfd* fds, size_t count, int timeoutMs) {
+  return ::poll(fds, static_cast<nfds_t>(count), timeoutMs);
+}
+
+std::ptrdiff_t SSocks::Utility::Platform::sendv(int sock, const ConstBuffer* buffers, size_t count, size_t skip) {
+  iovec iov[MAX_IOV];
+  size_t n = count < MAX_IOV ? count : MAX_IOV;
+  for(size_t i = 0; i < n; i++) {
+    iov[i].iov_base = const_cast<void*>(buffers[i].data);
+    iov[i].iov_len = buffers[i].size;
+  }
+  iov[0].iov_base = static_cast<char*>(iov[0].iov_base) + skip;
+  iov[0].iov_len -= skip;
+
+  //sendmsg() rather than writev(), since writev() can't suppress SIGPIPE
+  msghdr msg = {};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = n;
+  return ::sendmsg(sock, &msg, SEND_FLAGS);
+}
+
+std::ptrdiff_t SSocks::Utility::Platform::recvv(int sock, const MutableBuffer* buffers, size_t count, size_t skip) {
+  iovec iov[MAX_IOV];
+  size_t n = count < MAX_IOV ? count : MAX_IOV;
+  for(size_t i = 0; i < n; i++) {
+    iov[i].iov_base = buffers[i].data;
+    iov[i].iov_len = buffers[i].size;
+  }
+  iov[0].iov_base = static_cast<char*>(iov[0].iov_base) + skip;
+  iov[0].iov_len -= skip;
+
+  msghdr msg = {};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = n;
+  return ::recvmsg(sock, &msg, 0);
+}
+
+std::ptrdiff_t SSocks::Utility::Platform::sendFile(int sock, int fd, uint64_t offset, size_t count) {
+  #ifdef __linux__
+  off_t off = static_cast<off_t>(offset);
+  ssize_t sent = ::sendfile(sock, fd, &off, count);
+  //EINVAL and ENOSYS mean this kind of file (or this kernel) can't be sent directly
+  if(sent == -1 && (errno == EINVAL || errno == ENOSYS)) { return NO_SENDFILE; }
+  return sent;
+  #else
+  //BSD and macOS sendfile() have different signatures, so they copy for now
+  (void)sock; (void)fd; (void)offset; (void)count;
+  return NO_SENDFILE;
+  #endif
+}
+
+int SSocks::Utility::Platform::openFile(const std::string& path) {
+  return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+void SSocks::Utility::Platform::closeFile(int fd) {
+  ::close(fd);
+}
+
+int64_t SSocks::Utility::Platform::fileSize(int fd) {
+  struct stat st;
+  if(::fstat(fd, &st)) { return -1; }
+  return st.st_size;
+}
+
+std::ptrdiff_t SSocks::Utility::Platform::readFile(int fd, void* buffer, size_t len, uint64_t offset) {
+  return ::pread(fd, buffer, len, static_cast<off_t>(offset));
+}
+
+std::string SSocks::Utility::Platform::gaiErrStr(int code) {
+  //EAI_SYSTEM means the real reason is in errno
+  if(code == EAI_SYSTEM) { return lastErrStr(errno); }
+  return gai_strerror(code);
+}
+
+#endif
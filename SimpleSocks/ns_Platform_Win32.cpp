@@ -0,0 +1,156 @@
+#ifdef _WIN32
+#include "ns_Platform.h"
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+//link the winsock library
+#pragma comment(lib, "Ws2_32.lib")
+
+namespace {
+  //RAII object for Winsock itself. A single static instance of this is created the first time
+  //startup() is called, so WSAStartup() runs once per process and WSACleanup() runs at exit.
+  struct Winsock {
+    Winsock() {
+      WSADATA data;
+      int result = WSAStartup(MAKEWORD(2,2), &data);
+      if(result) { throw std::runtime_error(SSocks::Utility::lastErrStr(result)); }
+    }
+    ~Winsock() { WSACleanup(); }
+  };
+}
+
+void SSocks::Utility::Platform::startup() {
+  //function-local statics are initialized exactly once, even with multiple threads
+  static Winsock wsa;
+}
+
+int SSocks::Utility::Platform::lastError() {
+  return WSAGetLastError();
+}
+
+bool SSocks::Utility::Platform::wouldBlock(int code) {
+  return code == WSAEWOULDBLOCK;
+}
+
+bool SSocks::Utility::Platform::interrupted(int code) {
+  return code == WSAEINTR;
+}
+
+bool SSocks::Utility::Platform::connectPending(int code) {
+  //Winsock reports a connect in progress as an ordinary would-block
+  return code == WSAEWOULDBLOCK;
+}
+
+bool SSocks::Utility::Platform::acceptAborted(int code) {
+  return code == WSAECONNABORTED || code == WSAECONNRESET || code == WSAEINTR || code == WSAENETDOWN;
+}
+
+bool SSocks::Utility::Platform::outOfResources(int code) {
+  return code == WSAEMFILE || code == WSAENOBUFS;
+}
+
+int SSocks::Utility::Platform::connectResult(int sock) {
+  int err = 0;
+  int len = sizeof(err);
+  if(getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&err), &len)) { return WSAGetLastError(); }
+  return err;
+}
+
+int SSocks::Utility::Platform::openSocket(int family, int type, int proto) {
+  startup();
+  //Winsock handles are not inherited by CreateProcess() unless asked for, so there's no
+  //close-on-exec equivalent to worry about here.
+  SOCKET sock = ::socket(family, type, proto);
+  return sock == INVALID_SOCKET ? INVALID_SOCK : static_cast<int>(sock);
+}
+
+int SSocks::Utility::Platform::acceptSocket(int sock, sockaddr* addr, AddrLen* addrLen) {
+  SOCKET nuSock = ::accept(sock, addr, addrLen);
+  return nuSock == INVALID_SOCKET ? INVALID_SOCK : static_cast<int>(nuSock);
+}
+
+void SSocks::Utility::Platform::closeSocket(int sock) {
+  closesocket(sock);
+}
+
+bool SSocks::Utility::Platform::setBlocking(int sock, bool block) {
+  //I really hate all this legacy crap that tries to make one function do everything.
+  //It makes the interfaces really unpleasant.
+  unsigned long temp = block ? 0 : 1;
+  return ioctlsocket(sock, FIONBIO, &temp) != SOCKET_ERROR;
+}
+
+bool SSocks::Utility::Platform::dissociate(int sock) {
+  //connecting to an all-zero address removes the connection behavior
+  sockaddr_in sain = { 0 };
+  sain.sin_family = AF_INET;
+  return ::connect(sock, reinterpret_cast<sockaddr*>(&sain), sizeof(sain)) != SOCKET_ERROR;
+}
+
+int SSocks::Utility::Platform::poll(pollfd* fds, size_t count, int timeoutMs) {
+  return WSAPoll(fds, static_cast<ULONG>(count), timeoutMs);
+}
+
+std::ptrdiff_t SSocks::Utility::Platform::sendv(int sock, const ConstBuffer* buffers, size_t count, size_t skip) {
+  WSABUF bufs[MAX_IOV];
+  size_t n = count < MAX_IOV ? count : MAX_IOV;
+  for(size_t i = 0; i < n; i++) {
+    bufs[i].buf = static_cast<CHAR*>(const_cast<void*>(buffers[i].data));
+    bufs[i].len = static_cast<ULONG>(buffers[i].size);
+  }
+  bufs[0].buf += skip;
+  bufs[0].len -= static_cast<ULONG>(skip);
+
+  DWORD sent = 0;
+  if(WSASend(static_cast<SOCKET>(sock), bufs, static_cast<DWORD>(n), &sent, 0, nullptr, nullptr) == SOCKET_ERROR) { return SOCK_ERROR; }
+  return sent;
+}
+
+std::ptrdiff_t SSocks::Utility::Platform::recvv(int sock, const MutableBuffer* buffers, size_t count, size_t skip) {
+  WSABUF bufs[MAX_IOV];
+  size_t n = count < MAX_IOV ? count : MAX_IOV;
+  for(size_t i = 0; i < n; i++) {
+    bufs[i].buf = static_cast<CHAR*>(buffers[i].data);
+    bufs[i].len = static_cast<ULONG>(buffers[i].size);
+  }
+  bufs[0].buf += skip;
+  bufs[0].len -= static_cast<ULONG>(skip);
+
+  DWORD got = 0;
+  DWORD flags = 0;
+  if(WSARecv(static_cast<SOCKET>(sock), bufs, static_cast<DWORD>(n), &got, &flags, nullptr, nullptr) == SOCKET_ERROR) { return SOCK_ERROR; }
+  return got;
+}
+
+std::ptrdiff_t SSocks::Utility::Platform::sendFile(int, int, uint64_t, size_t) {
+  //TransmitFile() wants a Win32 handle and overlapped I/O, so files are copied for now
+  return NO_SENDFILE;
+}
+
+int SSocks::Utility::Platform::openFile(const std::string& path) {
+  return _open(path.c_str(), _O_RDONLY | _O_BINARY | _O_NOINHERIT);
+}
+
+void SSocks::Utility::Platform::closeFile(int fd) {
+  _close(fd);
+}
+
+int64_t SSocks::Utility::Platform::fileSize(int fd) {
+  struct _stat64 st;
+  if(_fstat64(fd, &st)) { return -1; }
+  return st.st_size;
+}
+
+std::ptrdiff_t SSocks::Utility::Platform::readFile(int fd, void* buffer, size_t len, uint64_t offset) {
+  //the CRT has no pread(), so this moves the file position
+  if(_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) == -1) { return -1; }
+  return _read(fd, buffer, static_cast<unsigned>(len));
+}
+
+std::string SSocks::Utility::Platform::gaiErrStr(int code) {
+  //getaddrinfo() reports ordinary WSA error codes on Windows
+  return lastErrStr(code);
+}
+
+#endif
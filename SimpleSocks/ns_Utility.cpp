@@ -1,11 +1,14 @@
 #include "ns_Utility.h"
-#include <WS2tcpip.h>
-
-//link the winsock library
-#pragma comment(lib, "Ws2_32.lib")
+#include "ns_Platform.h"
+#include "cl_Deadline.h"
+#include <stdexcept>
+#ifndef _WIN32
+#include <system_error>
+#endif
 
 /////////////////////////LASTERRSTR/////////////////////////
 
+#ifdef _WIN32
 std::string SSocks::Utility::lastErrStr(int code) {
   //creating a large buffer for the message
   std::string msg;
@@ -27,30 +30,29 @@ std::string SSocks::Utility::lastErrStr(int code) {
 
   return msg;
 }
-
-
-/////////////////////////WINSOCK/////////////////////////
-
-SSocks::Utility::Winsock::Winsock() {
-  WSAStartup(MAKEWORD(2,2), &WSAData());
-}
-
-SSocks::Utility::Winsock::~Winsock() {
-  WSACleanup();
+#else
+std::string SSocks::Utility::lastErrStr(int code) {
+  //the standard library already knows how to describe errno values (thread-safely, unlike strerror)
+  return std::system_category().message(code);
 }
+#endif
 
 
 /////////////////////////TSOCK/////////////////////////
 
 //generate socket and check for errors
-SSocks::Utility::TSock::TSock(int type, int proto) : sock(::socket(AF_INET, type, proto)) {
-  if(sock == SOCKET_ERROR) { throw std::runtime_error(lastErrStr(WSAGetLastError())); }
+SSocks::Utility::TSock::TSock(int type, int proto) : TSock(AF_INET, type, proto) {
+  //nothing
+}
+
+SSocks::Utility::TSock::TSock(int family, int type, int proto) : sock(Platform::openSocket(family, type, proto)) {
+  if(sock == Platform::INVALID_SOCK) { throw std::runtime_error(lastErrStr(Platform::lastError())); }
 }
 
 //release the resource if its owned by this object
 SSocks::Utility::TSock::~TSock() {
-  if(sock != SOCKET_ERROR) {
-    closesocket(sock);
+  if(sock != Platform::INVALID_SOCK) {
+    Platform::closeSocket(sock);
   }
 }
 
@@ -58,8 +60,27 @@ SSocks::Utility::TSock::~TSock() {
 int SSocks::Utility::TSock::validate() {
   int temp = sock;
   //disown the resource so that it won't be released when the destructor executes
-  sock = SOCKET_ERROR;
+  sock = Platform::INVALID_SOCK;
   //return the handle
   return temp;
 }
 
+
+
+/////////////////////////WAITREADY/////////////////////////
+
+bool SSocks::Utility::waitReady(int sock, bool write, const Deadline& deadline) {
+  pollfd pfd = { 0 };
+  pfd.fd = sock;
+  pfd.events = write ? POLLOUT : POLLIN;
+
+  while(true) {
+    //the time left is worked out afresh each pass, so interruptions don't stretch the wait
+    int result = Platform::poll(&pfd, 1, deadline.remainingMs());
+    if(result > 0) { return true; }
+    if(result == 0) { return false; }
+
+    int err = Platform::lastError();
+    if(!Platform::interrupted(err)) { throw std::runtime_error(lastErrStr(err)); }
+  }
+}
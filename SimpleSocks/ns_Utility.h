@@ -2,35 +2,36 @@
 #pragma once
 #include <string>
 
+//std::span overloads of the buffer functions are only offered when compiling as C++20 or later.
+//(MSVC only reports the real language level in __cplusplus under /Zc:__cplusplus.)
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#define SSOCKS_HAS_SPAN 1
+#include <span>
+#include <cstddef>
+#endif
+
+//Likewise the coroutine tasks and awaitable operations (cl_Task.h, fn_async.h), which also need
+//the compiler's coroutine support.
+#if (__cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)) && defined(__cpp_impl_coroutine)
+#define SSOCKS_HAS_COROUTINES 1
+#include <coroutine>
+#endif
+
 //Users should not need to make use of these classes and functions directly.
 
 namespace SSocks {
+  //forward declaration
+  class Deadline;
+
   namespace Utility {
 
     /**
      * @fn std::string lastErrStr()
-     * Returns the string explanation of the last WSA error.
+     * Returns the string explanation of a socket error code.
      * Users should not need to make use of this function directly.
      */
       std::string lastErrStr(int code);
 
-    /**
-     * RAII object for Winsock itself.
-     * Users should not need to make use of these class directly.
-     * Winsock must be activated before its functions will work, so an instance of this object
-     * is included in the Socket objects and in the HostAddress lookup function. The constructor
-     * calls WSAStartup() and the destructor calls WASCleanup(). MSDN specifies that the hidden
-     * resource being managed this way will refrence count, being released  when the number of
-     * cleanup calls equals the number of startup calls.
-     */
-    struct Winsock {
-      //! Start Winsock
-      Winsock();
-
-      //! Clean up Winsock
-      ~Winsock();
-    };
-
     /**
      * Tentative socket connection.
      * Users should not need to make use of these class directly.
@@ -40,9 +41,12 @@ namespace SSocks {
      */
     class TSock {
     public:
-      //! Generate a socket.
+      //! Generate an IPv4 socket. The socket library is started on first use.
       TSock(int type, int proto);
 
+      //! Generate a socket of the indicated address family (such as that of a HostAddress).
+      TSock(int family, int type, int proto);
+
       //! Release the socket if it's still owned by this object.
       ~TSock();
 
@@ -57,6 +61,14 @@ namespace SSocks {
 
     };
 
+    /**
+     * Wait until a socket is ready to read (or write), or until a deadline passes.
+     * Users should not need to make use of this function directly.
+     * @param write Wait for writability rather than readability.
+     * @return true if the socket is ready or has failed; false if the deadline passed first.
+     */
+    bool waitReady(int sock, bool write, const Deadline& deadline);
+
   }
 
 }